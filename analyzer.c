@@ -0,0 +1,538 @@
+// analyzer.c
+//
+// Local analysis service. Keeps the engine, and with it one hot
+// transposition table, loaded between queries and answers position
+// requests from other processes over a Unix domain socket.
+//
+// Requests and replies are JSON objects, one per line:
+//
+//   {"type":"analyze","id":"q1","board":["R......B",...],"turn":"R",
+//    "priority":"interactive","time_ms":100,"depth":0}
+//   {"type":"cancel","id":"q1"}
+//
+//   {"type":"result","id":"q1","move":{"sx":1,"sy":1,"tx":2,"ty":2},
+//    "score":3,"depth":9,"nodes":123456,"pv":[[1,1,2,2],...],
+//    "stop":"time","ms":98}
+//   {"type":"cancelled","id":"q1"}
+//   {"type":"error","id":"q1","message":"..."}
+//
+// Coordinates are 1-based as in the game protocol; "move" is null when the
+// side to move has to pass. "priority" is "interactive" (the default) or
+// "batch". Interactive queries go before any queued batch query, and one
+// worker is kept free of batch work so they never wait behind a long
+// search. Batch queries run on the remaining workers.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <limits.h>
+#include "cJSON.h"
+#include "engine.h"
+#include "logger.h"
+
+#define ANALYZER_MAX_CLIENTS   64
+#define ANALYZER_LINE_MAX      4096
+#define ANALYZER_ID_MAX        64
+#define INTERACTIVE_TIME_MS    100     // defaults when a query gives no limit
+#define BATCH_TIME_MS          10000
+
+enum { PRIORITY_INTERACTIVE = 0, PRIORITY_BATCH, PRIORITIES };
+
+typedef struct Connection {
+    int             fd;
+    int             refs;      // the I/O loop's plus one per job; queue_lock
+    pthread_mutex_t write_lock;
+    size_t          len;
+    char            buf[ANALYZER_LINE_MAX];
+} Connection;
+
+typedef struct Job {
+    struct Job     *next;
+    Connection     *conn;
+    char            id[ANALYZER_ID_MAX];
+    int             priority;
+    int             cancel;    // EngineLimits::cancel
+    int             time_ms;
+    int             depth;
+    long long       received_ms;
+    EnginePosition  pos;
+} Job;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_ready = PTHREAD_COND_INITIALIZER;
+static Job *queue_head[PRIORITIES], *queue_tail[PRIORITIES];
+static Job *running;           // jobs being searched, for cancellation
+static int  batch_running;
+static int  batch_slots;       // workers that may take batch jobs
+static int  stopping;
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig) { (void)sig; quit = 1; }
+
+static void conn_release(Connection *conn)   // with queue_lock held
+{
+    if (--conn->refs == 0) {
+        close(conn->fd);
+        pthread_mutex_destroy(&conn->write_lock);
+        free(conn);
+    }
+}
+
+static void send_reply(Connection *conn, cJSON *json)
+{
+    char *msg = cJSON_PrintUnformatted(json);
+    if (!msg) return;
+    size_t len = strlen(msg);
+    msg[len] = '\n';    // replaces the terminator; cJSON allocates len + 1
+    pthread_mutex_lock(&conn->write_lock);
+    const char *p = msg;
+    size_t left = len + 1;
+    while (left > 0) {
+        ssize_t n = send(conn->fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) break;   // the client went away; nothing to do
+        p += n;
+        left -= (size_t)n;
+    }
+    pthread_mutex_unlock(&conn->write_lock);
+    free(msg);
+}
+
+static void send_status(Connection *conn, const char *type, const char *id,
+                        const char *message)
+{
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", type);
+    if (id) cJSON_AddStringToObject(msg, "id", id);
+    if (message) cJSON_AddStringToObject(msg, "message", message);
+    send_reply(conn, msg);
+    cJSON_Delete(msg);
+}
+
+static cJSON *move_array(const EngineMove *m)
+{
+    int v[4] = { m->from_row + 1, m->from_col + 1, m->to_row + 1, m->to_col + 1 };
+    return cJSON_CreateIntArray(v, 4);
+}
+
+static void send_result(const Job *job, int found, const EngineResult *result,
+                        long long elapsed)
+{
+    static const char *const stop_names[] = {
+        "depth", "time", "only move", "easy move", "proven", "cancelled",
+        "nodes"
+    };
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "result");
+    cJSON_AddStringToObject(msg, "id", job->id);
+    if (found) {
+        cJSON *move = cJSON_AddObjectToObject(msg, "move");
+        cJSON_AddNumberToObject(move, "sx", result->move.from_row + 1);
+        cJSON_AddNumberToObject(move, "sy", result->move.from_col + 1);
+        cJSON_AddNumberToObject(move, "tx", result->move.to_row + 1);
+        cJSON_AddNumberToObject(move, "ty", result->move.to_col + 1);
+    } else {
+        cJSON_AddNullToObject(msg, "move");
+    }
+    cJSON_AddNumberToObject(msg, "score", result->score);
+    cJSON_AddNumberToObject(msg, "depth", result->depth);
+    cJSON_AddNumberToObject(msg, "nodes", (double)result->nodes);
+    cJSON *pv = cJSON_AddArrayToObject(msg, "pv");
+    for (int i = 0; i < result->pv_len; i++) {
+        cJSON_AddItemToArray(pv, move_array(&result->pv[i]));
+    }
+    cJSON_AddStringToObject(msg, "stop", stop_names[result->stop_reason]);
+    cJSON_AddNumberToObject(msg, "ms", (double)elapsed);
+    send_reply(job->conn, msg);
+    cJSON_Delete(msg);
+}
+
+// Next job this worker may run, or NULL. Called with queue_lock held.
+static Job *take_job(void)
+{
+    int last = (batch_running < batch_slots) ? PRIORITY_BATCH
+                                             : PRIORITY_INTERACTIVE;
+    for (int p = PRIORITY_INTERACTIVE; p <= last; p++) {
+        Job *job = queue_head[p];
+        if (job) {
+            queue_head[p] = job->next;
+            if (!queue_head[p]) queue_tail[p] = NULL;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    engine_prepare(8, 8);   // this thread's context for the common size
+
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        Job *job;
+        while (!stopping && !(job = take_job())) {
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        }
+        if (stopping) break;
+        job->next = running;
+        running = job;
+        if (job->priority == PRIORITY_BATCH) batch_running++;
+        pthread_mutex_unlock(&queue_lock);
+
+        // Interactive budgets count from receipt, batch ones from the start.
+        long long start_time = get_time_ms();
+        long long base = (job->priority == PRIORITY_INTERACTIVE)
+                       ? job->received_ms : start_time;
+        EngineLimits limits = { job->depth, base + job->time_ms, &job->cancel,
+                                0, NULL, 0 };
+        EngineResult result;
+        engine_state_next_search();
+        int found = engine_search(&job->pos, &limits, &result);
+        long long elapsed = get_time_ms() - job->received_ms;
+        send_result(job, found == 1, &result, elapsed);
+        LOG(LOG_INFO, "[analyzer] %s %s: depth %d score %d, %llu nodes, %lld ms",
+            job->priority == PRIORITY_BATCH ? "batch" : "interactive", job->id,
+            result.depth, result.score, result.nodes, elapsed);
+
+        pthread_mutex_lock(&queue_lock);
+        for (Job **p = &running; *p; p = &(*p)->next) {
+            if (*p == job) { *p = job->next; break; }
+        }
+        if (job->priority == PRIORITY_BATCH) {
+            batch_running--;
+            pthread_cond_signal(&queue_ready);   // a batch slot is free again
+        }
+        conn_release(job->conn);
+        free(job);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
+}
+
+/**
+ * Parse an analyze request into a job. Returns NULL and sets 'error' if
+ * the request is malformed or the board size is not supported.
+ */
+static Job *parse_analyze(cJSON *req, const char **error)
+{
+    cJSON *board = cJSON_GetObjectItem(req, "board");
+    cJSON *turn = cJSON_GetObjectItem(req, "turn");
+    cJSON *priority = cJSON_GetObjectItem(req, "priority");
+    cJSON *time_ms = cJSON_GetObjectItem(req, "time_ms");
+    cJSON *depth = cJSON_GetObjectItem(req, "depth");
+
+    const char *rows[ENGINE_MAX_SIDE];
+    int height = cJSON_IsArray(board) ? cJSON_GetArraySize(board) : 0;
+    if (height < ENGINE_MIN_SIDE || height > ENGINE_MAX_SIDE) {
+        *error = "unsupported board size";
+        return NULL;
+    }
+    int width = -1;
+    for (int r = 0; r < height; r++) {
+        cJSON *row = cJSON_GetArrayItem(board, r);
+        if (!cJSON_IsString(row) ||
+            (width >= 0 && (int)strlen(row->valuestring) != width)) {
+            *error = "board rows must be strings of equal length";
+            return NULL;
+        }
+        rows[r] = row->valuestring;
+        width = (int)strlen(rows[r]);
+    }
+    char to_move = cJSON_IsString(turn) ? turn->valuestring[0] : 'R';
+    if (to_move != 'R' && to_move != 'B') {
+        *error = "turn must be \"R\" or \"B\"";
+        return NULL;
+    }
+
+    Job *job = (Job *)calloc(1, sizeof(*job));
+    if (!job) {
+        *error = "out of memory";
+        return NULL;
+    }
+    if (engine_position_from_rows(&job->pos, rows, height, width, to_move) != 0) {
+        free(job);
+        *error = "unsupported board size";
+        return NULL;
+    }
+    job->priority = (cJSON_IsString(priority) &&
+                     strcmp(priority->valuestring, "batch") == 0)
+                  ? PRIORITY_BATCH : PRIORITY_INTERACTIVE;
+    job->depth = cJSON_IsNumber(depth) ? depth->valueint : 0;
+    job->time_ms = cJSON_IsNumber(time_ms) && time_ms->valueint > 0
+                 ? time_ms->valueint
+                 : job->priority == PRIORITY_BATCH ? BATCH_TIME_MS
+                                                   : INTERACTIVE_TIME_MS;
+    return job;
+}
+
+// Withdraw a queued job or stop a running one. Returns 0 if 'id' is unknown.
+static int cancel_job(Connection *conn, const char *id)
+{
+    pthread_mutex_lock(&queue_lock);
+    for (int p = 0; p < PRIORITIES; p++) {
+        Job *prev = NULL;
+        for (Job *job = queue_head[p]; job; prev = job, job = job->next) {
+            if (job->conn != conn || strcmp(job->id, id) != 0) continue;
+            if (prev) prev->next = job->next; else queue_head[p] = job->next;
+            if (queue_tail[p] == job) queue_tail[p] = prev;
+            pthread_mutex_unlock(&queue_lock);
+            send_status(conn, "cancelled", id, NULL);
+            pthread_mutex_lock(&queue_lock);
+            conn_release(conn);
+            pthread_mutex_unlock(&queue_lock);
+            free(job);
+            return 1;
+        }
+    }
+    for (Job *job = running; job; job = job->next) {
+        if (job->conn == conn && strcmp(job->id, id) == 0) {
+            // The worker still replies, with the best move found so far.
+            __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&queue_lock);
+            return 1;
+        }
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+static void handle_request(Connection *conn, const char *line)
+{
+    cJSON *req = cJSON_Parse(line);
+    cJSON *type = req ? cJSON_GetObjectItem(req, "type") : NULL;
+    cJSON *id = req ? cJSON_GetObjectItem(req, "id") : NULL;
+    const char *id_str = cJSON_IsString(id) ? id->valuestring : "";
+
+    if (!cJSON_IsString(type)) {
+        send_status(conn, "error", NULL, "expected a JSON object with a type");
+    } else if (strlen(id_str) >= ANALYZER_ID_MAX) {
+        send_status(conn, "error", NULL, "id too long");
+    } else if (strcmp(type->valuestring, "analyze") == 0) {
+        const char *error = NULL;
+        Job *job = parse_analyze(req, &error);
+        if (!job) {
+            send_status(conn, "error", id_str, error);
+        } else {
+            strcpy(job->id, id_str);
+            job->conn = conn;
+            job->received_ms = get_time_ms();
+            pthread_mutex_lock(&queue_lock);
+            conn->refs++;
+            if (queue_tail[job->priority]) queue_tail[job->priority]->next = job;
+            else queue_head[job->priority] = job;
+            queue_tail[job->priority] = job;
+            pthread_cond_broadcast(&queue_ready);
+            pthread_mutex_unlock(&queue_lock);
+        }
+    } else if (strcmp(type->valuestring, "cancel") == 0) {
+        if (!cancel_job(conn, id_str)) {
+            send_status(conn, "error", id_str, "no such query");
+        }
+    } else {
+        send_status(conn, "error", id_str, "unknown request type");
+    }
+    cJSON_Delete(req);
+}
+
+// Drop a client: withdraw its queued jobs and cancel the running ones. The
+// connection itself goes once the last of its jobs has finished.
+static void close_connection(Connection *conn)
+{
+    pthread_mutex_lock(&queue_lock);
+    for (int p = 0; p < PRIORITIES; p++) {
+        Job **link = &queue_head[p];
+        queue_tail[p] = NULL;
+        while (*link) {
+            Job *job = *link;
+            if (job->conn == conn) {
+                *link = job->next;
+                conn_release(conn);
+                free(job);
+            } else {
+                queue_tail[p] = job;
+                link = &job->next;
+            }
+        }
+    }
+    for (Job *job = running; job; job = job->next) {
+        if (job->conn == conn) __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+    }
+    shutdown(conn->fd, SHUT_RDWR);
+    conn_release(conn);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Read what the client sent and handle every complete line. Returns -1 when
+// the connection should be closed.
+static int read_requests(Connection *conn)
+{
+    ssize_t n = recv(conn->fd, conn->buf + conn->len,
+                     sizeof(conn->buf) - 1 - conn->len, 0);
+    if (n <= 0) return -1;
+    conn->len += (size_t)n;
+    conn->buf[conn->len] = '\0';
+
+    char *line = conn->buf;
+    char *end;
+    while ((end = strchr(line, '\n')) != NULL) {
+        *end = '\0';
+        if (end > line) handle_request(conn, line);
+        line = end + 1;
+    }
+    conn->len -= (size_t)(line - conn->buf);
+    memmove(conn->buf, line, conn->len);
+    if (conn->len == sizeof(conn->buf) - 1) {
+        send_status(conn, "error", NULL, "request too long");
+        return -1;
+    }
+    return 0;
+}
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[analyzer] socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(path);   // left over from a previous run
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0) {
+        fprintf(stderr, "[analyzer] cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void serve(int listen_fd)
+{
+    struct pollfd fds[ANALYZER_MAX_CLIENTS + 1];
+    Connection *conns[ANALYZER_MAX_CLIENTS + 1];
+    int count = 1;
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+
+    while (!quit) {
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = count - 1; i >= 1; i--) {
+            if (!fds[i].revents) continue;
+            if (read_requests(conns[i]) != 0) {
+                close_connection(conns[i]);
+                fds[i] = fds[count - 1];
+                conns[i] = conns[count - 1];
+                count--;
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0) continue;
+            Connection *conn = (Connection *)calloc(1, sizeof(*conn));
+            if (!conn || count > ANALYZER_MAX_CLIENTS) {
+                LOG(LOG_WARN, "[analyzer] refusing client: too many connections");
+                free(conn);
+                close(fd);
+                continue;
+            }
+            conn->fd = fd;
+            conn->refs = 1;
+            pthread_mutex_init(&conn->write_lock, NULL);
+            fds[count].fd = fd;
+            fds[count].events = POLLIN;
+            conns[count] = conn;
+            count++;
+        }
+    }
+    for (int i = 1; i < count; i++) close_connection(conns[i]);
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = "/tmp/octaflip-analyzer.sock";
+    const char *tt_file = NULL, *log_file = NULL, *eval_file = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int level = LOG_INFO;
+
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-socket") == 0)   socket_path = argv[++i];
+        else if (strcmp(argv[i], "-threads") == 0)  threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-tt-file") == 0)  tt_file = argv[++i];
+        else if (strcmp(argv[i], "-eval-file") == 0) eval_file = argv[++i];
+        else if (strcmp(argv[i], "-log-file") == 0) log_file = argv[++i];
+        else if (strcmp(argv[i], "-log-level") == 0) {
+            level = log_level_from_name(argv[++i]);
+            if (level < 0) { bad_args = 1; break; }
+        }
+        else { bad_args = 1; break; }
+    }
+    if (bad_args) {
+        fprintf(stderr, "Usage: %s [-socket <path>] [-threads <n>] [-tt-file <path>]\n"
+                        "       [-eval-file <path>] [-log-file <path>] [-log-level error|warn|info|debug]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 2) threads = 2;   // one is kept for interactive queries
+    batch_slots = threads - 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    log_open(log_file, level);
+    if (engine_state_open(tt_file) != 0) {
+        LOG(LOG_ERROR, "[analyzer] cannot allocate the search state");
+        log_close();
+        return 1;
+    }
+    if (eval_file && engine_eval_open(eval_file) != 0) {
+        LOG(LOG_WARN, "[analyzer] using the piece count evaluation");
+    }
+    int listen_fd = listen_on(socket_path);
+    if (listen_fd < 0) {
+        engine_state_close();
+        log_close();
+        return 1;
+    }
+
+    pthread_t *workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker_main, NULL);
+    }
+    LOG(LOG_INFO, "[analyzer] listening on %s with %d workers", socket_path, threads);
+
+    serve(listen_fd);
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    for (Job *job = running; job; job = job->next) {
+        __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+    }
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+    free(workers);
+
+    close(listen_fd);
+    unlink(socket_path);
+    engine_state_sync();
+    engine_state_close();
+    engine_eval_close();
+    LOG(LOG_INFO, "[analyzer] stopped");
+    log_close();
+    return 0;
+}
@@ -0,0 +1,9 @@
+# -*- coding: utf-8 -*-
+from __future__ import absolute_import
+
+__version__ = "0.0.1"
+
+from .engine import (RED, BLUE, Position, SearchResult, BatchResult,
+                     open_state, clear_state, load_eval, close_eval, pack,
+                     legal_moves_batch, play_batch, evaluate_batch,
+                     search_batch)
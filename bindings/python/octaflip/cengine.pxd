@@ -0,0 +1,63 @@
+from libc.stdint cimport uint64_t
+
+cdef extern from "engine.h" nogil:
+    enum:
+        ENGINE_MIN_SIDE
+        ENGINE_MAX_SIDE
+        ENGINE_MAX_MOVES
+        ENGINE_MAX_PV
+        ENGINE_SCORE_WIN
+
+    enum:
+        ENGINE_STOP_DEPTH
+        ENGINE_STOP_TIME
+        ENGINE_STOP_ONLY_MOVE
+        ENGINE_STOP_EASY_MOVE
+        ENGINE_STOP_PROVEN
+        ENGINE_STOP_CANCELLED
+        ENGINE_STOP_NODES
+
+    ctypedef struct EnginePosition:
+        int height, width
+        uint64_t red[2]
+        uint64_t blue[2]
+        uint64_t wall[2]
+        char to_move
+
+    ctypedef struct EngineMove:
+        int from_row, from_col
+        int to_row, to_col
+
+    ctypedef struct EngineLimits:
+        int max_depth
+        long long deadline_ms
+        const int *cancel
+        unsigned long long max_nodes
+        const EngineMove *exclude
+        int exclude_count
+
+    ctypedef struct EngineResult:
+        EngineMove move
+        int score
+        int depth
+        unsigned long long nodes
+        int stop_reason
+        EngineMove pv[16]
+        int pv_len
+
+    long long get_time_ms()
+
+    int engine_state_open(const char *path)
+    void engine_state_clear()
+    void engine_state_close()
+
+    int engine_supports(int height, int width)
+    int engine_start_position(EnginePosition *pos, int side)
+    int engine_legal_moves(const EnginePosition *pos, EngineMove *moves)
+    int engine_play(EnginePosition *pos, const EngineMove *move)
+    int engine_evaluate(const EnginePosition *pos, int *score)
+    int engine_search(const EnginePosition *pos, const EngineLimits *limits,
+                      EngineResult *result)
+
+    int engine_eval_open(const char *path)
+    void engine_eval_close()
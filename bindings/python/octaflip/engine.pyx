@@ -0,0 +1,438 @@
+# cython: language_level=3str
+# distutils: language = c++
+#
+# The Octaflip search engine of the client, for analysing games in Python.
+#
+# A batch of positions is a pair of numpy arrays, all of one board size:
+#
+#   boards   uint64, shape (n, 6): red, blue and wall bitboards, two words
+#            each, low word first. Square (r, c) is bit r*side + c.
+#   to_move  uint8, shape (n,): RED or BLUE.
+#
+# The *_batch functions release the GIL and spread the positions over
+# 'threads' threads (0: all cores). Searches running at once share the
+# engine's transposition table, so results can differ from run to run by
+# which thread filled it first.
+
+cimport cython
+cimport openmp
+from cython.parallel cimport prange
+from libc.stdint cimport uint8_t, int8_t, int32_t, uint64_t
+from libc.limits cimport LLONG_MAX
+from libc.string cimport memset
+from .cengine cimport *
+
+import collections
+import numpy as np
+
+cdef enum:
+    TO_MOVE_RED = 0
+    TO_MOVE_BLUE = 1
+
+RED = TO_MOVE_RED
+BLUE = TO_MOVE_BLUE
+
+STOP_REASONS = ("depth", "time", "only move", "easy move", "proven",
+                "cancelled", "nodes")
+
+SearchResult = collections.namedtuple(
+    'SearchResult', ['move', 'score', 'depth', 'nodes', 'stop', 'pv'])
+
+# moves: int8 (n, 4), -1 where the side to move has no move.
+BatchResult = collections.namedtuple(
+    'BatchResult', ['moves', 'scores', 'depths', 'nodes'])
+
+cdef bint state_open = False
+
+def open_state(path=None):
+    """Map the search state, kept in 'path' across runs if given. Searching
+    opens an anonymous one on first use."""
+    global state_open
+    if state_open:
+        engine_state_close()
+        state_open = False
+    if path is None:
+        rc = engine_state_open(NULL)
+    else:
+        rc = engine_state_open(path.encode('utf-8'))
+    if rc != 0:
+        raise MemoryError("cannot allocate the search state")
+    state_open = True
+
+def clear_state():
+    """Forget the transposition table, history and PV."""
+    if state_open:
+        engine_state_clear()
+
+def load_eval(path):
+    """Evaluate with the pattern tables in 'path' (see fit) on boards of
+    their size. Call before searching."""
+    if engine_eval_open(path.encode('utf-8')) != 0:
+        raise ValueError("cannot load evaluation weights from %s" % path)
+
+def close_eval():
+    engine_eval_close()
+
+cdef ensure_state():
+    if not state_open:
+        open_state()
+
+cdef int thread_count(int threads):
+    return threads if threads > 0 else openmp.omp_get_max_threads()
+
+cdef inline tuple move_tuple(const EngineMove *m):
+    return (m.from_row, m.from_col, m.to_row, m.to_col)
+
+cdef inline EngineLimits make_limits(int depth, unsigned long long nodes,
+                                     long long time_ms) noexcept nogil:
+    cdef EngineLimits limits
+    limits.max_depth = depth
+    limits.deadline_ms = get_time_ms() + time_ms if time_ms > 0 else LLONG_MAX
+    limits.cancel = NULL
+    limits.max_nodes = nodes
+    limits.exclude = NULL
+    limits.exclude_count = 0
+    return limits
+
+def check_limits(depth, nodes, time_ms):
+    if depth <= 0 and nodes <= 0 and time_ms <= 0:
+        raise ValueError("a search needs a depth, node or time limit")
+
+
+cdef class Position:
+    """A single position. play() returns a new one; positions are not
+    changed in place."""
+    cdef EnginePosition pos
+
+    @staticmethod
+    def start(int side=8):
+        """The opening position, red to move."""
+        cdef Position p = Position.__new__(Position)
+        if engine_start_position(&p.pos, side) != 0:
+            raise ValueError("unsupported board size %d" % side)
+        return p
+
+    @staticmethod
+    def from_rows(rows, to_move=RED):
+        """From strings of 'R', 'B', '#' (wall) and '.' cells."""
+        cdef Position p = Position.__new__(Position)
+        cdef int side = len(rows)
+        if not engine_supports(side, side) or any(len(r) != side for r in rows):
+            raise ValueError("unsupported board size")
+        memset(&p.pos, 0, sizeof(p.pos))
+        p.pos.height = p.pos.width = side
+        p.pos.to_move = c'B' if to_move == BLUE else c'R'
+        cdef int idx
+        for r, row in enumerate(rows):
+            for c, cell in enumerate(row):
+                idx = r * side + c
+                if cell == 'R':
+                    p.pos.red[idx >> 6] |= 1ULL << (idx & 63)
+                elif cell == 'B':
+                    p.pos.blue[idx >> 6] |= 1ULL << (idx & 63)
+                elif cell == '#':
+                    p.pos.wall[idx >> 6] |= 1ULL << (idx & 63)
+        return p
+
+    @staticmethod
+    def from_bits(bits, to_move, int side):
+        """From one row of a boards array."""
+        cdef Position p = Position.__new__(Position)
+        if not engine_supports(side, side):
+            raise ValueError("unsupported board size %d" % side)
+        memset(&p.pos, 0, sizeof(p.pos))
+        p.pos.height = p.pos.width = side
+        p.pos.red[0], p.pos.red[1] = int(bits[0]), int(bits[1])
+        p.pos.blue[0], p.pos.blue[1] = int(bits[2]), int(bits[3])
+        p.pos.wall[0], p.pos.wall[1] = int(bits[4]), int(bits[5])
+        p.pos.to_move = c'B' if to_move == BLUE else c'R'
+        return p
+
+    @property
+    def side(self):
+        return self.pos.width
+
+    @property
+    def to_move(self):
+        return BLUE if self.pos.to_move == c'B' else RED
+
+    def bits(self):
+        """The row of a boards array for this position."""
+        return np.array([self.pos.red[0], self.pos.red[1],
+                         self.pos.blue[0], self.pos.blue[1],
+                         self.pos.wall[0], self.pos.wall[1]], dtype=np.uint64)
+
+    def rows(self):
+        cdef int side = self.pos.width, idx
+        out = []
+        for r in range(side):
+            row = []
+            for c in range(side):
+                idx = r * side + c
+                if (self.pos.red[idx >> 6] >> (idx & 63)) & 1:
+                    row.append('R')
+                elif (self.pos.blue[idx >> 6] >> (idx & 63)) & 1:
+                    row.append('B')
+                elif (self.pos.wall[idx >> 6] >> (idx & 63)) & 1:
+                    row.append('#')
+                else:
+                    row.append('.')
+            out.append(''.join(row))
+        return out
+
+    def __repr__(self):
+        return 'Position(%r, to_move=%s)' % (
+            self.rows(), 'BLUE' if self.to_move == BLUE else 'RED')
+
+    def legal_moves(self):
+        """(from_row, from_col, to_row, to_col) tuples, one clone per
+        destination square."""
+        cdef EngineMove moves[ENGINE_MAX_MOVES]
+        cdef int n = engine_legal_moves(&self.pos, moves)
+        return [move_tuple(&moves[i]) for i in range(n)]
+
+    def play(self, move):
+        """The position after 'move', or after a pass if it is None."""
+        cdef Position p = Position.__new__(Position)
+        cdef EngineMove m
+        p.pos = self.pos
+        if move is None:
+            engine_play(&p.pos, NULL)
+            return p
+        m.from_row, m.from_col, m.to_row, m.to_col = move
+        if engine_play(&p.pos, &m) != 0:
+            raise ValueError("illegal move %r" % (move,))
+        return p
+
+    def evaluate(self):
+        """Static score for the side to move, as the search scores a leaf."""
+        cdef int score = 0
+        engine_evaluate(&self.pos, &score)
+        return score
+
+    def search(self, int depth=0, unsigned long long nodes=0, long long time_ms=0):
+        """Best move within the limits that are set; the search stops at
+        whichever is reached first. 'move' is None without a legal move."""
+        check_limits(depth, nodes, time_ms)
+        ensure_state()
+        cdef EngineLimits limits
+        cdef EngineResult result
+        cdef int found
+        with nogil:
+            limits = make_limits(depth, nodes, time_ms)
+            found = engine_search(&self.pos, &limits, &result)
+        return SearchResult(
+            move_tuple(&result.move) if found == 1 else None,
+            result.score, result.depth, result.nodes,
+            STOP_REASONS[result.stop_reason],
+            [move_tuple(&result.pv[i]) for i in range(result.pv_len)])
+
+
+def pack(positions):
+    """boards, to_move and side of a list of Positions of one size."""
+    positions = list(positions)
+    if not positions:
+        raise ValueError("no positions")
+    side = positions[0].side
+    if any(p.side != side for p in positions):
+        raise ValueError("positions of different sizes")
+    boards = np.array([p.bits() for p in positions], dtype=np.uint64)
+    to_move = np.array([p.to_move for p in positions], dtype=np.uint8)
+    return boards, to_move, side
+
+def batch_arrays(boards, to_move, int side):
+    if not engine_supports(side, side):
+        raise ValueError("unsupported board size %d" % side)
+    boards = np.ascontiguousarray(boards, dtype=np.uint64)
+    to_move = np.ascontiguousarray(to_move, dtype=np.uint8)
+    if (boards.ndim != 2 or boards.shape[1] != 6 or
+            to_move.shape != (boards.shape[0],)):
+        raise ValueError("expected boards of shape (n, 6) and to_move of shape (n,)")
+    return boards, to_move
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef inline void load_position(EnginePosition *pos, const uint64_t[:, ::1] boards,
+                               const uint8_t[::1] to_move, Py_ssize_t i,
+                               int side) noexcept nogil:
+    pos.height = side
+    pos.width = side
+    pos.red[0] = boards[i, 0]
+    pos.red[1] = boards[i, 1]
+    pos.blue[0] = boards[i, 2]
+    pos.blue[1] = boards[i, 3]
+    pos.wall[0] = boards[i, 4]
+    pos.wall[1] = boards[i, 5]
+    pos.to_move = c'B' if to_move[i] == TO_MOVE_BLUE else c'R'
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef int moves_into(const uint64_t[:, ::1] boards, const uint8_t[::1] to_move,
+                    Py_ssize_t i, int side, int8_t[:, ::1] out,
+                    Py_ssize_t first) noexcept nogil:
+    cdef EnginePosition pos
+    cdef EngineMove moves[ENGINE_MAX_MOVES]
+    cdef int k
+    load_position(&pos, boards, to_move, i, side)
+    cdef int n = engine_legal_moves(&pos, moves)
+    if first < 0:
+        return n
+    for k in range(n):
+        out[first + k, 0] = <int8_t>moves[k].from_row
+        out[first + k, 1] = <int8_t>moves[k].from_col
+        out[first + k, 2] = <int8_t>moves[k].to_row
+        out[first + k, 3] = <int8_t>moves[k].to_col
+    return n
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def legal_moves_batch(boards, to_move, int side, int threads=0):
+    """All legal moves as an int8 (m, 4) array, and int64 offsets of shape
+    (n + 1,): the moves of position i are moves[offsets[i]:offsets[i + 1]]."""
+    boards, to_move = batch_arrays(boards, to_move, side)
+    cdef const uint64_t[:, ::1] b = boards
+    cdef const uint8_t[::1] t = to_move
+    cdef Py_ssize_t n = b.shape[0], i
+    cdef int nthreads = thread_count(threads)
+    counts = np.zeros(n, dtype=np.int64)
+    cdef long long[::1] c = counts
+    cdef int8_t[:, ::1] none = np.zeros((0, 4), dtype=np.int8)
+    for i in prange(n, nogil=True, schedule='static', num_threads=nthreads):
+        c[i] = moves_into(b, t, i, side, none, -1)
+
+    offsets = np.zeros(n + 1, dtype=np.int64)
+    np.cumsum(counts, out=offsets[1:])
+    moves = np.empty((offsets[n], 4), dtype=np.int8)
+    cdef int8_t[:, ::1] m = moves
+    cdef long long[::1] o = offsets
+    for i in prange(n, nogil=True, schedule='static', num_threads=nthreads):
+        moves_into(b, t, i, side, m, o[i])
+    return moves, offsets
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef int play_into(const uint64_t[:, ::1] boards, const uint8_t[::1] to_move,
+                   const int8_t[:, ::1] moves, Py_ssize_t i, int side,
+                   uint64_t[:, ::1] out_boards,
+                   uint8_t[::1] out_to_move) noexcept nogil:
+    cdef EnginePosition pos
+    cdef EngineMove m
+    cdef int rc
+    load_position(&pos, boards, to_move, i, side)
+    if moves[i, 0] < 0:
+        rc = engine_play(&pos, NULL)
+    else:
+        m.from_row = moves[i, 0]
+        m.from_col = moves[i, 1]
+        m.to_row = moves[i, 2]
+        m.to_col = moves[i, 3]
+        rc = engine_play(&pos, &m)
+    out_boards[i, 0] = pos.red[0]
+    out_boards[i, 1] = pos.red[1]
+    out_boards[i, 2] = pos.blue[0]
+    out_boards[i, 3] = pos.blue[1]
+    out_boards[i, 4] = pos.wall[0]
+    out_boards[i, 5] = pos.wall[1]
+    out_to_move[i] = TO_MOVE_BLUE if pos.to_move == c'B' else TO_MOVE_RED
+    return rc
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def play_batch(boards, to_move, int side, moves, int threads=0):
+    """boards and to_move after playing moves[i] (int (n, 4); a row with a
+    negative from_row passes) on position i."""
+    boards, to_move = batch_arrays(boards, to_move, side)
+    moves = np.ascontiguousarray(moves, dtype=np.int8)
+    if moves.shape != (boards.shape[0], 4):
+        raise ValueError("expected moves of shape (n, 4)")
+    cdef const uint64_t[:, ::1] b = boards
+    cdef const uint8_t[::1] t = to_move
+    cdef const int8_t[:, ::1] mv = moves
+    cdef Py_ssize_t n = b.shape[0], i
+    cdef int nthreads = thread_count(threads)
+    out_boards = np.empty_like(boards)
+    out_to_move = np.empty_like(to_move)
+    status = np.zeros(n, dtype=np.int32)
+    cdef uint64_t[:, ::1] ob = out_boards
+    cdef uint8_t[::1] ot = out_to_move
+    cdef int32_t[::1] st = status
+    for i in prange(n, nogil=True, schedule='static', num_threads=nthreads):
+        st[i] = play_into(b, t, mv, i, side, ob, ot)
+    bad = np.flatnonzero(status)
+    if bad.size:
+        i = bad[0]
+        raise ValueError("illegal move %r at index %d"
+                         % (tuple(int(v) for v in moves[i]), i))
+    return out_boards, out_to_move
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef int evaluate_one(const uint64_t[:, ::1] boards, const uint8_t[::1] to_move,
+                      Py_ssize_t i, int side) noexcept nogil:
+    cdef EnginePosition pos
+    cdef int score = 0
+    load_position(&pos, boards, to_move, i, side)
+    engine_evaluate(&pos, &score)
+    return score
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def evaluate_batch(boards, to_move, int side, int threads=0):
+    """Static scores for the side to move, int32 of shape (n,)."""
+    boards, to_move = batch_arrays(boards, to_move, side)
+    cdef const uint64_t[:, ::1] b = boards
+    cdef const uint8_t[::1] t = to_move
+    cdef Py_ssize_t n = b.shape[0], i
+    cdef int nthreads = thread_count(threads)
+    scores = np.empty(n, dtype=np.int32)
+    cdef int32_t[::1] s = scores
+    for i in prange(n, nogil=True, schedule='static', num_threads=nthreads):
+        s[i] = evaluate_one(b, t, i, side)
+    return scores
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void search_one(const uint64_t[:, ::1] boards, const uint8_t[::1] to_move,
+                     Py_ssize_t i, int side, int depth, unsigned long long nodes,
+                     long long time_ms, int8_t[:, ::1] out_moves,
+                     int32_t[::1] out_scores, int32_t[::1] out_depths,
+                     uint64_t[::1] out_nodes) noexcept nogil:
+    cdef EnginePosition pos
+    cdef EngineResult result
+    load_position(&pos, boards, to_move, i, side)
+    cdef EngineLimits limits = make_limits(depth, nodes, time_ms)
+    if engine_search(&pos, &limits, &result) == 1:
+        out_moves[i, 0] = <int8_t>result.move.from_row
+        out_moves[i, 1] = <int8_t>result.move.from_col
+        out_moves[i, 2] = <int8_t>result.move.to_row
+        out_moves[i, 3] = <int8_t>result.move.to_col
+    else:
+        out_moves[i, 0] = out_moves[i, 1] = out_moves[i, 2] = out_moves[i, 3] = -1
+    out_scores[i] = result.score
+    out_depths[i] = result.depth
+    out_nodes[i] = result.nodes
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def search_batch(boards, to_move, int side, int depth=0,
+                 unsigned long long nodes=0, long long time_ms=0, int threads=0):
+    """Search every position with the limits of Position.search(), each
+    with its own node and time budget. Returns a BatchResult."""
+    check_limits(depth, nodes, time_ms)
+    boards, to_move = batch_arrays(boards, to_move, side)
+    ensure_state()
+    cdef const uint64_t[:, ::1] b = boards
+    cdef const uint8_t[::1] t = to_move
+    cdef Py_ssize_t n = b.shape[0], i
+    cdef int nthreads = thread_count(threads)
+    moves = np.empty((n, 4), dtype=np.int8)
+    scores = np.empty(n, dtype=np.int32)
+    depths = np.empty(n, dtype=np.int32)
+    node_counts = np.empty(n, dtype=np.uint64)
+    cdef int8_t[:, ::1] m = moves
+    cdef int32_t[::1] s = scores
+    cdef int32_t[::1] d = depths
+    cdef uint64_t[::1] nc = node_counts
+    for i in prange(n, nogil=True, schedule='dynamic', num_threads=nthreads):
+        search_one(b, t, i, side, depth, nodes, time_ms, m, s, d, nc)
+    return BatchResult(moves, scores, depths, node_counts)
@@ -6,7 +6,7 @@
 from distutils.core import setup, Extension
 
 core_ext = Extension(
-    name                = 'core',
+    name                = 'rgbmatrix.core',
     sources             = ['rgbmatrix/core.cpp'],
     include_dirs        = ['../../include'],
     library_dirs        = ['../../lib'],
@@ -16,7 +16,7 @@ core_ext = Extension(
 )
 
 graphics_ext = Extension(
-    name                = 'graphics',
+    name                = 'rgbmatrix.graphics',
     sources             = ['rgbmatrix/graphics.cpp'],
     include_dirs        = ['../../include'],
     library_dirs        = ['../../lib'],
@@ -25,13 +25,25 @@ graphics_ext = Extension(
     language            = 'c++'
 )
 
+# The Octaflip engine; liboctaflip.a is built from the client's sources by
+# octaflip/Makefile. The batch functions use OpenMP threads.
+engine_ext = Extension(
+    name                = 'octaflip.engine',
+    sources             = ['octaflip/engine.cpp'],
+    include_dirs        = ['../../include'],
+    library_dirs        = ['octaflip'],
+    libraries           = ['octaflip'],
+    extra_compile_args  = ["-O3", "-Wall", "-fopenmp"],
+    extra_link_args     = ["-fopenmp"],
+    language            = 'c++'
+)
+
 setup(
     name                = 'rgbmatrix',
     version             = '0.0.1',
     author              = 'Christoph Friedrich',
     author_email        = 'christoph.friedrich@vonaffenfels.de',
     classifiers         = ['Development Status :: 3 - Alpha'],
-    ext_package         = 'rgbmatrix',
-    ext_modules         = [core_ext, graphics_ext],
-    packages            = ['rgbmatrix']
+    ext_modules         = [core_ext, graphics_ext, engine_ext],
+    packages            = ['rgbmatrix', 'octaflip']
 )
@@ -4,9 +4,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #define LED_PANEL_SIZE 64
+#define LED_DEFAULT_FONT "fonts/5x8.bdf"
 
 struct LedPanelSettings *leds;
 
@@ -21,102 +23,331 @@ static struct Color rgb_colors[] = {
     {255, 255, 255}    // grid-line → white
 };
 
-struct LedPanelSettings *led_initialize(void) {
-    if (leds){
-        free(leds);
-        leds = NULL;
+static unsigned char cell_color(char c) {
+    if      (c == 'R') return 0;
+    else if (c == 'B') return 1;
+    else if (c == '#') return 2;
+    else               return 3;  // '.' or any other → black
+}
+
+// Paint the inside of a cell (pixels 1..6 of its 8×8 square, the rest
+// being grid lines): 'width' columns of a colour centred on black, the way
+// a piece looks turned edge-on. Width 6 fills the cell.
+static void paint_cell(struct LedCanvas *canvas, int row, int col,
+                       unsigned char color_idx, int width) {
+    const int x0 = col * 8 + 1, y0 = row * 8 + 1;
+    const int left = x0 + (6 - width) / 2, right = left + width;
+    const struct Color *black = &rgb_colors[3], *c = &rgb_colors[color_idx];
+    led_canvas_fill_rect(canvas, x0, y0, left - x0, 6, black->r, black->g, black->b);
+    led_canvas_fill_rect(canvas, left, y0, width, 6, c->r, c->g, c->b);
+    led_canvas_fill_rect(canvas, right, y0, x0 + 6 - right, 6,
+                         black->r, black->g, black->b);
+}
+
+// A frame not drawn yet (or cleared) gets the white grid first; every cell
+// is then painted over it.
+static void prepare_frame(struct LedFrame *f) {
+    if (f->valid) return;
+    led_canvas_fill(f->canvas, rgb_colors[4].r, rgb_colors[4].g,
+                    rgb_colors[4].b);
+    memset(f->cells, LED_CELL_UNKNOWN, sizeof(f->cells));
+    f->valid = 1;
+}
+
+// Bring a frame to the board 'cells', repainting only the cells it lacks.
+static void render_board(struct LedFrame *f, unsigned char cells[8][8]) {
+    prepare_frame(f);
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (f->cells[row][col] == cells[row][col]) continue;
+            paint_cell(f->canvas, row, col, cells[row][col], 6);
+            f->cells[row][col] = cells[row][col];
+        }
     }
-    leds = (struct LedPanelSettings*)malloc(sizeof(struct LedPanelSettings));
-    if (!leds) return NULL;
-    memset(leds, 0, sizeof(*leds));
+}
+
+// Step 1..LED_FLIP_STEPS-1 of the flip from 'from' to 'to': the cells that
+// change narrow to nothing in their old colour, then widen in the new one.
+static void render_flip(struct LedFrame *f, unsigned char from[8][8],
+                        unsigned char to[8][8], int step) {
+    const int half = LED_FLIP_STEPS / 2;
+    int width = 6 * abs(half - step) / half;
+    width &= ~1;  // keep the columns centred
+    prepare_frame(f);
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (from[row][col] == to[row][col]) {
+                if (f->cells[row][col] == to[row][col]) continue;
+                paint_cell(f->canvas, row, col, to[row][col], 6);
+                f->cells[row][col] = to[row][col];
+            } else {
+                paint_cell(f->canvas, row, col,
+                           step < half ? from[row][col] : to[row][col], width);
+                f->cells[row][col] = LED_CELL_UNKNOWN;
+            }
+        }
+    }
+}
+
+// Put frame 'i' on the panel, 'fraction' refreshes after the last swap.
+static void show_frame(int i, unsigned fraction) {
+    led_matrix_swap_on_vsync_fraction(leds->matrix, leds->frames[i].canvas,
+                                      fraction);
+    leds->front = i;
+}
+
+// Show 'board', flipping the cells that differ from the board on display
+// if 'animate' and there is one.
+static void show_board(char board[8][8], int animate) {
+    unsigned char to[8][8], from[8][8];
+    const struct LedFrame *shown = &leds->frames[leds->front];
+    int changed = 0, known = shown->valid;
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            to[row][col] = cell_color(board[row][col]);
+            from[row][col] = shown->cells[row][col];
+            if (from[row][col] == LED_CELL_UNKNOWN) known = 0;
+            if (from[row][col] != to[row][col]) changed = 1;
+        }
+    }
+    if (known && !changed) return;
 
-    leds->size = LED_PANEL_SIZE;
+    const int first = leds->front;
+    if (animate && known) {
+        // Render every step ahead into the frames not on display, so that
+        // playing them back is nothing but swaps.
+        for (int step = 1; step < LED_FLIP_STEPS; step++)
+            render_flip(&leds->frames[(first + step) % LED_FRAMES], from, to, step);
+        render_board(&leds->frames[(first + LED_FLIP_STEPS) % LED_FRAMES], to);
+        for (int step = 1; step <= LED_FLIP_STEPS; step++)
+            show_frame((first + step) % LED_FRAMES, LED_FLIP_FRACTION);
+    } else {
+        int next = (first + 1) % LED_FRAMES;
+        render_board(&leds->frames[next], to);
+        show_frame(next, 1);
+    }
+}
+
+static void clear_panel(void) {
+    int next = (leds->front + 1) % LED_FRAMES;
+    led_canvas_clear(leds->frames[next].canvas);
+    leds->frames[next].valid = 0;
+    show_frame(next, 1);
+}
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Draws whatever draw_board() and led_clear() ask for, latest first: a
+// board asked for while a flip plays waits for it to end. On stopping, a
+// pending clear is still done (a board no longer drawn).
+static void *panel_thread(void *arg) {
+    (void)arg;
+    char board[8][8];
+    pthread_mutex_lock(&leds->lock);
+    for (;;) {
+        while (!leds->stopping && !leds->board_requested && !leds->clear_requested)
+            pthread_cond_wait(&leds->wake, &leds->lock);
+        if (leds->stopping) {
+            if (leds->clear_requested) {
+                leds->clear_requested = 0;
+                pthread_mutex_unlock(&leds->lock);
+                clear_panel();
+                pthread_mutex_lock(&leds->lock);
+            }
+            break;
+        }
+        int clear = leds->clear_requested, draw = leds->board_requested;
+        unsigned id = leds->request_id;
+        memcpy(board, leds->request_board, sizeof(board));
+        leds->clear_requested = leds->board_requested = 0;
+        pthread_mutex_unlock(&leds->lock);
+
+        if (clear) clear_panel();
+        if (draw) show_board(board, !clear);
+
+        pthread_mutex_lock(&leds->lock);
+        leds->shown_id = id;
+        leds->shown_us = now_us();
+    }
+    pthread_mutex_unlock(&leds->lock);
+    return NULL;
+}
+
+/*
+ * The panel is built once per process, on a background thread started by
+ * led_start(): creating the RGBMatrix, mapping GPIO and starting the
+ * refresh thread then overlap with whatever the caller does meanwhile.
+ * Later games only clear it.
+ */
+enum { PANEL_NONE, PANEL_STARTING, PANEL_READY, PANEL_FAILED };
+static pthread_mutex_t panel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  panel_ready = PTHREAD_COND_INITIALIZER;
+static int             panel_state = PANEL_NONE;
+
+static struct LedPanelSettings *build_panel(void) {
+    struct LedPanelSettings *panel =
+        (struct LedPanelSettings*)malloc(sizeof(struct LedPanelSettings));
+    if (!panel) return NULL;
+    memset(panel, 0, sizeof(*panel));
+
+    panel->size = LED_PANEL_SIZE;
 
     // Set up a 64×64 matrix
     struct RGBLedMatrixOptions opts;
     memset(&opts, 0, sizeof(opts));
     opts.rows = LED_PANEL_SIZE;
     opts.cols = LED_PANEL_SIZE;
+    // Only our five colours are drawn: 4 bitplanes show them instead of 11
+    opts.palette = rgb_colors;
+    opts.palette_size = sizeof(rgb_colors) / sizeof(rgb_colors[0]);
+    // A steady refresh rate paces the flips; sleeping between refreshes
+    // leaves the CPU to the search.
+    opts.limit_refresh_rate_hz = LED_REFRESH_HZ;
+    opts.disable_busy_waiting = true;
 
-    leds->matrix = led_matrix_create_from_options(&opts, NULL, NULL);
-    if (!leds->matrix) {
-        free(leds);
+    panel->matrix = led_matrix_create_from_options(&opts, NULL, NULL);
+    if (!panel->matrix) {
+        free(panel);
         return NULL;
     }
 
-    // Load a basic font so that led_matrix_create doesn't fail.
-    leds->font = load_font("rpi-rgb-led-matrix-master/fonts/5x8.bdf");
-    if (!leds->font) {
-        led_matrix_delete(leds->matrix);
-        free(leds);
-        return NULL;
+    // The canvas on display to begin with, and offscreen ones for the
+    // other frames (the matrix owns them all).
+    panel->frames[0].canvas = led_matrix_get_canvas(panel->matrix);
+    for (int i = 1; i < LED_FRAMES; i++)
+        panel->frames[i].canvas = led_matrix_create_offscreen_canvas(panel->matrix);
+    for (int i = 0; i < LED_FRAMES; i++) {
+        if (!panel->frames[i].canvas) {
+            led_matrix_delete(panel->matrix);
+            free(panel);
+            return NULL;
+        }
+        // Start with a black screen
+        led_canvas_clear(panel->frames[i].canvas);
     }
+    panel->front = 0;
+    return panel;
+}
 
-    // Grab the canvas pointer
-    leds->canvas = led_matrix_get_canvas(leds->matrix);
-    if (!leds->canvas) {
-        delete_font(leds->font);
-        led_matrix_delete(leds->matrix);
-        free(leds);
-        return NULL;
+// Make a freshly built panel (or NULL) the process's, and start drawing.
+static void publish_panel(struct LedPanelSettings *panel) {
+    pthread_mutex_lock(&panel_lock);
+    leds = panel;
+    if (leds) {
+        pthread_mutex_init(&leds->lock, NULL);
+        pthread_cond_init(&leds->wake, NULL);
+        if (pthread_create(&leds->thread, NULL, panel_thread, NULL) != 0) {
+            pthread_cond_destroy(&leds->wake);
+            pthread_mutex_destroy(&leds->lock);
+            led_matrix_delete(leds->matrix);
+            free(leds);
+            leds = NULL;
+        }
     }
-
-    // Start with a black screen
-    led_canvas_clear(leds->canvas);
-    leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
-    return leds;
+    panel_state = leds ? PANEL_READY : PANEL_FAILED;
+    pthread_cond_broadcast(&panel_ready);
+    pthread_mutex_unlock(&panel_lock);
 }
 
-void draw_board(char board[8][8]) {
-    // 1) Clear to black first
-    led_canvas_clear(leds->canvas);
+static void *build_thread(void *arg) {
+    (void)arg;
+    publish_panel(build_panel());
+    return NULL;
+}
 
-    // 2) Single pass: for each pixel (x,y) in [0..63]
-    for (int y = 0; y < LED_PANEL_SIZE; y++) {
-        for (int x = 0; x < LED_PANEL_SIZE; x++) {
-            int color_idx;
+void led_start(void) {
+    pthread_mutex_lock(&panel_lock);
+    if (panel_state == PANEL_NONE) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, build_thread, NULL) == 0) {
+            pthread_detach(thread);
+            panel_state = PANEL_STARTING;
+        }
+    }
+    pthread_mutex_unlock(&panel_lock);
+}
 
-            // If this pixel is on a cell border (grid line), paint white:
-            if ((x % 8 == 0) || (y % 8 == 0) || (x % 8 == 7) || (y % 8 == 7)) {
-                color_idx = 4;  // white (grid)
-            } else {
-                // Otherwise: interior. Determine which cell by integer-dividing by 8.
-                int row = y / 8;   // 0..7
-                int col = x / 8;   // 0..7
-                char c = board[row][col];
-                if      (c == 'R') color_idx = 0;
-                else if (c == 'B') color_idx = 1;
-                else if (c == '#') color_idx = 2;
-                else                color_idx = 3;  // '.' or any other → black
-            }
+struct LedPanelSettings *led_initialize(void) {
+    pthread_mutex_lock(&panel_lock);
+    if (panel_state == PANEL_NONE) {
+        // Never started: build it here.
+        panel_state = PANEL_STARTING;
+        pthread_mutex_unlock(&panel_lock);
+        publish_panel(build_panel());
+        pthread_mutex_lock(&panel_lock);
+    }
+    while (panel_state == PANEL_STARTING)
+        pthread_cond_wait(&panel_ready, &panel_lock);
+    struct LedPanelSettings *panel = leds;
+    pthread_mutex_unlock(&panel_lock);
+    return panel;
+}
 
-            // Paint the pixel at (x,y)
-            led_canvas_set_pixel(
-                leds->canvas, x, y,
-                rgb_colors[color_idx].r,
-                rgb_colors[color_idx].g,
-                rgb_colors[color_idx].b
-            );
-        }
+struct LedFont *led_font(void) {
+    if (!leds) return NULL;
+    if (!leds->font) {
+        const char *path = getenv("LED_FONT_FILE");
+        if (!path) path = LED_DEFAULT_FONT;
+        leds->font = load_font(path);
+        if (!leds->font) fprintf(stderr, "[board] cannot load the font %s\n", path);
     }
+    return leds->font;
+}
+
+unsigned draw_board(char board[8][8]) {
+    if (!leds) return 0;
+    pthread_mutex_lock(&leds->lock);
+    memcpy(leds->request_board, board, sizeof(leds->request_board));
+    leds->board_requested = 1;
+    unsigned id = ++leds->request_id;
+    pthread_cond_signal(&leds->wake);
+    pthread_mutex_unlock(&leds->lock);
+    return id;
+}
 
-    // 3) Swap once to update the entire display
-    leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
+int led_board_shown(unsigned id, int64_t *shown_us) {
+    if (!leds) return 0;
+    pthread_mutex_lock(&leds->lock);
+    int shown = (int)(leds->shown_id - id) >= 0;
+    if (shown) *shown_us = leds->shown_us;
+    pthread_mutex_unlock(&leds->lock);
+    return shown;
 }
 
 void led_clear() {
     // Clear all to black and swap immediately
     if(leds){
-        led_canvas_clear(leds->canvas);
-        leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
+        pthread_mutex_lock(&leds->lock);
+        leds->clear_requested = 1;
+        leds->board_requested = 0;
+        leds->request_id++;
+        pthread_cond_signal(&leds->wake);
+        pthread_mutex_unlock(&leds->lock);
     }
 }
 
 void led_delete() {
+    pthread_mutex_lock(&panel_lock);
+    while (panel_state == PANEL_STARTING)
+        pthread_cond_wait(&panel_ready, &panel_lock);
+    panel_state = PANEL_NONE;
+    pthread_mutex_unlock(&panel_lock);
     if (!leds) return;
-    delete_font(leds->font);
+    pthread_mutex_lock(&leds->lock);
+    leds->stopping = 1;
+    pthread_cond_signal(&leds->wake);
+    pthread_mutex_unlock(&leds->lock);
+    pthread_join(leds->thread, NULL);
+    pthread_cond_destroy(&leds->wake);
+    pthread_mutex_destroy(&leds->lock);
+    if (leds->font) delete_font(leds->font);
     led_matrix_delete(leds->matrix);
     free(leds);
+    leds = NULL;
 }
 
 #ifdef D
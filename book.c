@@ -0,0 +1,193 @@
+// book.c
+#include "book.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BOOK_SYMMETRIES 8
+
+static inline int cell(const uint64_t *mask, int sq)
+{
+    return (int)((mask[sq >> 6] >> (sq & 63)) & 1);
+}
+
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Square (r, c) under symmetry s: transposed if bit 2 is set, then the rows
+ * reversed for bit 0 and the columns for bit 1. Each step is its own
+ * inverse, so undoing s applies them in the opposite order.
+ */
+static void transform(int symmetry, int side, int inverse, int *r, int *c)
+{
+    if (inverse) {
+        if (symmetry & 1) *r = side - 1 - *r;
+        if (symmetry & 2) *c = side - 1 - *c;
+    }
+    if (symmetry & 4) { int t = *r; *r = *c; *c = t; }
+    if (!inverse) {
+        if (symmetry & 1) *r = side - 1 - *r;
+        if (symmetry & 2) *c = side - 1 - *c;
+    }
+}
+
+uint64_t book_key(const EnginePosition *pos, int *symmetry)
+{
+    const uint64_t *mine = (pos->to_move == 'R') ? pos->red : pos->blue;
+    const uint64_t *theirs = (pos->to_move == 'R') ? pos->blue : pos->red;
+    int side = pos->width;
+    uint64_t best = UINT64_MAX;
+    int best_symmetry = 0;
+
+    for (int s = 0; s < BOOK_SYMMETRIES; s++) {
+        uint64_t m[2] = { 0, 0 }, o[2] = { 0, 0 }, w[2] = { 0, 0 };
+        for (int sq = 0; sq < side * side; sq++) {
+            int r = sq / side, c = sq % side;
+            transform(s, side, 0, &r, &c);
+            int to = r * side + c;
+            uint64_t bit = 1ULL << (to & 63);
+            if (cell(mine, sq))        m[to >> 6] |= bit;
+            else if (cell(theirs, sq)) o[to >> 6] |= bit;
+            else if (cell(pos->wall, sq)) w[to >> 6] |= bit;
+        }
+        uint64_t key = mix64(m[0] ^ mix64(m[1] ^ mix64(o[0] ^ mix64(o[1] ^
+                       mix64(w[0] ^ mix64(w[1] ^ (uint64_t)side))))));
+        if (key < best) {
+            best = key;
+            best_symmetry = s;
+        }
+    }
+    if (symmetry) *symmetry = best_symmetry;
+    return best;
+}
+
+void book_orient_move(EngineMove *move, int side, int symmetry, int inverse)
+{
+    transform(symmetry, side, inverse, &move->from_row, &move->from_col);
+    transform(symmetry, side, inverse, &move->to_row, &move->to_col);
+}
+
+int book_open(Book *book, const char *path)
+{
+    memset(book, 0, sizeof(*book));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(BookFileHeader)) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE,
+                 fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+
+    const BookFileHeader *h = (const BookFileHeader *)p;
+    if (h->magic != BOOK_MAGIC || h->version != BOOK_VERSION ||
+        h->side < ENGINE_MIN_SIDE || h->side > ENGINE_MAX_SIDE ||
+        (size_t)st.st_size != sizeof(*h) + (size_t)h->count * sizeof(BookEntry)) {
+        munmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    book->side = (int)h->side;
+    book->entries = (const BookEntry *)(h + 1);
+    book->count = h->count;
+    book->map = p;
+    book->map_size = (size_t)st.st_size;
+    return 0;
+}
+
+void book_close(Book *book)
+{
+    if (book->map) munmap(book->map, book->map_size);
+    memset(book, 0, sizeof(*book));
+}
+
+// A move that can be played on 'pos': our piece to an empty square at
+// most two steps away.
+static int playable(const EnginePosition *pos, const EngineMove *m)
+{
+    int side = pos->width;
+    const uint64_t *mine = (pos->to_move == 'R') ? pos->red : pos->blue;
+    int dr = abs(m->to_row - m->from_row), dc = abs(m->to_col - m->from_col);
+    if (dr > 2 || dc > 2 || (dr == 0 && dc == 0)) return 0;
+    if ((dr == 2 || dc == 2) && dr != dc && dr && dc) return 0;
+    int from = m->from_row * side + m->from_col;
+    int to = m->to_row * side + m->to_col;
+    return cell(mine, from) && !cell(pos->red, to) && !cell(pos->blue, to) &&
+           !cell(pos->wall, to);
+}
+
+int book_probe(const Book *book, const EnginePosition *pos, EngineMove *move,
+               int *score, int *depth)
+{
+    if (!book->side || pos->height != book->side || pos->width != book->side) {
+        return 0;
+    }
+    int symmetry;
+    uint64_t key = book_key(pos, &symmetry);
+    uint32_t lo = 0, hi = book->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (book->entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == book->count || book->entries[lo].key != key) return 0;
+
+    const BookEntry *e = &book->entries[lo];
+    int side = book->side;
+    if (e->from >= side * side || e->to >= side * side) return 0;  // malformed book
+    move->from_row = e->from / side;
+    move->from_col = e->from % side;
+    move->to_row = e->to / side;
+    move->to_col = e->to % side;
+    book_orient_move(move, side, symmetry, 1);
+    if (!playable(pos, move)) return 0;
+    *score = e->score;
+    *depth = e->depth;
+    return 1;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t x = ((const BookEntry *)a)->key, y = ((const BookEntry *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+int book_save(const char *path, int side, BookEntry *entries, uint32_t count)
+{
+    qsort(entries, count, sizeof(BookEntry), compare_entries);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (kept == 0 || entries[i].key != entries[kept - 1].key) {
+            entries[kept++] = entries[i];
+        }
+    }
+    count = kept;
+
+    BookFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = BOOK_MAGIC;
+    h.version = BOOK_VERSION;
+    h.side = (uint32_t)side;
+    h.count = count;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(entries, sizeof(BookEntry), count, f) == count;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? (int)count : -1;
+}
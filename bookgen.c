@@ -0,0 +1,225 @@
+// bookgen.c
+//
+// Builds an opening book (see book.h) for the client's -book-file.
+//
+//   ./bookgen -out <book> [-plies <n>] [-depth <plies>] [-time-ms <ms>]
+//             [-threads <n>] [-size <side>] [-eval-file <path>]
+//
+// The book covers every line we can meet in the first -plies plies with
+// either colour: where we are to move only the book's own move is
+// followed, where the opponent is to move every legal reply is. Each of
+// our positions is searched far deeper than a 2.9 s turn allows, the
+// positions of one ply in parallel on all cores, sharing one
+// transposition table.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <limits.h>
+#include "book.h"
+#include "engine.h"
+#include "gamerec.h"
+
+typedef struct {
+    EnginePosition pos;
+    uint64_t       key;
+    int            symmetry;
+    int            ours;               // we are to move: search, else expand
+    int            found;              // the search found a move
+    EngineResult   result;
+} Node;
+
+typedef struct {
+    Node  *nodes;
+    size_t count, capacity;
+} NodeList;
+
+static int search_depth = 12;
+static long long search_time_ms = 20000;
+
+static Node *level;                    // the ply being searched
+static size_t level_count;
+static size_t next_node;               // claimed with __atomic_fetch_add
+
+static void push_node(NodeList *list, const EnginePosition *pos, int ours)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->nodes = (Node *)realloc(list->nodes, list->capacity * sizeof(Node));
+    }
+    Node *n = &list->nodes[list->count++];
+    memset(n, 0, sizeof(*n));
+    n->pos = *pos;
+    n->ours = ours;
+    n->key = book_key(pos, &n->symmetry);
+}
+
+static int compare_nodes(const void *a, const void *b)
+{
+    const Node *x = (const Node *)a, *y = (const Node *)b;
+    if (x->ours != y->ours) return x->ours - y->ours;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+// Merge transpositions and symmetric variations within a ply.
+static void unique_nodes(NodeList *list)
+{
+    if (!list->count) return;
+    qsort(list->nodes, list->count, sizeof(Node), compare_nodes);
+    size_t kept = 1;
+    for (size_t i = 1; i < list->count; i++) {
+        if (compare_nodes(&list->nodes[i], &list->nodes[kept - 1]) != 0) {
+            list->nodes[kept++] = list->nodes[i];
+        }
+    }
+    list->count = kept;
+}
+
+static void play(EnginePosition *pos, const EngineMove *move)
+{
+    GamePly ply;
+    gamerec_make_ply(&ply, move, pos->width, 0, GAMEREC_NO_EVAL, 0);
+    gamerec_apply(pos, &ply);
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&next_node, 1, __ATOMIC_RELAXED);
+        if (i >= level_count) break;
+        Node *n = &level[i];
+        if (!n->ours) continue;
+        EngineLimits limits = { search_depth, get_time_ms() + search_time_ms,
+                                NULL, 0, NULL, 0 };
+        engine_state_next_search();
+        n->found = engine_search(&n->pos, &limits, &n->result) == 1;
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_file = NULL, *eval_file = NULL;
+    int plies = 6, side = 8;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-out") == 0)       out_file = argv[++i];
+        else if (strcmp(argv[i], "-plies") == 0)     plies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-depth") == 0)     search_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-time-ms") == 0)   search_time_ms = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0)   threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-size") == 0)      side = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-eval-file") == 0) eval_file = argv[++i];
+        else { bad_args = 1; break; }
+    }
+    if (bad_args || !out_file || plies < 0 || search_depth <= 0 ||
+        search_time_ms <= 0 || !engine_supports(side, side)) {
+        fprintf(stderr, "Usage: %s -out <book> [-plies <n>] [-depth <plies>] [-time-ms <ms>]\n"
+                        "       [-threads <n>] [-size <side>] [-eval-file <path>]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    if (engine_state_open(NULL) != 0) {
+        fprintf(stderr, "[bookgen] cannot allocate the search state\n");
+        return 1;
+    }
+    if (eval_file && engine_eval_open(eval_file) != 0) {
+        fprintf(stderr, "[bookgen] using the piece count evaluation\n");
+    }
+
+    // The start position both as ours, playing red, and as the opponent's,
+    // playing blue.
+    NodeList current = { NULL, 0, 0 }, next = { NULL, 0, 0 };
+    EnginePosition start;
+    engine_start_position(&start, side);
+    push_node(&current, &start, 1);
+    push_node(&current, &start, 0);
+
+    BookEntry *entries = NULL;
+    uint32_t entry_count = 0, entry_capacity = 0;
+    static EngineMove moves[ENGINE_MAX_MOVES];
+    long long build_start = get_time_ms();
+    pthread_t *workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+
+    for (int ply = 0; ply <= plies && current.count; ply++) {
+        long long t0 = get_time_ms();
+        level = current.nodes;
+        level_count = current.count;
+        next_node = 0;
+        for (int t = 0; t < threads; t++) {
+            pthread_create(&workers[t], NULL, worker_main, NULL);
+        }
+        for (int t = 0; t < threads; t++) pthread_join(workers[t], NULL);
+
+        size_t searched = 0;
+        next.count = 0;
+        for (size_t i = 0; i < current.count; i++) {
+            Node *n = &current.nodes[i];
+            if (n->ours) {
+                searched++;
+                EnginePosition child = n->pos;
+                if (n->found) {
+                    EngineMove m = n->result.move;
+                    book_orient_move(&m, side, n->symmetry, 0);
+                    if (entry_count == entry_capacity) {
+                        entry_capacity = entry_capacity ? entry_capacity * 2 : 1024;
+                        entries = (BookEntry *)realloc(entries, entry_capacity * sizeof(BookEntry));
+                    }
+                    BookEntry *e = &entries[entry_count++];
+                    memset(e, 0, sizeof(*e));
+                    e->key = n->key;
+                    e->from = (uint8_t)(m.from_row * side + m.from_col);
+                    e->to = (uint8_t)(m.to_row * side + m.to_col);
+                    int score = n->result.score;
+                    e->score = (int16_t)(score > INT16_MAX ? INT16_MAX
+                                       : score < INT16_MIN ? INT16_MIN : score);
+                    e->depth = (uint8_t)n->result.depth;
+                    play(&child, &n->result.move);
+                } else {
+                    play(&child, NULL);
+                }
+                push_node(&next, &child, 0);
+            } else {
+                int count = engine_legal_moves(&n->pos, moves);
+                for (int k = 0; k < count; k++) {
+                    EnginePosition child = n->pos;
+                    play(&child, &moves[k]);
+                    push_node(&next, &child, 1);
+                }
+                if (count == 0) {
+                    EnginePosition child = n->pos;
+                    play(&child, NULL);
+                    push_node(&next, &child, 1);
+                }
+            }
+        }
+        printf("ply %d: %zu positions searched in %lld ms\n",
+               ply, searched, get_time_ms() - t0);
+
+        unique_nodes(&next);
+        NodeList t = current;
+        current = next;
+        next = t;
+    }
+    free(workers);
+
+    int status = 0;
+    int written = book_save(out_file, side, entries, entry_count);
+    if (written < 0) {
+        fprintf(stderr, "[bookgen] cannot write %s\n", out_file);
+        status = 1;
+    } else {
+        printf("%d positions for %dx%d written to %s in %lld ms\n",
+               written, side, side, out_file, get_time_ms() - build_start);
+    }
+    free(entries);
+    free(current.nodes);
+    free(next.nodes);
+    engine_state_close();
+    engine_eval_close();
+    return status;
+}
@@ -3,420 +3,725 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <netdb.h>
 #include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <time.h> 
 #include <stdint.h>   // for uint64_t
-#include <limits.h>   // for INT_MIN, INT_MAX
+#include <limits.h>   // for LLONG_MAX
 #include "cJSON.h"
-#include <sys/time.h>
 #include "board.h"
+#include "book.h"
+#include "distsearch.h"
+#include "engine.h"
+#include "gamerec.h"
+#include "latency.h"
+#include "logger.h"
+
+int keep_alive;   // stay connected for the next game after game_over
+static Book book;                // -book-file; empty without one
+static DistPool *workers;        // -workers; searches locally without
+static TurnLatency latency;      // per-turn stage timings, -metrics-file
+
+/*
+ * The LED panel is started building in the background as soon as the server
+ * acknowledges our registration (led_start()): building the RGBMatrix and
+ * mapping GPIO then overlap with waiting for game_start instead of delaying
+ * our first move. board.c keeps the panel for every game this process plays.
+ */
+// One send per line: a newline sent on its own waits (Nagle) for the ACK
+// of the message, which the server delays by some 40 ms.
+void send_json(int sockfd, cJSON *json) {
+    char *msg = cJSON_PrintUnformatted(json);
+    size_t len = strlen(msg);
+    char *line = (char *)realloc(msg, len + 2);
+    if (!line) {
+        free(msg);
+        return;
+    }
+    line[len] = '\n';
+    line[len + 1] = '\0';
+    send(sockfd, line, len + 1, MSG_NOSIGNAL);
+    free(line);
+}
 
-long long get_time_ms() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
+int connect_to_server(const char *ip, const char *port) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    getaddrinfo(ip, port, &hints, &res);
+    int sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    connect(sockfd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    return sockfd;
 }
-long long start_time;
-long long deadline_ms;
 
-/**
- * Build two 64-bit masks from the 8×8 char board:
- *   - red_mask  : all indices (0..63) where board[r][c] == 'R'
- *   - blue_mask : all indices where board[r][c] == 'B'
- *
- * Empty squares ('.') are implicitly where neither mask has a bit set.
+void send_register(int sockfd, const char *username) {
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "register");
+    cJSON_AddStringToObject(msg, "username", username);
+    send_json(sockfd, msg);
+    cJSON_Delete(msg);
+}
+
+void send_move(int sockfd, const char *username, int sx, int sy, int tx, int ty){
+    cJSON *msg = cJSON_CreateObject();
+    
+    cJSON_AddStringToObject(msg, "type", "move");
+    cJSON_AddStringToObject(msg, "username", username);
+    cJSON_AddNumberToObject(msg, "sx", sx);
+    cJSON_AddNumberToObject(msg, "sy", sy);
+    cJSON_AddNumberToObject(msg, "tx", tx);
+    cJSON_AddNumberToObject(msg, "ty", ty);
+    send_json(sockfd, msg);
+    cJSON_Delete(msg);
+}
+
+/*
+ * Our last turn, kept for an invalid_move that repeats its position: the
+ * position is searched again without the moves the server refused there.
+ * The transposition table still holds the first search, so the new one
+ * quickly gets back to its depth with exact scores for the moves left.
  */
-void board_to_bitboards(const char board[8][8],
-                        uint64_t *red_mask,
-                        uint64_t *blue_mask,
-                        uint64_t *wall_mask)
+typedef struct {
+    EnginePosition pos;
+    int            active;             // pos is the position of our last turn
+    EngineMove     sent;               // what we answered, unless we passed
+    int            passed;
+    EngineMove     rejected[ENGINE_MAX_MOVES];
+    int            rejected_count;
+} LastTurn;
+
+// A search again after a refused move gets at most this long: the table
+// brings it back to the first search's depth in a fraction of that.
+#define RETRY_SEARCH_MS 500
+
+/*
+ * One game this process plays: a connection, registered under its own
+ * username. The main thread reads and parses every session's messages; a
+ * your_turn hands the session to the search pool, and its socket is not
+ * read again until the move is sent.
+ */
+typedef struct Session {
+    int            fd;
+    char          *name;
+    char           color;              // 'R' or 'B' once the game started
+    int            open;
+    int            busy;               // a search thread has its turn
+    int            closing;            // hung up while busy, see session_close
+    int            leds;               // this session's games are drawn
+    size_t         len;
+    char           buffer[4096];
+    int64_t        recv_us;            // when buffer was last filled
+    long long      recv_ms;
+    char           board[ENGINE_MAX_SIDE][ENGINE_MAX_SIDE + 1];
+    const char    *rows[ENGINE_MAX_SIDE];
+    int            height, width;
+    int            retry;              // the turn answers invalid_move
+    long long      turn_ms;            // the turn's message arrived
+    long long      deadline_ms;        // its share of the search threads
+    int            turns;              // of the current game
+    GameRecorder   recorder;           // -record-file; does nothing without one
+    LastTurn       last_turn;
+    LatencyTurn    timing;
+    unsigned       draw_id;            // board on its way to the panel, or 0
+    struct Session *next;              // in the pool's queue or done list
+} Session;
+
+static int same_position(const EnginePosition *a, const EnginePosition *b)
 {
-    *red_mask  = 0ULL;
-    *blue_mask = 0ULL;
-    *wall_mask = 0ULL;
-
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            int idx = r * 8 + c;
-            uint64_t bit = 1ULL << idx;
-            if (board[r][c] == 'R') {
-                *red_mask |= bit;
-            } else if (board[r][c] == 'B') {
-                *blue_mask |= bit;
-            } else if (board[r][c] == '#') {
-                *wall_mask |= bit;
-            }
-            // else '.' → do nothing
-        }
+    return a->height == b->height && a->width == b->width &&
+           a->to_move == b->to_move &&
+           memcmp(a->red, b->red, sizeof(a->red)) == 0 &&
+           memcmp(a->blue, b->blue, sizeof(a->blue)) == 0 &&
+           memcmp(a->wall, b->wall, sizeof(a->wall)) == 0;
+}
+
+static int same_move(const EngineMove *a, const EngineMove *b)
+{
+    return a->from_row == b->from_row && a->from_col == b->from_col &&
+           a->to_row == b->to_row && a->to_col == b->to_col;
+}
+
+static int move_rejected(const LastTurn *last_turn, const EngineMove *move)
+{
+    for (int i = 0; i < last_turn->rejected_count; i++) {
+        if (same_move(move, &last_turn->rejected[i])) return 1;
     }
+    return 0;
+}
+
+static void send_engine_move(Session *s, const EngineMove *move)
+{
+    if (move) {
+        s->last_turn.sent = *move;
+        s->last_turn.passed = 0;
+        send_move(s->fd, s->name, move->from_row + 1, move->from_col + 1,
+                  move->to_row + 1, move->to_col + 1);
+    } else {
+        s->last_turn.passed = 1;
+        send_move(s->fd, s->name, 0, 0, 0, 0);
+    }
+    latency_mark(&s->timing, LATENCY_SENT);
 }
 
 /**
- * Apply one move on bitboards. 'from' and 'to' are indices 0..63.
- *   - If |dr| or |dc| == 2, it’s a jump: remove the bit at 'from'.
- *   - Otherwise (distance==1), it’s a clone: keep the bit at 'from'.
- * Then place your bit at 'to' and flip any adjacent opponent bits.
- *
- * @param my_mask      current player's bitboard
- * @param opp_mask     opponent's bitboard
- * @param from         source index (0..63)
- * @param to           destination index (0..63)
- * @param new_my_mask  [out] updated player's bitboard
- * @param new_opp_mask [out] updated opponent's bitboard
+ * Search the position the server sent a session and reply with the best
+ * move. Runs on a search thread.
+ *   - Builds the bitboards for any supported board size
+ *   - Plays the opening book's move at once if it has the position, unless
+ *     'retry' says the server just rejected our move here
+ *   - On a retry, searches again without the moves the server refused
+ *   - Deepens iteratively until the turn's deadline (its share of the
+ *     2.9 s since the message arrived, see search_main), reusing the
+ *     shared transposition table and history; only the search context
+ *     (move stacks, PV, region cache) belongs to this thread
+ *   - Sends the best move (1-based) via send_move(...), or 0 0 0 0 to pass
  */
-void apply_move_bitboard(uint64_t my_mask,
-                         uint64_t opp_mask,
-                         int from,
-                         int to,
-                         uint64_t *new_my_mask,
-                         uint64_t *new_opp_mask)
-{
-    uint64_t bit_from = 1ULL << from;
-    uint64_t bit_to   = 1ULL << to;
-    int fr = from / 8, fc = from % 8;
-    int tr = to   / 8, tc = to   % 8;
-
-    uint64_t my_new  = my_mask;
-    uint64_t opp_new = opp_mask;
-
-    // If jump (distance 2), remove original
-    int dr = (tr > fr) ? (tr - fr) : (fr - tr);
-    int dc = (tc > fc) ? (tc - fc) : (fc - tc);
-    if (dr == 2 || dc == 2) {
-        my_new &= ~bit_from;
-    }
-    // Place at 'to'
-    my_new |= bit_to;
-
-    // Flip any opponent bits adjacent to 'to'
-    static const int dr8[8] = {-1,-1, 0,+1,+1,+1, 0,-1};
-    static const int dc8[8] = { 0,+1,+1,+1, 0,-1,-1,-1};
-    for (int d = 0; d < 8; d++) {
-        int nr = tr + dr8[d];
-        int nc = tc + dc8[d];
-        if (nr < 0 || nr > 7 || nc < 0 || nc > 7) continue;
-        int nidx = nr*8 + nc;
-        uint64_t bit_n = 1ULL << nidx;
-        if (opp_new & bit_n) {
-            opp_new &= ~bit_n;
-            my_new &= ~bit_n;
-            my_new |= bit_n;
+void generate_move(Session *s) {
+    LastTurn *last_turn = &s->last_turn;
+    int retry = s->retry;
+    long long start_time = get_time_ms();
+    EnginePosition pos;
+    if (engine_position_from_rows(&pos, s->rows, s->height, s->width, s->color) != 0) {
+        LOG(LOG_WARN, "[client] %s: unsupported board %dx%d", s->name,
+            s->height, s->width);
+        last_turn->active = 0;
+        send_move(s->fd, s->name, 0, 0, 0, 0);
+        latency_mark(&s->timing, LATENCY_SENT);
+        return;
+    }
+    latency_mark(&s->timing, LATENCY_BOARD);
+    gamerec_observe(&s->recorder, &pos, s->color);
+
+    if (retry && last_turn->active && same_position(&pos, &last_turn->pos)) {
+        if (!last_turn->passed && !move_rejected(last_turn, &last_turn->sent) &&
+            last_turn->rejected_count < ENGINE_MAX_MOVES) {
+            last_turn->rejected[last_turn->rejected_count++] = last_turn->sent;
         }
+    } else {
+        last_turn->pos = pos;
+        last_turn->active = 1;
+        last_turn->rejected_count = 0;
+    }
+
+    EngineMove book_move;
+    int book_score, book_depth;
+    if (!retry && book_probe(&book, &pos, &book_move, &book_score, &book_depth)) {
+        long long elapsed = get_time_ms() - start_time;
+        LOG(LOG_INFO, "[client] %s: book move, score %d at depth %d, in %lld ms",
+            s->name, book_score, book_depth, elapsed);
+        gamerec_record_move(&s->recorder, &book_move, (int)elapsed,
+                            book_score, book_depth);
+        send_engine_move(s, &book_move);
+        return;
     }
 
-    *new_my_mask  = my_new;
-    *new_opp_mask = opp_new;
+    if (retry) {
+        LOG(LOG_INFO, "[client] %s: move refused, searching without %d move(s)",
+            s->name, last_turn->rejected_count);
+    }
+    if (!retry) engine_state_next_search();
+    EngineResult result;
+    EngineLimits limits = { 0, s->deadline_ms, NULL, 0,
+                            last_turn->rejected, last_turn->rejected_count };
+    if (retry && limits.deadline_ms > start_time + RETRY_SEARCH_MS)
+        limits.deadline_ms = start_time + RETRY_SEARCH_MS;
+    latency_mark(&s->timing, LATENCY_SEARCH_START);
+    int found = workers ? dist_search(workers, &pos, &limits, &result)
+                        : engine_search(&pos, &limits, &result);
+    latency_mark(&s->timing, LATENCY_SEARCH_END);
+    if (found != 1) {
+        gamerec_record_move(&s->recorder, NULL, (int)(get_time_ms() - start_time),
+                            result.score, result.depth);
+        send_engine_move(s, NULL);
+        return;
+    }
+
+    static const char *const stop_names[] = {
+        "depth", "time", "only move", "easy move", "proven", "cancelled",
+        "nodes"
+    };
+    long long elapsed = get_time_ms() - start_time;
+    LOG(LOG_INFO, "[client] %s: depth %d score %d (%s): %llu nodes in %lld ms (%llu nps), %lld ms banked",
+           s->name, result.depth, result.score, stop_names[result.stop_reason],
+           result.nodes, elapsed,
+           elapsed > 0 ? result.nodes * 1000ULL / elapsed : 0ULL,
+           limits.deadline_ms - get_time_ms());
+
+    gamerec_record_move(&s->recorder, &result.move, (int)elapsed,
+                        result.score, result.depth);
+    send_engine_move(s, &result.move);
 }
 
+// Fixed positions for -bench: opening, early middle game, crowded board,
+// and a 10×10 middle game for the two-word specialization.
+static const struct {
+    int size;
+    const char *rows[ENGINE_MAX_SIDE];
+} bench_positions[] = {
+    { 8, { "R......B", "........", "........", "........",
+           "........", "........", "........", "B......R" } },
+    { 8, { "RR....BB", "R.#..#.B", "..R..B..", "...RB...",
+           "...BR...", "..B..R..", "B.#..#.R", "BB....RR" } },
+    { 8, { "RRR.BBBB", "RR#BB.BB", "R.RRB.B.", "RRB.BRR.",
+           ".BBRR.RR", "BB.RRBBR", "B.#RR#BR", "BBBR.RRR" } },
+    { 10, { "RR......BB", "R.#....#.B", "..R....B..", "...R..B...",
+            "....RB....", "....BR....", "...B..R...", "..B....R..",
+            "B.#....#.R", "BB......RR" } },
+};
 
 /**
- * Evaluate (my_mask vs. opp_mask) as popcount(my) - popcount(opp).
+ * Search every bench position to a fixed depth and report nodes/sec.
+ * There is no deadline and every position starts from an empty table, so
+ * the numbers only depend on the engine.
  */
-static inline int evaluate_board(uint64_t my_mask, uint64_t opp_mask)
+static void run_bench(int depth)
 {
-    return __builtin_popcountll(my_mask)
-         - __builtin_popcountll(opp_mask);
+    unsigned long long total_nodes = 0;
+    long long total_ms = 0;
+    int count = (int)(sizeof(bench_positions) / sizeof(bench_positions[0]));
+
+    for (int i = 0; i < count; i++) {
+        EnginePosition pos;
+        engine_position_from_rows(&pos, bench_positions[i].rows,
+                                  bench_positions[i].size,
+                                  bench_positions[i].size, 'R');
+        engine_state_clear();
+        EngineLimits limits = { depth, LLONG_MAX, NULL, 0, NULL, 0 };
+        EngineResult result;
+        long long start_time = get_time_ms();
+        engine_search(&pos, &limits, &result);
+        long long elapsed = get_time_ms() - start_time;
+        total_nodes += result.nodes;
+        total_ms += elapsed;
+        printf("position %d (%dx%d): best %d,%d->%d,%d score %d, %llu nodes, %lld ms\n",
+               i + 1, pos.height, pos.width,
+               result.move.from_row, result.move.from_col,
+               result.move.to_row, result.move.to_col, result.score,
+               result.nodes, elapsed);
+    }
+    printf("bench depth %d: %llu nodes in %lld ms (%llu nps)\n",
+           depth, total_nodes, total_ms,
+           total_ms > 0 ? total_nodes * 1000ULL / total_ms : 0ULL);
+
+    // Node types against a single alpha-beta function on the 8×8 middle
+    // game, deepened the same way without the root's extras.
+    EnginePosition pos;
+    engine_position_from_rows(&pos, bench_positions[1].rows, 8, 8, 'R');
+    unsigned long long typed_nodes, plain_nodes;
+    double typed = engine_search_rate(&pos, depth, ENGINE_SEARCH_NODE_TYPES,
+                                      &typed_nodes);
+    double plain = engine_search_rate(&pos, depth, ENGINE_SEARCH_PLAIN,
+                                      &plain_nodes);
+    printf("search: node types %llu nodes at %.2fM nps, plain %llu nodes at %.2fM nps"
+           " (%.2fx faster to depth)\n",
+           typed_nodes, typed / 1e6, plain_nodes, plain / 1e6,
+           typed > 0 && plain > 0 ? (plain_nodes / plain) / (typed_nodes / typed) : 0.0);
+
+    // Leaf evaluation speed on the 8×8 middle game.
+    double material = engine_eval_rate(&pos, ENGINE_EVAL_MATERIAL);
+    double patterns = engine_eval_rate(&pos, ENGINE_EVAL_PATTERNS);
+    printf("eval: piece count %.1fM/s", material / 1e6);
+    if (patterns > 0) {
+        printf(", patterns %.1fM/s (%.1fM/s from scratch)\n", patterns / 1e6,
+               engine_eval_rate(&pos, ENGINE_EVAL_PATTERNS_FULL) / 1e6);
+    } else {
+        printf(", patterns not loaded\n");
+    }
 }
+
 /**
- * List every legal move for 'my_mask' given opponent's bits in 'opp_mask'.
- * No walls exist, so occupancy = my_mask | opp_mask.
- *
- * @param my_mask
- * @param opp_mask
- * @param wall_mask
- * @param from_list  array of size ≥1024; write source indexes (0..63)
- * @param to_list    parallel array; write destination indexes
- * @return number of moves found
+ * Search the bench positions to a fixed depth on the workers in 'spec' and
+ * here alone, from empty tables both times, and report the speed-up.
  */
-static int generate_moves_bitboard(uint64_t my_mask,
-                                   uint64_t opp_mask,
-                                   uint64_t wall_mask,
-                                   int *from_list,
-                                   int *to_list)
+static int run_bench_workers(const char *spec, int depth)
 {
-    uint64_t occupancy = my_mask | opp_mask | wall_mask;
-    int move_count = 0;
-
-    static const int dr8[8] = {-1,-1, 0,+1,+1,+1, 0,-1};
-    static const int dc8[8] = { 0,+1,+1,+1, 0,-1,-1,-1};
-
-    uint64_t tmp = my_mask;
-    while (tmp) {
-        int from_idx = __builtin_ctzll(tmp);
-        tmp &= tmp - 1ULL;
-        int r = from_idx / 8, c = from_idx % 8;
-
-        // Clone (m=1) and jump (m=2)
-        for (int m = 1; m <= 2; m++) {
-            for (int d = 0; d < 8; d++) {
-                int nr = r + dr8[d]*m;
-                int nc = c + dc8[d]*m;
-                if (nr < 0 || nr > 7 || nc < 0 || nc > 7) continue;
-                int to_idx = nr*8 + nc;
-                if ((occupancy & (1ULL << to_idx)) == 0ULL) {
-                    from_list[move_count] = from_idx;
-                    to_list[move_count]   = to_idx;
-                    move_count++;
-                }
-            }
-        }
+    DistPool *pool = dist_open(spec);
+    if (!pool) {
+        fprintf(stderr, "[client] bad worker list %s\n", spec);
+        return 1;
     }
-    return move_count;
+    printf("%d of the workers up\n", dist_workers(pool));
+    long long local_ms = 0, dist_ms = 0;
+    int count = (int)(sizeof(bench_positions) / sizeof(bench_positions[0]));
+
+    for (int i = 0; i < count; i++) {
+        EnginePosition pos;
+        engine_position_from_rows(&pos, bench_positions[i].rows,
+                                  bench_positions[i].size,
+                                  bench_positions[i].size, 'R');
+        EngineLimits limits = { depth, LLONG_MAX, NULL, 0, NULL, 0 };
+        EngineResult local, dist;
+        engine_state_clear();
+        long long start_time = get_time_ms();
+        engine_search(&pos, &limits, &local);
+        long long local_elapsed = get_time_ms() - start_time;
+        dist_clear(pool);
+        start_time = get_time_ms();
+        dist_search(pool, &pos, &limits, &dist);
+        long long dist_elapsed = get_time_ms() - start_time;
+        local_ms += local_elapsed;
+        dist_ms += dist_elapsed;
+        printf("position %d (%dx%d): local score %d, %llu nodes in %lld ms; "
+               "distributed score %d, %llu nodes in %lld ms\n",
+               i + 1, pos.height, pos.width, local.score, local.nodes,
+               local_elapsed, dist.score, dist.nodes, dist_elapsed);
+    }
+    printf("bench depth %d on %d workers: %lld ms local, %lld ms distributed (%.2fx)\n",
+           depth, dist_workers(pool), local_ms, dist_ms,
+           dist_ms > 0 ? (double)local_ms / dist_ms : 0.0);
+    dist_close(pool);
+    return 0;
 }
-/**
- * @param my_mask   current player's bits
- * @param opp_mask  opponent's bits
- * @param wall_mask wall bits
- * @param depth     how many plies left
- * @param alpha
- * @param beta
- *
- * Returns best score from “my” perspective.
+
+
+/*
+ * Search pool. Sessions whose turn it is wait in a FIFO for one of the
+ * threads; a thread searches, sends the move and puts the session on the
+ * done list, then wakes the event loop through an eventfd. Every thread
+ * shares the one transposition table.
  */
-int minimax_bitboard(uint64_t my_mask,
-                     uint64_t opp_mask,
-                     uint64_t wall_mask,
-                     int depth,
-                     int alpha,
-                     int beta)
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_ready = PTHREAD_COND_INITIALIZER;
+static Session *queue_head, *queue_tail;
+static int      queue_len;
+static int      search_threads;
+static Session *done_list;
+static int      done_fd = -1;
+static int      stopping;
+static int      open_sessions;   // event loop only
+
+static void *search_main(void *arg)
 {
-    if (get_time_ms() >= deadline_ms) {
-        return evaluate_board(my_mask, opp_mask);
-    }
-    if (depth == 0) {
-        return evaluate_board(my_mask, opp_mask);
-    }
-
-    int from_list[1024], to_list[1024];
-    int move_count = generate_moves_bitboard(my_mask, opp_mask, wall_mask,
-                                             from_list, to_list);
-    if (move_count == 0) {
-        return evaluate_board(my_mask, opp_mask);
-    }
-
-    int best = INT_MIN;
-    for (int i = 0; i < move_count; i++) {
-        uint64_t nm, no;
-        apply_move_bitboard(my_mask, opp_mask,
-                            from_list[i], to_list[i],
-                            &nm, &no);
-        int score = -minimax_bitboard(no, nm, wall_mask,
-                                      depth - 1,
-                                      -beta, -alpha);
-        if (score > best) {
-            best = score;
+    (void)arg;
+    engine_prepare(8, 8);   // this thread's context for the common size
+
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!stopping && !queue_head) {
+            pthread_cond_wait(&queue_ready, &queue_lock);
         }
-        if (score > alpha) {
-            alpha = score;
-            if (alpha >= beta) {
-                break;  // cutoff
-            }
+        if (stopping) break;
+        Session *s = queue_head;
+        queue_head = s->next;
+        if (!queue_head) queue_tail = NULL;
+        queue_len--;
+        // What is left of the 2.9 s is shared with the turns queued
+        // behind this one, so that none of them is left without a search.
+        long long now = get_time_ms();
+        long long left = s->turn_ms + 2900 - now;
+        if (queue_len >= search_threads && left > 0)
+            left = left * search_threads / (queue_len + 1);
+        s->deadline_ms = now + (left > 0 ? left : 0);
+        pthread_mutex_unlock(&queue_lock);
+
+        generate_move(s);
+
+        pthread_mutex_lock(&queue_lock);
+        s->next = done_list;
+        done_list = s;
+        uint64_t one = 1;
+        if (write(done_fd, &one, sizeof(one)) < 0) {
+            LOG(LOG_WARN, "[client] cannot wake the event loop");
         }
     }
-    return best;
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
 }
 
+static void search_submit(Session *s)
+{
+    pthread_mutex_lock(&queue_lock);
+    s->next = NULL;
+    if (queue_tail) queue_tail->next = s;
+    else queue_head = s;
+    queue_tail = s;
+    queue_len++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
 
-char *name;
+// A busy session keeps its socket until its search comes back: the search
+// thread still sends the move on it and updates the session.
+static void session_close(int epfd, Session *s)
+{
+    if (!s->open) return;
+    if (!s->closing) epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    if (s->busy) {
+        s->closing = 1;
+        return;
+    }
+    close(s->fd);
+    s->open = 0;
+    s->closing = 0;
+    open_sessions--;
+}
 
-void send_json(int sockfd, cJSON *json) {
-    char *msg = cJSON_PrintUnformatted(json);
-    send(sockfd, msg, strlen(msg), 0);
-    send(sockfd, "\n", 1, 0);
-    free(msg);
+// Read a line's board into the session. Returns 1 if it had one.
+static int session_board(Session *s, const cJSON *msg)
+{
+    const cJSON *board = cJSON_GetObjectItem(msg, "board");
+    if (!cJSON_IsArray(board)) return 0;
+    LOG(LOG_DEBUG, "Current board:");
+    int board_size = cJSON_GetArraySize(board);
+    if (board_size > ENGINE_MAX_SIDE) board_size = ENGINE_MAX_SIDE;
+    s->height = board_size;
+    s->width = 0;
+    for (int i = 0; i < board_size; i++) {
+        const cJSON *row = cJSON_GetArrayItem(board, i);
+        if (cJSON_IsString(row) && row->valuestring != NULL) {
+            LOG(LOG_DEBUG, "%s", row->valuestring);
+            strncpy(s->board[i], row->valuestring, ENGINE_MAX_SIDE);
+            s->board[i][ENGINE_MAX_SIDE] = '\0';
+            s->width = (int)strlen(s->board[i]);
+        } else {
+            s->board[i][0] = '\0';
+        }
+        s->rows[i] = s->board[i];
+    }
+    return 1;
 }
 
-int connect_to_server(const char *ip, const char *port) {
-    struct addrinfo hints, *res;
-    memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    getaddrinfo(ip, port, &hints, &res);
-    int sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    connect(sockfd, res->ai_addr, res->ai_addrlen);
-    freeaddrinfo(res);
-    return sockfd;
+// Once the panel has shown the board the session's last turn drew, give
+// the time it did to that turn.
+static void session_draw_shown(Session *s)
+{
+    int64_t shown_us;
+    if (s->draw_id && led_board_shown(s->draw_id, &shown_us)) {
+        latency_draw_shown(&latency, &s->timing, shown_us);
+        s->draw_id = 0;
+    }
 }
 
-void send_register(int sockfd, const char *username) {
-    cJSON *msg = cJSON_CreateObject();
-    cJSON_AddStringToObject(msg, "type", "register");
-    cJSON_AddStringToObject(msg, "username", username);
-    send_json(sockfd, msg);
-    cJSON_Delete(msg);
+// Handle one message of a session's server. May close the session or hand
+// its turn to the search pool.
+static void session_message(int epfd, Session *s, const cJSON *msg)
+{
+    const cJSON *type = cJSON_GetObjectItem(msg, "type");
+    session_draw_shown(s);
+    int has_board = session_board(s, msg);
+    int64_t parsed_us = latency_now_us();
+    if (!cJSON_IsString(type)){
+        LOG(LOG_WARN, "[client] %s: server message corrupted", s->name);
+    } else if (strcmp(type->valuestring, "game_over") == 0) {
+        // print results
+        const cJSON *scores = cJSON_GetObjectItem(msg, "scores");
+        int my_score = 0, their_score = 0;
+        if (scores) {
+            cJSON *entry = NULL;
+            cJSON_ArrayForEach(entry, scores) {
+                const char *uname = entry->string;
+                int score = entry->valueint;
+                LOG(LOG_INFO, "%s: %d points", uname, score);
+                if (uname && strcmp(uname, s->name) == 0) my_score = score;
+                else their_score = score;
+            }
+        }
+        EnginePosition final_pos;
+        int have_final = has_board &&
+            engine_position_from_rows(&final_pos, s->rows, s->height, s->width,
+                                      s->color) == 0;
+        gamerec_finish(&s->recorder, have_final ? &final_pos : NULL,
+                       s->color == 'R' ? my_score : their_score,
+                       s->color == 'R' ? their_score : my_score);
+        engine_state_sync();
+        latency_report(&latency);
+        if (keep_alive) {
+            if (s->leds) led_clear();
+            s->color = 0;
+            s->turns = 0;
+        } else {
+            session_close(epfd, s);
+        }
+    } else if  (strcmp(type->valuestring, "register_ack") == 0) {
+        LOG(LOG_INFO, "[client] %s registered", s->name);
+        if (s->leds) led_start();
+    } else if (strcmp(type->valuestring, "register_nack") == 0) {
+        LOG(LOG_ERROR, "[client] register failed for %s", s->name);
+        session_close(epfd, s);
+    } else if (strcmp(type->valuestring, "game_start") == 0) {
+        LOG(LOG_INFO, "[client] %s: game started", s->name);
+        const cJSON *first_player = cJSON_GetObjectItem(msg, "first_player");
+        if (cJSON_IsString(first_player) && strcmp(first_player->valuestring, s->name) == 0)
+            s->color = 'R';
+        else
+            s->color = 'B';
+        if (s->leds) {
+            int64_t wait_us = latency_now_us();
+            struct LedPanelSettings *panel = led_initialize();
+            wait_us = latency_now_us() - wait_us;
+            if (!panel) {
+                LOG(LOG_ERROR, "Failed to initialize LED panel");
+                session_close(epfd, s);
+            } else {
+                LOG(LOG_INFO, "[client] %s: panel ready, game start waited %.3f ms",
+                    s->name, wait_us / 1000.0);
+            }
+        }
+    } else if (strcmp(type->valuestring, "your_turn") == 0 || strcmp(type->valuestring, "invalid_move") == 0) {
+        s->retry = strcmp(type->valuestring, "invalid_move") == 0;
+        if (s->retry)
+            gamerec_undo_move(&s->recorder);
+        else
+            s->turns++;
+        s->turn_ms = s->recv_ms;
+        latency_begin_turn(&latency, &s->timing, s->recv_us, parsed_us, s->retry);
+        s->draw_id = 0;
+        if (s->leds && s->height == 8 && s->width == 8) {
+            char panel[8][8];
+            for (int i = 0; i < 8; i++) memcpy(panel[i], s->board[i], 8);
+            latency_mark(&s->timing, LATENCY_DRAW_SUBMITTED);
+            s->draw_id = draw_board(panel);
+        }
+        // Not read again until the move is sent.
+        struct epoll_event ev = { 0, { s } };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &ev);
+        s->busy = 1;
+        search_submit(s);
+    }
 }
 
-void send_move(int sockfd, int sx, int sy, int tx, int ty){
-    cJSON *msg = cJSON_CreateObject();
-    
-    cJSON_AddStringToObject(msg, "type", "move");
-    cJSON_AddStringToObject(msg, "username", name);
-    cJSON_AddNumberToObject(msg, "sx", sx);
-    cJSON_AddNumberToObject(msg, "sy", sy);
-    cJSON_AddNumberToObject(msg, "tx", tx);
-    cJSON_AddNumberToObject(msg, "ty", ty);
-    send_json(sockfd, msg);
-    cJSON_Delete(msg);
+// Handle the complete lines in a session's buffer, up to a turn.
+static void session_lines(int epfd, Session *s)
+{
+    char *p;
+    while (s->open && !s->busy && (p = strchr(s->buffer, '\n')) != NULL) {
+        *p = '\0';
+        cJSON *msg = cJSON_Parse(s->buffer);
+        if (msg) {
+            // The line we just parsed is the JSON; no need to re-serialize it.
+            LOG(LOG_DEBUG, "Received JSON from server:");
+            LOG_RAW(LOG_DEBUG, s->buffer, (size_t)(p - s->buffer));
+            session_message(epfd, s, msg);
+            cJSON_Delete(msg);
+        }
+        // move remaining data forward
+        s->len -= (p - s->buffer + 1);
+        memmove(s->buffer, p + 1, s->len);
+        s->buffer[s->len] = '\0';
+    }
 }
 
-int in_board(int x) {
-    return 0 < x && x < 9;
+static void session_read(int epfd, Session *s)
+{
+    if (s->len + 1 >= sizeof(s->buffer)) {
+        LOG(LOG_WARN, "[client] %s: line too long, dropped", s->name);
+        s->len = 0;
+    }
+    ssize_t n = recv(s->fd, s->buffer + s->len, sizeof(s->buffer) - s->len - 1, 0);
+    s->recv_us = latency_now_us();
+    s->recv_ms = get_time_ms();
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+    if (n <= 0) {
+        LOG(LOG_WARN, "[client] %s: server disconnected", s->name);
+        session_close(epfd, s);
+        return;
+    }
+    s->len += n;
+    s->buffer[s->len] = '\0';
+    session_lines(epfd, s);
 }
 
-int dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
-int dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
-typedef struct {
-    int sx, sy, tx, ty;
-} Move;
 /**
- * Should replace your old generate_move.
- *   - Converts 8×8 array to (red_mask, blue_mask)
- *   - Chooses my_mask vs. opp_mask based on 'c'
- *   - Generates all root moves; if too many, use depth=5, else depth=6
- *   - Runs minimax on each root move to pick the best
- *   - Sends that move via send_move(...)
+ * Play every session until all are closed: one epoll loop reads the
+ * servers, 'threads' search threads answer the turns.
  */
-void generate_move(int sockfd, const char board[8][8], char c) {
-    start_time = get_time_ms();
-    deadline_ms = start_time + 2900;
-    uint64_t red_mask, blue_mask, wall_mask;
-    board_to_bitboards(board, &red_mask, &blue_mask, &wall_mask);
-
-    // Determine which is “my” bitboard
-    uint64_t my_mask  = (c == 'R') ? red_mask  : blue_mask;
-    uint64_t opp_mask = (c == 'R') ? blue_mask : red_mask;
-
-    int from_root[1024], to_root[1024];
-    int root_moves = generate_moves_bitboard(my_mask, opp_mask, wall_mask,
-                                             from_root, to_root);
-
-    if (root_moves == 0) {
-        send_move(sockfd, 0, 0, 0, 0);
+void run_sessions(Session *sessions, int count, int threads)
+{
+    int epfd = epoll_create1(0);
+    done_fd = eventfd(0, EFD_NONBLOCK);
+    if (epfd < 0 || done_fd < 0) {
+        LOG(LOG_ERROR, "[error] unable to create the event loop");
+        if (epfd >= 0) close(epfd);
+        if (done_fd >= 0) close(done_fd);
         return;
     }
-
-    int max_depth = (root_moves > 60) ? 5 : 6;
-    int best_from = -1, best_to = -1;
-    int alpha = INT_MIN, beta = INT_MAX;
-
-    for (int i = 0; i < root_moves; i++) {
-        uint64_t nm, no;
-        apply_move_bitboard(my_mask, opp_mask,
-                            from_root[i], to_root[i],
-                            &nm, &no);
-        int score = -minimax_bitboard(no, nm, wall_mask,
-                                      max_depth - 1,
-                                      -beta, -alpha);
-        if (score > alpha) {
-            alpha = score;
-            best_from = from_root[i];
-            best_to   = to_root[i];
-        }
+    struct epoll_event ev = { EPOLLIN, { NULL } };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, done_fd, &ev);
+    open_sessions = 0;
+    for (int i = 0; i < count; i++) {
+        if (!sessions[i].open) continue;
+        ev.data.ptr = &sessions[i];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, sessions[i].fd, &ev);
+        open_sessions++;
     }
 
-    int fr = best_from / 8, fc = best_from % 8;
-    int tr = best_to   / 8, tc = best_to   % 8;
-    send_move(sockfd,
-              fr + 1, fc + 1,
-              tr + 1, tc + 1);
-}
-
+    pthread_t *pool = (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+    int started = 0;
+    while (pool && started < threads &&
+           pthread_create(&pool[started], NULL, search_main, NULL) == 0) {
+        started++;
+    }
+    search_threads = started;
+    if (started == 0) {
+        LOG(LOG_ERROR, "[error] unable to start a search thread");
+        open_sessions = 0;
+    }
 
-//void *handle_socket(void *arg){
-void handle_socket(int sockfd){
-    //int sockfd = (intptr_t)arg;
-    char buffer[1024], board_local[8][8]; size_t len = 0; char *p; ssize_t n;
-    int exit = 1;
-    char c = 0;
-    while (exit) {
-        n = recv(sockfd, buffer + len, sizeof(buffer) - len - 1, 0);
-        if (n <= 0) {
-            led_clear();
-            led_delete();
-            printf("server disconnected");
-            return;
+    struct epoll_event events[64];
+    while (open_sessions > 0) {
+        int n = epoll_wait(epfd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG(LOG_ERROR, "[error] event loop failed");
+            break;
         }
-        len += n;
-        buffer[len] = '\0';
-
-        while ((p = strchr(buffer, '\n')) != NULL) {
-            *p = '\0';
-            cJSON *msg = cJSON_Parse(buffer);
-            if (msg) {
-                char *dump = cJSON_PrintUnformatted(msg);
-                printf("Received JSON from server:\n%s\n", dump);
-                free(dump);
-                const cJSON *type = cJSON_GetObjectItem(msg, "type");
-                const cJSON *board = cJSON_GetObjectItem(msg, "board");
-                if (cJSON_IsArray(board)){
-                    printf("Current board:\n");
-                    int board_size = cJSON_GetArraySize(board);
-                    for (int i = 0; i < board_size; i++) {
-                        const cJSON *row = cJSON_GetArrayItem(board, i);
-                        if (cJSON_IsString(row) && row->valuestring != NULL) {
-                            printf("%s\n", row->valuestring);
-                            memcpy(board_local[i], row->valuestring, 8);
-                        }
-                    }
+        for (int i = 0; i < n; i++) {
+            Session *s = (Session *)events[i].data.ptr;
+            if (s) {
+                session_read(epfd, s);
+                continue;
+            }
+            uint64_t wakeups;
+            if (read(done_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+                LOG(LOG_WARN, "[client] cannot read the event loop's wakeups");
+            }
+            pthread_mutex_lock(&queue_lock);
+            Session *done = done_list;
+            done_list = NULL;
+            pthread_mutex_unlock(&queue_lock);
+            for (; done; done = done->next) {
+                done->busy = 0;
+                latency_end_turn(&latency, &done->timing, done->name, done->turns);
+                session_draw_shown(done);
+                if (done->closing) {
+                    session_close(epfd, done);
+                    continue;
                 }
-                if (!cJSON_IsString(type)){
-                    printf("server message corrupted\n");
-                } else if (strcmp(type->valuestring, "game_over") == 0) {
-                    // print results
-                    const cJSON *scores = cJSON_GetObjectItem(msg, "scores");
-                    if (scores) {
-                        cJSON *entry = NULL;
-                        cJSON_ArrayForEach(entry, scores) {
-                            const char *uname = entry->string;
-                            int score = entry->valueint;
-                            printf("%s: %d points\n", uname, score);
-                        }
-                    }
-                    exit = 0;
-                    break;
-                    //return NULL;
-                } else if  (strcmp(type->valuestring, "register_ack") == 0) {
-                    printf("[client] registered\n");
-                } else if (strcmp(type->valuestring, "register_nack") == 0) {
-                    printf("[client] register failed\n");
-                    cJSON_Delete(msg);
-                    exit = 0;
-                    break;
-                    //return NULL;
-                } else if (strcmp(type->valuestring, "game_start") == 0) {
-                    printf("[client] game started\n");
-                    const cJSON *first_player = cJSON_GetObjectItem(msg, "first_player");
-                    if (cJSON_IsString(first_player) && strcmp(first_player->valuestring, name) == 0)
-                        c = 'R';
-                    else
-                        c = 'B';
-                    if (!led_initialize()) {
-                        fprintf(stderr, "Failed to initialize LED panel\n");
-                        exit = 0;
-                        break;
-                    }
-                } else if (strcmp(type->valuestring, "your_turn") == 0 || strcmp(type->valuestring, "invalid_move") == 0) {
-                    draw_board(board_local);
-                    generate_move(sockfd, board_local, c);
+                session_lines(epfd, done);
+                if (done->open && !done->busy) {
+                    struct epoll_event in = { EPOLLIN, { done } };
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, done->fd, &in);
                 }
-                
             }
-            // move remaining data forward
-            len -= (p - buffer + 1);
-            memmove(buffer, p + 1, len);
-            buffer[len] = '\0';
         }
     }
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    for (int i = 0; i < started; i++) pthread_join(pool[i], NULL);
+    free(pool);
+    for (int i = 0; i < count; i++) {
+        sessions[i].busy = 0;   // the search threads are gone
+        session_close(epfd, &sessions[i]);
+    }
+    close(done_fd);
+    done_fd = -1;
+    close(epfd);
     led_clear();
     led_delete();
-    //return NULL;
 }
 
 // for debug
-void game_start(int sockfd){
+void game_start(int sockfd, const char *username){
     while (1){
         int invalid = 0, move[4];
         char movec[4][50], *endptr;
@@ -432,12 +737,12 @@ void game_start(int sockfd){
             move[i] = num;
         }
         if (invalid) continue;
-        send_move(sockfd , move[0], move[1], move[2], move[3]);
+        send_move(sockfd, username, move[0], move[1], move[2], move[3]);
     }
 }
 
 // not used
-void await_game_start(int sockfd) {
+void await_game_start(int sockfd, const char *username) {
     char buffer[1024];
     size_t len = 0;
     char *p;
@@ -465,7 +770,7 @@ void await_game_start(int sockfd) {
                         cJSON_Delete(msg);
 
                         //game loop
-                        game_start(sockfd);
+                        game_start(sockfd, username);
                         return;
 
                     }
@@ -482,26 +787,124 @@ void await_game_start(int sockfd) {
 }
 
 int main(int argc, char *argv[]) {
-    if (argc == 7 && strcmp(argv[1], "-ip") == 0 && strcmp(argv[3], "-port") == 0 && strcmp(argv[5], "-username") == 0) {
-        name =  (char*)malloc(strlen(argv[6]) + 1);
-        strcpy(name, argv[6]);
-        
-        int sockfd = connect_to_server(argv[2], argv[4]);
-        if (sockfd <= 0){
-            printf("[error] unable to connect to server\n");
-        }else {
-            send_register(sockfd, argv[6]);
-            //pthread_t tid;
-            //pthread_create(&tid, NULL, handle_socket, (void *)(intptr_t)sockfd);
-            //pthread_detach(tid);
-            //game_start(sockfd);
-            handle_socket(sockfd);
+    const char *ip = NULL, *port = NULL, *username = NULL, *tt_file = NULL;
+    const char *log_file = NULL, *record_file = NULL, *eval_file = NULL;
+    const char *book_file = NULL, *worker_list = NULL, *metrics_file = NULL;
+    int level = LOG_DEBUG, session_count = 1, threads = 0;
+
+    if (argc >= 2 && strcmp(argv[1], "-bench") == 0) {
+        if (engine_state_open(NULL) != 0) return 1;
+        if (argc >= 4 && engine_eval_open(argv[3]) != 0) return 1;
+        run_bench(argc >= 3 ? atoi(argv[2]) : 6);
+        engine_eval_close();
+        engine_state_close();
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "-bench-workers") == 0) {
+        if (engine_state_open(NULL) != 0) return 1;
+        int rc = run_bench_workers(argv[2], argc >= 4 ? atoi(argv[3]) : 8);
+        engine_state_close();
+        return rc;
+    }
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-keep-alive") == 0) { keep_alive = 1; continue; }
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-ip") == 0)       ip = argv[++i];
+        else if (strcmp(argv[i], "-port") == 0)     port = argv[++i];
+        else if (strcmp(argv[i], "-username") == 0) username = argv[++i];
+        else if (strcmp(argv[i], "-tt-file") == 0)  tt_file = argv[++i];
+        else if (strcmp(argv[i], "-log-file") == 0) log_file = argv[++i];
+        else if (strcmp(argv[i], "-record-file") == 0) record_file = argv[++i];
+        else if (strcmp(argv[i], "-eval-file") == 0) eval_file = argv[++i];
+        else if (strcmp(argv[i], "-book-file") == 0) book_file = argv[++i];
+        else if (strcmp(argv[i], "-workers") == 0)  worker_list = argv[++i];
+        else if (strcmp(argv[i], "-metrics-file") == 0) metrics_file = argv[++i];
+        else if (strcmp(argv[i], "-sessions") == 0) session_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0)  threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-log-level") == 0) {
+            level = log_level_from_name(argv[++i]);
+            if (level < 0) { bad_args = 1; break; }
+        }
+        else { bad_args = 1; break; }
+    }
+    if (session_count < 1 || threads < 0) bad_args = 1;
+    if (ip && port && username && !bad_args) {
+        if (threads == 0) {
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = cores > 0 && cores < session_count ? (int)cores : session_count;
+        }
+        if (log_open(log_file, level) != 0) {
+            fprintf(stderr, "[error] logging stays synchronous\n");
         }
-        close(sockfd);
-        free(name);
+
+        // Everything the first move needs is set up before we connect.
+        long long init_start = get_time_ms();
+        if (engine_state_open(tt_file) != 0) {
+            LOG(LOG_ERROR, "[error] unable to allocate search state");
+            log_close();
+            return 1;
+        }
+        if (eval_file && engine_eval_open(eval_file) != 0) {
+            LOG(LOG_WARN, "[client] playing with the piece count evaluation");
+        }
+        if (book_file && book_open(&book, book_file) != 0) {
+            LOG(LOG_WARN, "[client] cannot read the opening book %s", book_file);
+        }
+        if (worker_list && (session_count > 1 || threads > 1)) {
+            // A pool of workers serves one search at a time.
+            LOG(LOG_WARN, "[client] -workers needs one session and one thread, searching locally");
+        } else if (worker_list && !(workers = dist_open(worker_list))) {
+            LOG(LOG_WARN, "[client] bad worker list %s, searching locally", worker_list);
+        }
+        if (latency_open(&latency, metrics_file) != 0) {
+            LOG(LOG_WARN, "[client] cannot open the metrics file %s", metrics_file);
+        }
+        LOG(LOG_INFO, "[client] engine ready in %lld ms", get_time_ms() - init_start);
+
+        // One connection per session, named <username>-<n> when there are
+        // several. Only the first draws on the LED panel.
+        Session *sessions = (Session *)calloc((size_t)session_count, sizeof(Session));
+        for (int i = 0; sessions && i < session_count; i++) {
+            Session *s = &sessions[i];
+            s->name = (char *)malloc(strlen(username) + 16);
+            if (session_count > 1) sprintf(s->name, "%s-%d", username, i + 1);
+            else strcpy(s->name, username);
+            s->leds = i == 0;
+            gamerec_open(&s->recorder, record_file);
+            s->fd = connect_to_server(ip, port);
+            if (s->fd <= 0){
+                LOG(LOG_ERROR, "[error] unable to connect to server for %s", s->name);
+                continue;
+            }
+            s->open = 1;
+            send_register(s->fd, s->name);
+        }
+        if (sessions) {
+            LOG(LOG_INFO, "[client] %d sessions on %d search threads", session_count, threads);
+            run_sessions(sessions, session_count, threads);
+            for (int i = 0; i < session_count; i++) {
+                gamerec_close(&sessions[i].recorder);
+                free(sessions[i].name);
+            }
+            free(sessions);
+        }
+        engine_state_sync();
+        engine_state_close();
+        engine_eval_close();
+        book_close(&book);
+        dist_close(workers);
+        latency_close(&latency);
+        log_close();
     } else {
-        fprintf(stderr, "Usage: %s -ip <ip_address> -username <name>\n", argv[0]);
+        fprintf(stderr, "Usage: %s -ip <ip_address> -port <port> -username <name> [-tt-file <path>]\n"
+                        "       [-keep-alive] [-record-file <path>] [-eval-file <path>] [-book-file <path>]\n"
+                        "       [-workers <host:port,...>] [-metrics-file <path>]\n"
+                        "       [-sessions <n>] [-threads <n>]\n"
+                        "       [-log-file <path>] [-log-level error|warn|info|debug]\n", argv[0]);
+        fprintf(stderr, "       %s -bench [depth] [eval file]\n", argv[0]);
+        fprintf(stderr, "       %s -bench-workers <host:port,...> [depth]\n", argv[0]);
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
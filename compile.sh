@@ -2,8 +2,20 @@ echo "compile start"
 make clean
 make all
 
-g++ -Iinclude board.c ./lib/*.o -o board -D D
+g++ -Iinclude board.c ./lib/*.o -o board -D D -lpthread
 
-g++ -Iinclude board.c cJSON.c client.c ./lib/*.o -o client -lpthread
+g++ -O2 -Iinclude board.c cJSON.c engine.c eval.c logger.c gamerec.c book.c distsearch.c latency.c client.c ./lib/*.o -o client -lpthread
 
-echo "compile finish"
\ No newline at end of file
+g++ -O2 -Iinclude cJSON.c engine.c eval.c logger.c analyzer.c -o analyzer -lpthread
+
+g++ -O2 -Iinclude cJSON.c engine.c eval.c logger.c worker.c -o worker -lpthread
+
+g++ -O2 -Iinclude engine.c eval.c gamerec.c replay.c -o replay -lpthread
+
+g++ -O2 -Iinclude engine.c eval.c gamerec.c selfplay.c -o selfplay -lpthread
+
+g++ -O2 -Iinclude engine.c eval.c gamerec.c fit.c -o fit -lpthread
+
+g++ -O2 -Iinclude engine.c eval.c gamerec.c book.c bookgen.c -o bookgen -lpthread
+
+echo "compile finish"
@@ -8,13 +8,21 @@
 
 int main() {
     struct LedPanelSettings *leds = led_initialize();
+    if (!leds) {
+        fprintf(stderr, "Failed to initialize LED panel\n");
+        return 1;
+    }
+    // Our own canvas, put on display once and drawn on in place: the
+    // panel's frames belong to its drawing thread.
+    struct LedCanvas *canvas = led_matrix_create_offscreen_canvas(leds->matrix);
+    led_canvas_clear(canvas);
+    led_matrix_swap_on_vsync(leds->matrix, canvas);
 
     // y-axis with color red
     for (int count = 0; count < 6; count++) {
         int x = 0;
         int y = 0 + 10 * count;
-        led_canvas_set_pixel(leds->canvas, x, y, 255 - (255/6)*count, 0, 0);
-        leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
+        led_canvas_set_pixel(canvas, x, y, 255 - (255/6)*count, 0, 0);
         sleep(1);
     }
 
@@ -22,20 +30,18 @@ int main() {
     for (int count = 0; count < 6; count++) {
         int x = 0 + 10 * count;
         int y = 0;
-        led_canvas_set_pixel(leds->canvas, x, y, 0, 0, 255 - (255/6)*count);
-        leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
+        led_canvas_set_pixel(canvas, x, y, 0, 0, 255 - (255/6)*count);
         sleep(1);
     }
 
     // green at center
-    led_canvas_set_pixel(leds->canvas, 32, 32, 0, 255, 0);
-    leds->canvas = led_matrix_swap_on_vsync(leds->matrix, leds->canvas);
+    led_canvas_set_pixel(canvas, 32, 32, 0, 255, 0);
 
     sleep(5);
 
-    led_clear(leds);
+    led_clear();
 
-    led_delete(leds);
+    led_delete();
 
     return 0;
 }
\ No newline at end of file
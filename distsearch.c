@@ -0,0 +1,682 @@
+// distsearch.c
+#include "distsearch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "cJSON.h"
+#include "logger.h"
+
+#define DIST_MAX_WORKERS  32
+#define DIST_LINE_MAX     4096
+#define DIST_CONNECT_MS   100      // workers sit on the same LAN
+#define DIST_RETRY_MS     5000     // between attempts to reach a worker
+#define DIST_SLOW_MS      100      // least a job runs before it is duplicated
+
+typedef struct {
+    char      host[128];
+    char      port[16];
+    int       fd;                  // -1 while down
+    int       slots;               // jobs it runs at once
+    int       busy;
+    long long retry_ms;            // next attempt to connect
+    size_t    len;
+    char      buf[DIST_LINE_MAX];
+} DistWorker;
+
+struct DistPool {
+    DistWorker         workers[DIST_MAX_WORKERS];
+    int                count;
+    unsigned long long next_id;    // job ids are never reused
+};
+
+enum { JOB_QUEUED = 0, JOB_RUNNING, JOB_DONE };
+
+typedef struct {
+    int       move;                // index into the root moves
+    int       open;                // open window above 'alpha', else a
+    int       alpha;               // null window at it
+    int       state;
+    uint32_t  running;             // bit per worker running it
+    long long sent_ms;
+} DistJob;
+
+// One iteration of the root at a fixed depth. Job i has id first_id + i.
+typedef struct {
+    DistPool          *pool;
+    const EngineLimits *limits;
+    int                depth;      // plies below the root moves
+    const EngineMove  *moves;
+    int                move_count;
+    int               *bounds;     // per move: exact score or upper bound
+    DistJob           *jobs;
+    int                job_count, job_capacity;
+    unsigned long long first_id;
+    int                resolved;   // moves whose bound is final
+    int                first_done; // the first move has its exact score
+    int                alpha, best;   // best score so far and its move
+    long long          longest_ms; // slowest job answered so far
+    unsigned long long nodes;      // of the answered jobs
+} DistIteration;
+
+static int worker_up(const DistWorker *w) { return w->fd >= 0; }
+
+int dist_workers(const DistPool *pool)
+{
+    int up = 0;
+    for (int i = 0; i < pool->count; i++) up += worker_up(&pool->workers[i]);
+    return up;
+}
+
+// Read one line within 'timeout_ms' into w->buf. Returns its length, or -1.
+static int read_line(DistWorker *w, int timeout_ms)
+{
+    long long deadline = get_time_ms() + timeout_ms;
+    for (;;) {
+        char *end = (char *)memchr(w->buf, '\n', w->len);
+        if (end) return (int)(end - w->buf);
+        long long left = deadline - get_time_ms();
+        struct pollfd p = { w->fd, POLLIN, 0 };
+        if (left <= 0 || w->len == sizeof(w->buf) || poll(&p, 1, (int)left) <= 0) {
+            return -1;
+        }
+        ssize_t n = recv(w->fd, w->buf + w->len, sizeof(w->buf) - w->len, 0);
+        if (n <= 0) return -1;
+        w->len += (size_t)n;
+    }
+}
+
+// Connect without blocking longer than DIST_CONNECT_MS, and read the
+// worker's hello. Returns 0 once the worker is up.
+static int connect_worker(DistWorker *w)
+{
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    w->retry_ms = get_time_ms() + DIST_RETRY_MS;
+    if (getaddrinfo(w->host, w->port, &hints, &res) != 0) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 && errno == EINPROGRESS) {
+        struct pollfd p = { fd, POLLOUT, 0 };
+        int err = 0;
+        socklen_t len = sizeof(err);
+        rc = (poll(&p, 1, DIST_CONNECT_MS) == 1 &&
+              getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+           ? 0 : -1;
+    }
+    if (rc != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, flags);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    w->fd = fd;
+    w->len = 0;
+    w->busy = 0;
+    int n = read_line(w, DIST_CONNECT_MS);
+    cJSON *hello = NULL;
+    if (n >= 0) {
+        w->buf[n] = '\0';
+        hello = cJSON_Parse(w->buf);
+        w->len -= (size_t)n + 1;
+        memmove(w->buf, w->buf + n + 1, w->len);
+    }
+    cJSON *slots = hello ? cJSON_GetObjectItem(hello, "slots") : NULL;
+    if (!cJSON_IsNumber(slots) || slots->valueint < 1) {
+        cJSON_Delete(hello);
+        close(fd);
+        w->fd = -1;
+        return -1;
+    }
+    w->slots = slots->valueint;
+    cJSON_Delete(hello);
+    LOG(LOG_INFO, "[dist] worker %s:%s up with %d slots", w->host, w->port, w->slots);
+    return 0;
+}
+
+DistPool *dist_open(const char *spec)
+{
+    DistPool *pool = (DistPool *)calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+    const char *p = spec;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        const char *colon = (const char *)memrchr(p, ':', len);
+        DistWorker *w = &pool->workers[pool->count];
+        if (pool->count == DIST_MAX_WORKERS || !colon || colon == p ||
+            (size_t)(colon - p) >= sizeof(w->host) ||
+            len - (size_t)(colon - p) - 1 >= sizeof(w->port) ||
+            colon + 1 == p + len) {
+            free(pool);
+            return NULL;
+        }
+        memcpy(w->host, p, (size_t)(colon - p));
+        memcpy(w->port, colon + 1, len - (size_t)(colon - p) - 1);
+        w->fd = -1;
+        pool->count++;
+        if (connect_worker(w) != 0) {
+            LOG(LOG_WARN, "[dist] worker %s:%s is down", w->host, w->port);
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    if (pool->count == 0) {
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void dist_close(DistPool *pool)
+{
+    if (!pool) return;
+    for (int i = 0; i < pool->count; i++) {
+        if (worker_up(&pool->workers[i])) close(pool->workers[i].fd);
+    }
+    free(pool);
+}
+
+/**
+ * Take a worker out of the pool until its next retry. Its share of the
+ * iteration's jobs goes back to the queue unless another worker runs them
+ * too.
+ */
+static void worker_down(DistPool *pool, int w, DistIteration *it)
+{
+    DistWorker *worker = &pool->workers[w];
+    close(worker->fd);
+    worker->fd = -1;
+    worker->busy = 0;
+    worker->retry_ms = get_time_ms() + DIST_RETRY_MS;
+    LOG(LOG_WARN, "[dist] lost worker %s:%s", worker->host, worker->port);
+    if (!it) return;
+    for (int i = 0; i < it->job_count; i++) {
+        DistJob *job = &it->jobs[i];
+        if (!(job->running & (1u << w))) continue;
+        job->running &= ~(1u << w);
+        if (!job->running && job->state == JOB_RUNNING) job->state = JOB_QUEUED;
+    }
+}
+
+// Send one message line. Returns -1, with the worker taken down, on failure.
+static int send_message(DistPool *pool, int w, cJSON *msg, DistIteration *it)
+{
+    DistWorker *worker = &pool->workers[w];
+    if (!worker_up(worker)) return -1;
+    char *text = cJSON_PrintUnformatted(msg);
+    if (!text) return -1;
+    size_t len = strlen(text);
+    text[len] = '\n';    // replaces the terminator; cJSON allocates len + 1
+    const char *p = text;
+    size_t left = len + 1;
+    while (left > 0) {
+        ssize_t n = send(worker->fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        p += n;
+        left -= (size_t)n;
+    }
+    free(text);
+    if (left > 0) {
+        worker_down(pool, w, it);
+        return -1;
+    }
+    return 0;
+}
+
+static void broadcast(DistPool *pool, cJSON *msg, DistIteration *it)
+{
+    for (int w = 0; w < pool->count; w++) {
+        if (worker_up(&pool->workers[w])) send_message(pool, w, msg, it);
+    }
+}
+
+static cJSON *move_array(const EngineMove *m)
+{
+    int v[4] = { m->from_row + 1, m->from_col + 1, m->to_row + 1, m->to_col + 1 };
+    return cJSON_CreateIntArray(v, 4);
+}
+
+// Reconnect workers that are due for a retry and give all of them 'pos'.
+static void send_position(DistPool *pool, const EnginePosition *pos)
+{
+    long long now = get_time_ms();
+    for (int w = 0; w < pool->count; w++) {
+        DistWorker *worker = &pool->workers[w];
+        if (!worker_up(worker) && now >= worker->retry_ms) connect_worker(worker);
+    }
+
+    char rows[ENGINE_MAX_SIDE][ENGINE_MAX_SIDE + 1];
+    const char *row_ptrs[ENGINE_MAX_SIDE];
+    for (int r = 0; r < pos->height; r++) {
+        for (int c = 0; c < pos->width; c++) {
+            int sq = r * pos->width + c;
+            uint64_t bit = 1ULL << (sq & 63);
+            rows[r][c] = (pos->red[sq >> 6] & bit)  ? 'R'
+                       : (pos->blue[sq >> 6] & bit) ? 'B'
+                       : (pos->wall[sq >> 6] & bit) ? '#' : '.';
+        }
+        rows[r][pos->width] = '\0';
+        row_ptrs[r] = rows[r];
+    }
+    char turn[2] = { pos->to_move, '\0' };
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "position");
+    cJSON_AddItemToObject(msg, "board", cJSON_CreateStringArray(row_ptrs, pos->height));
+    cJSON_AddStringToObject(msg, "turn", turn);
+    broadcast(pool, msg, NULL);
+    cJSON_Delete(msg);
+}
+
+static void add_job(DistIteration *it, int move, int open, int alpha)
+{
+    if (it->job_count == it->job_capacity) {
+        it->job_capacity = it->job_capacity ? it->job_capacity * 2 : 64;
+        it->jobs = (DistJob *)realloc(it->jobs, it->job_capacity * sizeof(DistJob));
+    }
+    DistJob *job = &it->jobs[it->job_count++];
+    memset(job, 0, sizeof(*job));
+    job->move = move;
+    job->open = open;
+    job->alpha = alpha;
+    job->state = JOB_QUEUED;
+}
+
+static void send_job(DistIteration *it, int w, int index)
+{
+    DistJob *job = &it->jobs[index];
+    if (job->state == JOB_QUEUED && job->alpha < it->alpha) job->alpha = it->alpha;
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "job");
+    cJSON_AddNumberToObject(msg, "id", (double)(it->first_id + index));
+    cJSON_AddItemToObject(msg, "move", move_array(&it->moves[job->move]));
+    cJSON_AddNumberToObject(msg, "depth", it->depth);
+    cJSON_AddNumberToObject(msg, "alpha", job->alpha);
+    cJSON_AddBoolToObject(msg, "open", job->open);
+    if (send_message(it->pool, w, msg, it) == 0) {
+        if (job->state == JOB_QUEUED) job->sent_ms = get_time_ms();
+        job->state = JOB_RUNNING;
+        job->running |= 1u << w;
+        it->pool->workers[w].busy++;
+    }
+    cJSON_Delete(msg);
+}
+
+static void cancel_copies(DistIteration *it, int index)
+{
+    DistJob *job = &it->jobs[index];
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "cancel");
+    cJSON_AddNumberToObject(msg, "id", (double)(it->first_id + index));
+    for (int w = 0; w < it->pool->count; w++) {
+        if (!(job->running & (1u << w))) continue;
+        job->running &= ~(1u << w);
+        it->pool->workers[w].busy--;
+        send_message(it->pool, w, msg, it);
+    }
+    cJSON_Delete(msg);
+}
+
+/**
+ * The next job for worker 'w': queued open re-searches first, then null
+ * window jobs in move order. With nothing queued, a second copy of the
+ * oldest job that has run far longer than any answered one, in case its
+ * worker is slow or hangs.
+ */
+static int next_job(const DistIteration *it, int w)
+{
+    int pick = -1;
+    for (int i = 0; i < it->job_count; i++) {
+        const DistJob *job = &it->jobs[i];
+        if (job->state != JOB_QUEUED) continue;
+        if (job->open) return i;
+        if (pick < 0) pick = i;
+    }
+    if (pick >= 0) return pick;
+
+    long long slow = 2 * it->longest_ms;
+    if (slow < DIST_SLOW_MS) slow = DIST_SLOW_MS;
+    long long now = get_time_ms();
+    for (int i = 0; i < it->job_count; i++) {
+        const DistJob *job = &it->jobs[i];
+        if (job->state == JOB_RUNNING && !(job->running & (1u << w)) &&
+            __builtin_popcount(job->running) == 1 && now - job->sent_ms >= slow &&
+            (pick < 0 || job->sent_ms < it->jobs[pick].sent_ms)) {
+            pick = i;
+        }
+    }
+    return pick;
+}
+
+static void dispatch(DistIteration *it)
+{
+    DistPool *pool = it->pool;
+    for (int w = 0; w < pool->count; w++) {
+        DistWorker *worker = &pool->workers[w];
+        while (worker_up(worker) && worker->busy < worker->slots) {
+            int index = next_job(it, w);
+            if (index < 0) break;
+            send_job(it, w, index);
+        }
+    }
+}
+
+static void raise_alpha(DistIteration *it, int score, int move)
+{
+    it->alpha = score;
+    it->best = move;
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "alpha");
+    cJSON_AddNumberToObject(msg, "depth", it->depth);
+    cJSON_AddNumberToObject(msg, "alpha", score);
+    broadcast(it->pool, msg, it);
+    cJSON_Delete(msg);
+}
+
+static void handle_result(DistIteration *it, int w, const cJSON *msg)
+{
+    cJSON *id = cJSON_GetObjectItem(msg, "id");
+    cJSON *score_item = cJSON_GetObjectItem(msg, "score");
+    cJSON *alpha_item = cJSON_GetObjectItem(msg, "alpha");
+    cJSON *nodes = cJSON_GetObjectItem(msg, "nodes");
+    if (!cJSON_IsNumber(id) || !cJSON_IsNumber(score_item) ||
+        !cJSON_IsNumber(alpha_item)) {
+        return;
+    }
+    // Answers to cancelled jobs and earlier iterations are late; their
+    // slots were freed when they were cancelled.
+    double index_d = id->valuedouble - (double)it->first_id;
+    if (index_d < 0 || index_d >= it->job_count) return;
+    int index = (int)index_d;
+    DistJob *job = &it->jobs[index];
+    if (!(job->running & (1u << w))) return;
+    job->running &= ~(1u << w);
+    it->pool->workers[w].busy--;
+    cancel_copies(it, index);
+    job->state = JOB_DONE;
+
+    int score = score_item->valueint, alpha = alpha_item->valueint;
+    if (cJSON_IsNumber(nodes)) it->nodes += (unsigned long long)nodes->valuedouble;
+    long long took = get_time_ms() - job->sent_ms;
+    if (took > it->longest_ms) it->longest_ms = took;
+
+    int m = job->move;
+    if (job->open) {
+        // Exact above 'alpha', an upper bound at or below it.
+        it->bounds[m] = score;
+        it->resolved++;
+        if (score > alpha && score > it->alpha) raise_alpha(it, score, m);
+        if (!it->first_done) {
+            it->first_done = 1;
+            for (int i = 1; i < it->move_count; i++) add_job(it, i, 0, it->alpha);
+        }
+    } else if (score <= alpha) {
+        it->bounds[m] = score;
+        it->resolved++;
+    } else {
+        // Above 'alpha': search it open if that is still the best score,
+        // else test it again against the new one.
+        add_job(it, m, alpha >= it->alpha, it->alpha);
+    }
+}
+
+// Wait up to 'timeout_ms' for answers and handle them.
+static void collect(DistIteration *it, int timeout_ms)
+{
+    DistPool *pool = it->pool;
+    struct pollfd fds[DIST_MAX_WORKERS];
+    int who[DIST_MAX_WORKERS], count = 0;
+    for (int w = 0; w < pool->count; w++) {
+        if (!worker_up(&pool->workers[w])) continue;
+        fds[count].fd = pool->workers[w].fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        who[count++] = w;
+    }
+    if (poll(fds, count, timeout_ms) <= 0) return;
+
+    for (int i = 0; i < count; i++) {
+        if (!fds[i].revents) continue;
+        int w = who[i];
+        DistWorker *worker = &pool->workers[w];
+        ssize_t n = recv(worker->fd, worker->buf + worker->len,
+                         sizeof(worker->buf) - 1 - worker->len, 0);
+        if (n <= 0) {
+            worker_down(pool, w, it);
+            continue;
+        }
+        worker->len += (size_t)n;
+        worker->buf[worker->len] = '\0';
+        char *line = worker->buf, *end;
+        while (worker_up(worker) && (end = strchr(line, '\n')) != NULL) {
+            *end = '\0';
+            cJSON *msg = cJSON_Parse(line);
+            cJSON *type = msg ? cJSON_GetObjectItem(msg, "type") : NULL;
+            if (cJSON_IsString(type) && strcmp(type->valuestring, "result") == 0) {
+                handle_result(it, w, msg);
+            }
+            cJSON_Delete(msg);
+            line = end + 1;
+        }
+        if (!worker_up(worker)) continue;
+        worker->len -= (size_t)(line - worker->buf);
+        memmove(worker->buf, line, worker->len);
+        if (worker->len == sizeof(worker->buf) - 1) worker_down(pool, w, it);
+    }
+}
+
+static int limits_reached(const EngineLimits *limits, unsigned long long nodes)
+{
+    return (limits->cancel && __atomic_load_n(limits->cancel, __ATOMIC_RELAXED)) ||
+           (limits->max_nodes && nodes >= limits->max_nodes) ||
+           get_time_ms() >= limits->deadline_ms;
+}
+
+/**
+ * Search every root move 'depth' plies deep on the workers. Returns 1 once
+ * all moves are settled, 0 if the limits or the loss of every worker
+ * stopped it first. Jobs still running are cancelled either way.
+ */
+static int run_iteration(DistIteration *it, unsigned long long nodes_before)
+{
+    int complete = 1;
+    add_job(it, 0, 1, -ENGINE_SCORE_INF);
+    while (it->resolved < it->move_count) {
+        if (limits_reached(it->limits, nodes_before + it->nodes) ||
+            dist_workers(it->pool) == 0) {
+            complete = 0;
+            break;
+        }
+        dispatch(it);
+        long long wait = it->limits->deadline_ms - get_time_ms();
+        if (wait > DIST_SLOW_MS / 2) wait = DIST_SLOW_MS / 2;
+        collect(it, wait > 0 ? (int)wait : 0);
+    }
+    for (int i = 0; i < it->job_count; i++) {
+        if (it->jobs[i].running) cancel_copies(it, i);
+    }
+    return complete;
+}
+
+// Whether 'm' is one of limits->exclude, as engine_search() matches them.
+static int excluded(const EngineLimits *limits, const EngineMove *m)
+{
+    for (int i = 0; limits->exclude && i < limits->exclude_count; i++) {
+        const EngineMove *x = &limits->exclude[i];
+        int clone = abs(x->to_row - x->from_row) <= 1 &&
+                    abs(x->to_col - x->from_col) <= 1;
+        int m_clone = abs(m->to_row - m->from_row) <= 1 &&
+                      abs(m->to_col - m->from_col) <= 1;
+        if (m->to_row == x->to_row && m->to_col == x->to_col &&
+            (clone ? m_clone : (m->from_row == x->from_row &&
+                                m->from_col == x->from_col))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int same_move(const EngineMove *a, const EngineMove *b)
+{
+    return a->from_row == b->from_row && a->from_col == b->from_col &&
+           a->to_row == b->to_row && a->to_col == b->to_col;
+}
+
+// Best move first, the others by their bounds, ties in the old order.
+static void order_moves(EngineMove *moves, int *bounds, int count, int best)
+{
+    EngineMove m = moves[best];
+    int b = bounds[best];
+    memmove(&moves[1], &moves[0], best * sizeof(EngineMove));
+    memmove(&bounds[1], &bounds[0], best * sizeof(int));
+    moves[0] = m;
+    bounds[0] = b;
+    for (int i = 2; i < count; i++) {
+        m = moves[i];
+        b = bounds[i];
+        int k = i;
+        while (k > 1 && bounds[k - 1] < b) {
+            moves[k] = moves[k - 1];
+            bounds[k] = bounds[k - 1];
+            k--;
+        }
+        moves[k] = m;
+        bounds[k] = b;
+    }
+}
+
+int dist_search(DistPool *pool, const EnginePosition *pos,
+                const EngineLimits *limits, EngineResult *result)
+{
+    int max_depth = limits->max_depth;
+    if (max_depth < 1 || max_depth > ENGINE_MAX_DEPTH) max_depth = ENGINE_MAX_DEPTH;
+
+    // The shallow iterations, and everything while no worker is up, here.
+    EngineLimits local = *limits;
+    if (max_depth > DIST_LOCAL_DEPTH) local.max_depth = DIST_LOCAL_DEPTH;
+    int found = engine_search(pos, &local, result);
+    if (found != 1 || max_depth <= DIST_LOCAL_DEPTH ||
+        result->stop_reason != ENGINE_STOP_DEPTH) {
+        return found;
+    }
+    send_position(pool, pos);
+    if (dist_workers(pool) == 0) return engine_search(pos, limits, result);
+
+    // Root moves in the order of the shallow search.
+    static __thread EngineMove moves[ENGINE_MAX_MOVES];
+    static __thread int bounds[ENGINE_MAX_MOVES];
+    EngineMove all[ENGINE_MAX_MOVES];
+    int all_count = engine_legal_moves(pos, all);
+    int count = 0;
+    for (int i = 0; i < result->ranked_len; i++) {
+        bounds[count] = result->ranked_scores[i];
+        moves[count++] = result->ranked[i];
+    }
+    for (int i = 0; i < all_count; i++) {
+        int listed = excluded(limits, &all[i]);
+        for (int k = 0; k < result->ranked_len && !listed; k++) {
+            listed = same_move(&all[i], &result->ranked[k]);
+        }
+        if (!listed) {
+            bounds[count] = -ENGINE_SCORE_INF;
+            moves[count++] = all[i];
+        }
+    }
+
+    unsigned long long nodes = result->nodes;
+    int score = result->score, done = result->depth;
+    int reason = ENGINE_STOP_DEPTH, lost_workers = 0;
+    DistIteration it;
+    memset(&it, 0, sizeof(it));
+    it.pool = pool;
+    it.limits = limits;
+    it.moves = moves;
+    it.move_count = count;
+    it.bounds = bounds;
+
+    for (int depth = DIST_LOCAL_DEPTH + 1; depth <= max_depth; depth++) {
+        it.depth = depth - 1;
+        it.job_count = 0;
+        it.first_id = pool->next_id;
+        it.resolved = 0;
+        it.first_done = 0;
+        it.alpha = -ENGINE_SCORE_INF;
+        it.best = 0;
+        it.longest_ms = 0;
+        it.nodes = 0;
+        int complete = run_iteration(&it, nodes);
+        pool->next_id += (unsigned long long)it.job_count;
+        nodes += it.nodes;
+        if (!complete) {
+            // A move that beat the first one's exact score is better at
+            // this depth than what the last iteration chose.
+            if (it.first_done && it.best != 0) {
+                score = it.alpha;
+                order_moves(moves, bounds, count, it.best);
+            }
+            lost_workers = dist_workers(pool) == 0 &&
+                           !limits_reached(limits, nodes);
+            reason = (limits->cancel && __atomic_load_n(limits->cancel, __ATOMIC_RELAXED))
+                   ? ENGINE_STOP_CANCELLED
+                   : (limits->max_nodes && nodes >= limits->max_nodes)
+                   ? ENGINE_STOP_NODES : ENGINE_STOP_TIME;
+            break;
+        }
+        score = it.alpha;
+        done = depth;
+        order_moves(moves, bounds, count, it.best);
+        if (score >= ENGINE_SCORE_WIN / 2 || score <= -ENGINE_SCORE_WIN / 2) {
+            reason = ENGINE_STOP_PROVEN;
+            break;
+        }
+    }
+    free(it.jobs);
+    if (lost_workers) {
+        LOG(LOG_WARN, "[dist] no workers left, searching locally");
+        return engine_search(pos, limits, result);
+    }
+
+    result->move = moves[0];
+    result->score = score;
+    result->depth = done;
+    result->nodes = nodes;
+    result->stop_reason = reason;
+    result->pv[0] = moves[0];
+    result->pv_len = 1;
+    // As engine_search(): only the first score is exact, the rest bounds.
+    result->ranked_len = count < ENGINE_MAX_RANKED ? count : ENGINE_MAX_RANKED;
+    for (int i = 0; i < result->ranked_len; i++) {
+        result->ranked[i] = moves[i];
+        result->ranked_scores[i] = bounds[i];
+    }
+    return 1;
+}
+
+void dist_clear(DistPool *pool)
+{
+    engine_state_clear();
+    cJSON *msg = cJSON_CreateObject();
+    cJSON_AddStringToObject(msg, "type", "clear");
+    broadcast(pool, msg, NULL);
+    cJSON_Delete(msg);
+}
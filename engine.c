@@ -0,0 +1,1998 @@
+// engine.c
+#include "engine.h"
+#include "eval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <type_traits>
+
+long long get_time_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
+}
+
+// Scores are piece differences, so anything outside ±SCORE_INF never occurs.
+#define SCORE_INF ENGINE_SCORE_INF
+#define SCORE_WIN ENGINE_SCORE_WIN
+#define MAX_PLY   64
+static_assert(ENGINE_MAX_DEPTH == MAX_PLY - 1, "ENGINE_MAX_DEPTH out of sync");
+
+/*
+ * Easy move: a timed search stops early once the best move has survived
+ * EASY_STABLE_ITERATIONS iterations, from EASY_MIN_DEPTH on, and a reduced
+ * search shows every alternative at least EASY_MARGIN pieces worse.
+ */
+#define EASY_MIN_DEPTH          6
+#define EASY_STABLE_ITERATIONS  3
+#define EASY_MARGIN             6
+
+/*
+ * Late game: once at most REGION_MAX_EMPTIES squares are empty, the empty
+ * squares are split into regions (connected through adjacent empty
+ * squares) and moves are ordered region by region. Each thread caches the
+ * best move last found in a region, keyed by the region and the pieces
+ * around it, so the same local fight is not sorted out again after every
+ * move made elsewhere.
+ */
+#define REGION_MAX_EMPTIES  20
+#define REGION_MAX          8      // further regions are merged into the last
+#define REGION_CACHE_SIZE   4096   // entries per thread, a power of two
+
+/*
+ * Two-word bitboard for boards with more than 64 squares. Only the
+ * operations the engine needs are provided; shifts are by 1..63.
+ */
+struct Bits128 {
+    uint64_t lo, hi;
+    constexpr Bits128() : lo(0), hi(0) {}
+    constexpr Bits128(uint64_t l, uint64_t h) : lo(l), hi(h) {}
+};
+
+constexpr Bits128 operator|(Bits128 a, Bits128 b) { return Bits128(a.lo | b.lo, a.hi | b.hi); }
+constexpr Bits128 operator&(Bits128 a, Bits128 b) { return Bits128(a.lo & b.lo, a.hi & b.hi); }
+constexpr Bits128 operator^(Bits128 a, Bits128 b) { return Bits128(a.lo ^ b.lo, a.hi ^ b.hi); }
+constexpr Bits128 operator~(Bits128 a) { return Bits128(~a.lo, ~a.hi); }
+constexpr Bits128 operator<<(Bits128 a, int n) {
+    return Bits128(a.lo << n, (a.hi << n) | (a.lo >> (64 - n)));
+}
+constexpr Bits128 operator>>(Bits128 a, int n) {
+    return Bits128((a.lo >> n) | (a.hi << (64 - n)), a.hi >> n);
+}
+
+static inline int  bb_popcount(uint64_t b) { return __builtin_popcountll(b); }
+static inline int  bb_popcount(Bits128 b)  { return __builtin_popcountll(b.lo) + __builtin_popcountll(b.hi); }
+static inline bool bb_any(uint64_t b)      { return b != 0; }
+static inline bool bb_any(Bits128 b)       { return (b.lo | b.hi) != 0; }
+static inline int  bb_lsb(uint64_t b)      { return __builtin_ctzll(b); }
+static inline int  bb_lsb(Bits128 b)       { return b.lo ? __builtin_ctzll(b.lo) : 64 + __builtin_ctzll(b.hi); }
+static inline bool bb_test(uint64_t b, int idx) { return (b >> idx) & 1; }
+static inline bool bb_test(Bits128 b, int idx) {
+    return idx < 64 ? (b.lo >> idx) & 1 : (b.hi >> (idx - 64)) & 1;
+}
+static inline uint64_t bb_drop_lsb(uint64_t b) { return b & (b - 1); }
+static inline Bits128  bb_drop_lsb(Bits128 b) {
+    return b.lo ? Bits128(b.lo & (b.lo - 1), b.hi) : Bits128(0, b.hi & (b.hi - 1));
+}
+// Fold a bitboard into one word for hashing.
+static inline uint64_t bb_fold(uint64_t b) { return b; }
+static inline uint64_t bb_fold(Bits128 b)  { return b.lo ^ (b.hi * 0xC2B2AE3D27D4EB4FULL); }
+
+template <typename Bits> constexpr Bits bb_square(int idx);
+template <> constexpr uint64_t bb_square<uint64_t>(int idx) { return 1ULL << idx; }
+template <> constexpr Bits128 bb_square<Bits128>(int idx) {
+    return idx < 64 ? Bits128(1ULL << idx, 0) : Bits128(0, 1ULL << (idx - 64));
+}
+
+template <typename Bits> static inline Bits bb_from_words(const uint64_t w[2]);
+template <> inline uint64_t bb_from_words<uint64_t>(const uint64_t w[2]) { return w[0]; }
+template <> inline Bits128 bb_from_words<Bits128>(const uint64_t w[2]) { return Bits128(w[0], w[1]); }
+static inline void bb_to_words(uint64_t b, uint64_t w[2]) { w[0] = b; w[1] = 0; }
+static inline void bb_to_words(Bits128 b, uint64_t w[2])  { w[0] = b.lo; w[1] = b.hi; }
+
+/*
+ * Moves are packed into 16 bits: source index, destination index and a
+ * jump flag (set when the source square is vacated). Indices take 6 bits
+ * on boards up to 64 squares and 7 bits above.
+ */
+typedef uint16_t PackedMove;
+
+// Directions in the order of the original 8×8 tables.
+constexpr int kDirRow[8] = {-1,-1, 0,+1,+1,+1, 0,-1};
+constexpr int kDirCol[8] = { 0,+1,+1,+1, 0,-1,-1,-1};
+
+template <typename Bits, int N>
+struct SquareTable {
+    Bits m[N];
+};
+
+// For every square, the squares 'step' cells away along the 8 directions.
+template <typename Bits, int W, int H>
+constexpr SquareTable<Bits, W * H> make_step_table(int step)
+{
+    SquareTable<Bits, W * H> t{};
+    for (int idx = 0; idx < W * H; idx++) {
+        int r = idx / W, c = idx % W;
+        for (int d = 0; d < 8; d++) {
+            int nr = r + kDirRow[d] * step;
+            int nc = c + kDirCol[d] * step;
+            if (nr < 0 || nr >= H || nc < 0 || nc >= W) continue;
+            t.m[idx] = t.m[idx] | bb_square<Bits>(nr * W + nc);
+        }
+    }
+    return t;
+}
+
+// All squares whose column lies outside [lo_col, hi_col].
+template <typename Bits, int W, int H>
+constexpr Bits make_columns_except(int lo_col, int hi_col)
+{
+    Bits b{};
+    for (int idx = 0; idx < W * H; idx++) {
+        int c = idx % W;
+        if (c < lo_col || c > hi_col) b = b | bb_square<Bits>(idx);
+    }
+    return b;
+}
+
+// Unordered square pairs two steps apart on a line: each yields at most
+// one jump in any position.
+template <int W, int H>
+constexpr int count_jump_pairs()
+{
+    int pairs = 0;
+    for (int idx = 0; idx < W * H; idx++) {
+        int r = idx / W, c = idx % W;
+        for (int d = 0; d < 8; d++) {
+            int nr = r + kDirRow[d] * 2;
+            int nc = c + kDirCol[d] * 2;
+            if (nr >= 0 && nr < H && nc >= 0 && nc < W) pairs++;
+        }
+    }
+    return pairs / 2;
+}
+
+/**
+ * Everything that depends on the board dimensions, generated at compile
+ * time. Shifts move a bit by whole rows (W) and columns (1); the column
+ * masks clear what wrapped into the next row, and kBoard clears what was
+ * shifted past the last square (a no-op when the board fills the word).
+ */
+template <int W, int H>
+struct Geometry {
+    static constexpr int kWidth   = W;
+    static constexpr int kHeight  = H;
+    static constexpr int kSquares = W * H;
+    typedef typename std::conditional<(W * H <= 64), uint64_t, Bits128>::type Bits;
+
+    static constexpr int      kSquareBits = (kSquares <= 64) ? 6 : 7;
+    static constexpr unsigned kSquareMask = (1u << kSquareBits) - 1;
+    static constexpr unsigned kJump       = 1u << (2 * kSquareBits);
+
+    /**
+     * Upper bound on the moves of one position. Clones onto the same square
+     * lead to the same position, so each square yields at most one clone; a
+     * jump needs one of our pieces at one end and a hole at the other, so
+     * each jump pair yields at most one jump.
+     */
+    static constexpr int kMaxMoves = kSquares + count_jump_pairs<W, H>();
+
+    static constexpr Bits kBoard      = make_columns_except<Bits, W, H>(0, -1);
+    static constexpr Bits kNotCol0    = make_columns_except<Bits, W, H>(0, 0);
+    static constexpr Bits kNotColL    = make_columns_except<Bits, W, H>(W - 1, W - 1);
+    static constexpr Bits kNotCol01   = make_columns_except<Bits, W, H>(0, 1);
+    static constexpr Bits kNotColL2   = make_columns_except<Bits, W, H>(W - 2, W - 1);
+
+    // kNeighbours[i]: the up to 8 squares adjacent to i (clone targets/flips).
+    // kJumps[i]: the up to 8 squares two steps away from i on a line.
+    static constexpr SquareTable<Bits, W * H> kNeighbours = make_step_table<Bits, W, H>(1);
+    static constexpr SquareTable<Bits, W * H> kJumps      = make_step_table<Bits, W, H>(2);
+
+    static inline int from(PackedMove m) { return m & kSquareMask; }
+    static inline int to(PackedMove m)   { return (m >> kSquareBits) & kSquareMask; }
+    static inline PackedMove pack(int from, int to, int jump) {
+        return (PackedMove)(from | (to << kSquareBits) | (jump ? kJump : 0));
+    }
+};
+
+template <int W, int H> constexpr typename Geometry<W, H>::Bits Geometry<W, H>::kBoard;
+template <int W, int H> constexpr typename Geometry<W, H>::Bits Geometry<W, H>::kNotCol0;
+template <int W, int H> constexpr typename Geometry<W, H>::Bits Geometry<W, H>::kNotColL;
+template <int W, int H> constexpr typename Geometry<W, H>::Bits Geometry<W, H>::kNotCol01;
+template <int W, int H> constexpr typename Geometry<W, H>::Bits Geometry<W, H>::kNotColL2;
+template <int W, int H> constexpr SquareTable<typename Geometry<W, H>::Bits, W * H> Geometry<W, H>::kNeighbours;
+template <int W, int H> constexpr SquareTable<typename Geometry<W, H>::Bits, W * H> Geometry<W, H>::kJumps;
+
+static_assert(Geometry<8, 8>::kMaxMoves == 64 + 168, "8x8 move bound");
+static_assert(Geometry<ENGINE_MAX_SIDE, ENGINE_MAX_SIDE>::kSquares <= 128,
+              "two-word bitboards hold at most 128 squares");
+
+/**
+ * Per-thread search state. The move stack is carved up as the search
+ * recurses: every node appends its moves at 'move_top' and releases them
+ * on return, so the whole tree lives in one preallocated buffer instead of
+ * 8 KB of int arrays per ply. 'order_stack' runs parallel to it and holds
+ * the ordering key of each move.
+ */
+typedef struct {
+    uint64_t   key;
+    PackedMove move;
+} RegionCacheEntry;
+
+template <class G>
+struct SearchContext {
+    PackedMove move_stack[MAX_PLY * G::kMaxMoves];
+    int        order_stack[MAX_PLY * G::kMaxMoves];
+    PackedMove *move_top;
+    PackedMove pv[MAX_PLY][MAX_PLY];   // triangular PV table
+    int        pv_len[MAX_PLY];
+    PackedMove root_pv[MAX_PLY];       // PV of the last completed iteration
+    int        root_pv_len;
+    unsigned long long nodes;
+    long long  deadline_ms;
+    const int  *cancel;                // EngineLimits::cancel
+    unsigned long long max_nodes;      // EngineLimits::max_nodes
+    const EngineMove *exclude;         // EngineLimits::exclude
+    int        exclude_count;
+    int        stopped;                // set once the deadline has passed,
+                                       // the node budget is spent or the
+                                       // search was cancelled
+    RegionCacheEntry region_cache[REGION_CACHE_SIZE];
+    PackedMove *root;                  // moves searched by NODE_ROOT, in
+    int        root_moves;             // order, and the best of them by
+    int        root_best;              // its last call
+    int        root_count;             // root moves of the last search
+    int        root_scores[G::kMaxMoves];  // theirs in the last completed
+    int        iter_scores[G::kMaxMoves];  // iteration, and the current one
+};
+
+template <class G>
+static void search_context_reset(SearchContext<G> *ctx,
+                                 const EngineLimits *limits)
+{
+    ctx->move_top = ctx->move_stack;
+    ctx->nodes = 0;
+    ctx->deadline_ms = limits->deadline_ms;
+    ctx->cancel = limits->cancel;
+    ctx->max_nodes = limits->max_nodes;
+    ctx->exclude = limits->exclude;
+    ctx->exclude_count = limits->exclude ? limits->exclude_count : 0;
+    ctx->root_count = 0;
+    ctx->stopped = 0;
+    ctx->pv_len[0] = 0;
+    ctx->root_pv_len = 0;
+}
+
+template <class G>
+static inline bool search_cancelled(const SearchContext<G> *ctx)
+{
+    return ctx->cancel && __atomic_load_n(ctx->cancel, __ATOMIC_RELAXED);
+}
+
+template <class G>
+static inline bool search_out_of_nodes(const SearchContext<G> *ctx)
+{
+    return ctx->max_nodes && ctx->nodes >= ctx->max_nodes;
+}
+
+// Whether the search must stop now: past the deadline, out of nodes or
+// cancelled.
+template <class G>
+static inline bool search_should_stop(const SearchContext<G> *ctx)
+{
+    return search_cancelled(ctx) || search_out_of_nodes(ctx) ||
+           get_time_ms() >= ctx->deadline_ms;
+}
+
+// The ENGINE_STOP_* reason of a search that had to stop.
+template <class G>
+static inline int search_stop_reason(const SearchContext<G> *ctx)
+{
+    return search_cancelled(ctx)    ? ENGINE_STOP_CANCELLED
+         : search_out_of_nodes(ctx) ? ENGINE_STOP_NODES
+         :                            ENGINE_STOP_TIME;
+}
+
+/**
+ * Apply one packed move on bitboards.
+ *   - A jump removes the bit at 'from'.
+ *   - A clone keeps the bit at 'from'.
+ * Then place your bit at 'to' and flip any adjacent opponent bits.
+ *
+ * @param my_mask      current player's bitboard
+ * @param opp_mask     opponent's bitboard
+ * @param move         packed move
+ * @param new_my_mask  [out] updated player's bitboard
+ * @param new_opp_mask [out] updated opponent's bitboard
+ */
+template <class G>
+static inline void apply_move_bitboard(typename G::Bits my_mask,
+                                       typename G::Bits opp_mask,
+                                       PackedMove move,
+                                       typename G::Bits *new_my_mask,
+                                       typename G::Bits *new_opp_mask)
+{
+    typedef typename G::Bits Bits;
+    int to = G::to(move);
+    Bits flips = G::kNeighbours.m[to] & opp_mask;
+
+    Bits my_new = my_mask | bb_square<Bits>(to) | flips;
+    if (move & G::kJump) {
+        my_new = my_new & ~bb_square<Bits>(G::from(move));
+    }
+
+    *new_my_mask  = my_new;
+    *new_opp_mask = opp_mask & ~flips;
+}
+
+/**
+ * Evaluate (my_mask vs. opp_mask) as popcount(my) - popcount(opp).
+ */
+template <typename Bits>
+static inline int evaluate_board(Bits my_mask, Bits opp_mask)
+{
+    return bb_popcount(my_mask) - bb_popcount(opp_mask);
+}
+
+// Score of a finished game with the given piece difference.
+static inline int final_score(int diff)
+{
+    return (diff > 0) ? SCORE_WIN + diff
+         : (diff < 0) ? -SCORE_WIN + diff
+         :              0;
+}
+
+// Whether the game is over for a side to move without a legal move: it
+// has no pieces left, or the opponent cannot move either. Otherwise the
+// side passes.
+template <class G>
+static inline bool game_over_after_pass(typename G::Bits my_mask,
+                                        typename G::Bits opp_mask,
+                                        typename G::Bits wall_mask);
+
+/**
+ * List every legal move for 'my_mask' given opponent's bits in 'opp_mask'.
+ * Clones are emitted once per destination square, jumps once per
+ * (source, destination) pair.
+ *
+ * @param moves  array of size ≥G::kMaxMoves; receives packed moves
+ * @return number of moves found
+ */
+template <class G>
+static int generate_moves_bitboard(typename G::Bits my_mask,
+                                   typename G::Bits opp_mask,
+                                   typename G::Bits wall_mask,
+                                   PackedMove *moves)
+{
+    typedef typename G::Bits Bits;
+    Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+    Bits clone_targets{};
+    int move_count = 0;
+
+    for (Bits tmp = my_mask; bb_any(tmp); tmp = bb_drop_lsb(tmp)) {
+        clone_targets = clone_targets | G::kNeighbours.m[bb_lsb(tmp)];
+    }
+    clone_targets = clone_targets & empty;
+
+    // Clones first: they gain a piece, so they tend to cut off earlier.
+    for (; bb_any(clone_targets); clone_targets = bb_drop_lsb(clone_targets)) {
+        int to_idx = bb_lsb(clone_targets);
+        int from_idx = bb_lsb(G::kNeighbours.m[to_idx] & my_mask);
+        moves[move_count++] = G::pack(from_idx, to_idx, 0);
+    }
+
+    for (Bits tmp = my_mask; bb_any(tmp); tmp = bb_drop_lsb(tmp)) {
+        int from_idx = bb_lsb(tmp);
+        for (Bits jumps = G::kJumps.m[from_idx] & empty; bb_any(jumps);
+             jumps = bb_drop_lsb(jumps)) {
+            moves[move_count++] = G::pack(from_idx, bb_lsb(jumps), 1);
+        }
+    }
+    return move_count;
+}
+
+// All squares adjacent to some bit of 'b'.
+template <class G>
+static inline typename G::Bits dilate_neighbours(typename G::Bits b)
+{
+    const int W = G::kWidth;
+    return (((b << 1) & G::kNotCol0) | ((b >> 1) & G::kNotColL)
+          | (b << W) | (b >> W)
+          | ((b << (W + 1)) & G::kNotCol0) | ((b << (W - 1)) & G::kNotColL)
+          | ((b >> (W - 1)) & G::kNotCol0) | ((b >> (W + 1)) & G::kNotColL))
+          & G::kBoard;
+}
+
+// All squares two steps away on a line from some bit of 'b'.
+template <class G>
+static inline typename G::Bits dilate_jumps(typename G::Bits b)
+{
+    const int W = G::kWidth;
+    return (((b << 2) & G::kNotCol01) | ((b >> 2) & G::kNotColL2)
+          | (b << (2 * W)) | (b >> (2 * W))
+          | ((b << (2 * W + 2)) & G::kNotCol01) | ((b << (2 * W - 2)) & G::kNotColL2)
+          | ((b >> (2 * W - 2)) & G::kNotCol01) | ((b >> (2 * W + 2)) & G::kNotColL2))
+          & G::kBoard;
+}
+
+/**
+ * Count, for every square at once, how many of its 8 neighbours are set in
+ * 'b'. The count (0..8) is returned bit-sliced: bit k of square i's count
+ * is bit i of planes[k]. Carry-save adders over the 8 shifted boards keep
+ * all squares in one bitboard.
+ */
+template <class G>
+static inline void neighbour_count_planes(typename G::Bits b,
+                                          typename G::Bits planes[4])
+{
+    typedef typename G::Bits Bits;
+    const int W = G::kWidth;
+    Bits n[8] = {
+        (b << 1) & G::kNotCol0,       (b >> 1) & G::kNotColL,
+        b << W,                       b >> W,
+        (b << (W + 1)) & G::kNotCol0, (b << (W - 1)) & G::kNotColL,
+        (b >> (W - 1)) & G::kNotCol0, (b >> (W + 1)) & G::kNotColL,
+    };
+    // Full adders for lanes 0-2 and 3-5, half adder for lanes 6-7.
+    Bits s1 = n[0] ^ n[1] ^ n[2];
+    Bits c1 = (n[0] & n[1]) | (n[2] & (n[0] ^ n[1]));
+    Bits s2 = n[3] ^ n[4] ^ n[5];
+    Bits c2 = (n[3] & n[4]) | (n[5] & (n[3] ^ n[4]));
+    Bits s3 = n[6] ^ n[7];
+    Bits c3 = n[6] & n[7];
+    // Ones column.
+    Bits c4 = (s1 & s2) | (s3 & (s1 ^ s2));
+    planes[0] = s1 ^ s2 ^ s3;
+    // Twos column: c1 + c2 + c3 + c4.
+    Bits t  = c1 ^ c2 ^ c3;
+    Bits k1 = (c1 & c2) | (c3 & (c1 ^ c2));
+    Bits k2 = t & c4;
+    planes[1] = t ^ c4;
+    // Fours and eights column: k1 + k2.
+    planes[2] = k1 ^ k2;
+    planes[3] = k1 & k2;
+}
+
+/**
+ * Largest bit-sliced count among the squares in 'set', or -1 if 'set' is
+ * empty. Walks the planes from the most significant one, keeping only the
+ * squares that still tie for the maximum.
+ */
+template <typename Bits>
+static inline int max_count_in(Bits set, const Bits planes[4])
+{
+    if (!bb_any(set)) return -1;
+    int value = 0;
+    for (int k = 3; k >= 0; k--) {
+        Bits hit = set & planes[k];
+        if (bb_any(hit)) {
+            set = hit;
+            value |= 1 << k;
+        }
+    }
+    return value;
+}
+
+/**
+ * Depth-1 search without making any move. A child's score is the parent's
+ * piece difference, +1 for a clone, plus 2 for every opponent piece next to
+ * the destination, so the best child follows from the clone and jump
+ * destination sets and the opponent neighbour counts of all squares.
+ * Returns the same value as searching every child to depth 0.
+ */
+template <class G>
+static int leaf_score_bitboard(typename G::Bits my_mask,
+                               typename G::Bits opp_mask,
+                               typename G::Bits wall_mask)
+{
+    typedef typename G::Bits Bits;
+    Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+    Bits clone_targets = dilate_neighbours<G>(my_mask) & empty;
+    Bits jump_targets  = dilate_jumps<G>(my_mask) & empty;
+    int base = evaluate_board(my_mask, opp_mask);
+    if (!bb_any(clone_targets | jump_targets)) {
+        // Passing leaves the opponent a depth-0 node: the same score.
+        return game_over_after_pass<G>(my_mask, opp_mask, wall_mask)
+             ? final_score(base) : base;
+    }
+
+    Bits planes[4];
+    neighbour_count_planes<G>(opp_mask, planes);
+    int best_clone = max_count_in(clone_targets, planes);
+    int best_jump  = max_count_in(jump_targets, planes);
+    int gain_clone = (best_clone >= 0) ? 1 + 2 * best_clone : -SCORE_INF;
+    int gain_jump  = (best_jump  >= 0) ? 2 * best_jump      : -SCORE_INF;
+    return base + ((gain_clone > gain_jump) ? gain_clone : gain_jump);
+}
+
+template <class G>
+static inline bool game_over_after_pass(typename G::Bits my_mask,
+                                        typename G::Bits opp_mask,
+                                        typename G::Bits wall_mask)
+{
+    typename G::Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+    return !bb_any(my_mask) ||
+           !bb_any((dilate_neighbours<G>(opp_mask) | dilate_jumps<G>(opp_mask)) & empty);
+}
+
+/*
+ * Pattern evaluation (eval.h), used instead of the piece count once
+ * engine_eval_open() has loaded weights for the board size. A depth-1 node
+ * then scores each child with the tables: the region indices are computed
+ * once for the node and updated per child from the squares the move
+ * changes (the destination, a vacated source and the flips), so a child
+ * costs a few index updates, eight table lookups and the bitboard counts
+ * of the linear terms.
+ */
+static EvalWeights  eval_weights;
+static EvalPatterns eval_patterns;
+static uint64_t     eval_salt;      // keeps the evaluators' scores apart
+                                    // in the transposition table
+
+template <class G>
+static inline bool patterns_active(void)
+{
+    return eval_weights.side == G::kWidth;
+}
+
+// Region indices of a position from my point of view.
+template <class G>
+static inline void pattern_indices(typename G::Bits my_mask,
+                                   typename G::Bits opp_mask,
+                                   uint32_t index[EVAL_INSTANCES])
+{
+    for (int i = 0; i < EVAL_INSTANCES; i++) {
+        uint32_t idx = 0, weight = 1;
+        for (int k = 0; k < eval_patterns.cells[i]; k++) {
+            int sq = eval_patterns.square[i][k];
+            idx += weight * (bb_test(my_mask, sq) ? 1 : bb_test(opp_mask, sq) ? 2 : 0);
+            weight *= 3;
+        }
+        index[i] = idx;
+    }
+}
+
+// Change square 'sq' by 'digits' (new state minus old) in every region.
+static inline void pattern_update(uint32_t index[EVAL_INSTANCES], int sq,
+                                  int digits)
+{
+    const EvalMembership *m = eval_patterns.member[sq];
+    for (int i = 0; i < eval_patterns.member_count[sq]; i++) {
+        index[m[i].instance] += (uint32_t)(digits * (int)m[i].weight);
+    }
+}
+
+// Score of a position from my point of view, given its region indices.
+template <class G>
+static inline int pattern_score(const uint32_t index[EVAL_INSTANCES],
+                                typename G::Bits my_mask,
+                                typename G::Bits opp_mask,
+                                typename G::Bits wall_mask)
+{
+    typedef typename G::Bits Bits;
+    Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+    Bits near_empty = dilate_neighbours<G>(empty);
+    int terms[EVAL_LINEAR];
+    terms[EVAL_MATERIAL] = bb_popcount(my_mask) - bb_popcount(opp_mask);
+    terms[EVAL_MOBILITY] =
+        bb_popcount((dilate_neighbours<G>(my_mask) | dilate_jumps<G>(my_mask)) & empty) -
+        bb_popcount((dilate_neighbours<G>(opp_mask) | dilate_jumps<G>(opp_mask)) & empty);
+    terms[EVAL_FRONTIER] = bb_popcount(my_mask & near_empty) -
+                           bb_popcount(opp_mask & near_empty);
+    return eval_sum(&eval_weights, eval_phase(bb_popcount(empty), G::kSquares),
+                    index, terms);
+}
+
+template <class G>
+static inline int pattern_position_score(typename G::Bits my_mask,
+                                         typename G::Bits opp_mask,
+                                         typename G::Bits wall_mask)
+{
+    uint32_t index[EVAL_INSTANCES];
+    pattern_indices<G>(my_mask, opp_mask, index);
+    return pattern_score<G>(index, my_mask, opp_mask, wall_mask);
+}
+
+// Score, from my point of view, of the child after 'move'.
+template <class G>
+static inline int pattern_child_score(const uint32_t parent[EVAL_INSTANCES],
+                                      typename G::Bits my_mask,
+                                      typename G::Bits opp_mask,
+                                      typename G::Bits wall_mask,
+                                      PackedMove move)
+{
+    typedef typename G::Bits Bits;
+    uint32_t index[EVAL_INSTANCES];
+    memcpy(index, parent, sizeof(index));
+    int to = G::to(move);
+    pattern_update(index, to, +1);                          // empty -> mine
+    if (move & G::kJump) pattern_update(index, G::from(move), -1);  // mine -> empty
+    for (Bits f = G::kNeighbours.m[to] & opp_mask; bb_any(f); f = bb_drop_lsb(f)) {
+        pattern_update(index, bb_lsb(f), -1);               // theirs -> mine
+    }
+    Bits nm, no;
+    apply_move_bitboard<G>(my_mask, opp_mask, move, &nm, &no);
+    return pattern_score<G>(index, nm, no, wall_mask);
+}
+
+/*
+ * Persistent search state: transposition table, history counters and the
+ * principal variation of the last search. It is allocated once and kept
+ * across moves; with a snapshot file it also survives the process. Entries
+ * of different board sizes share the table; their keys are salted by size.
+ *
+ * Several threads may search at once and share it without locks. A table
+ * entry is two words, the packed data and its key XORed with that data, so
+ * a probe that races with a store sees a key mismatch rather than a torn
+ * entry. History counters are updated atomically; they and the saved PV
+ * only steer move ordering.
+ *
+ * A generation of entries is about one move long: engine_state_next_search()
+ * starts one at most every GENERATION_MS, however many games search at once,
+ * so the 6-bit age still tells recent entries from stale ones.
+ */
+#define TT_MAGIC     0x5454434fu   // "OCTT"
+#define TT_VERSION   3u
+#define TT_WAYS      4
+#define TT_BUCKETS   (1u << 18)    // 16 MB of entries
+#define HISTORY_SIZE 0x8000        // indexed by the low 15 bits of a move
+#define AGE_MASK     63
+#define GENERATION_MS 1000
+
+enum { TT_EXACT = 1, TT_LOWER = 2, TT_UPPER = 3 };
+
+/*
+ * data: bits 0..15 move, 16..31 score, 32..39 depth,
+ *       40..47 flags (bits 0..1 bound type, bits 2..7 age)
+ */
+typedef struct {
+    uint64_t check;     // key ^ data
+    uint64_t data;
+} TTEntry;
+
+static inline PackedMove tt_move(uint64_t data)  { return (PackedMove)data; }
+static inline int        tt_score(uint64_t data) { return (int16_t)(data >> 16); }
+static inline int        tt_depth(uint64_t data) { return (uint8_t)(data >> 32); }
+static inline int        tt_flags(uint64_t data) { return (uint8_t)(data >> 40); }
+
+typedef struct {
+    TTEntry entry[TT_WAYS];
+} __attribute__((aligned(64))) TTBucket;
+
+typedef struct {
+    uint32_t   magic;
+    uint32_t   version;
+    uint32_t   buckets;
+    uint32_t   age;             // bumped by every generation, masked on use
+    uint64_t   pv_key;          // position the saved PV continues from
+    int32_t    pv_len;
+    PackedMove pv[MAX_PLY];
+    int32_t    history[HISTORY_SIZE];
+    TTBucket   tt[TT_BUCKETS];
+} EngineState;
+
+static EngineState *engine_state;
+static int engine_state_mapped;   // backed by a snapshot file
+
+void engine_state_clear(void)
+{
+    memset(engine_state, 0, sizeof(*engine_state));
+    engine_state->magic   = TT_MAGIC;
+    engine_state->version = TT_VERSION;
+    engine_state->buckets = TT_BUCKETS;
+}
+
+/**
+ * Map the persistent engine state. With a path the state lives in that
+ * file, and a snapshot left by an earlier run is reused if its header
+ * matches. Without a path, or if the file can't be mapped, anonymous
+ * memory is used instead. Either way the pages are populated up front, so
+ * the first search does not take the page faults.
+ *
+ * @return 0 on success, -1 if no memory could be mapped at all
+ */
+int engine_state_open(const char *path)
+{
+    size_t size = sizeof(EngineState);
+    void *p = MAP_FAILED;
+
+    if (path) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd >= 0) {
+            struct stat st;
+            if (fstat(fd, &st) == 0 &&
+                ((size_t)st.st_size == size || ftruncate(fd, size) == 0)) {
+                p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, 0);
+            }
+            close(fd);
+        }
+        if (p == MAP_FAILED) {
+            fprintf(stderr, "[engine] cannot map %s, search state will not be saved\n",
+                    path);
+        }
+    }
+    engine_state_mapped = (p != MAP_FAILED);
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (p == MAP_FAILED) return -1;
+    }
+    engine_state = (EngineState *)p;
+
+    if (engine_state->magic != TT_MAGIC ||
+        engine_state->version != TT_VERSION ||
+        engine_state->buckets != TT_BUCKETS) {
+        engine_state_clear();
+    } else {
+        printf("[engine] warm start from %s\n", path);
+    }
+    return 0;
+}
+
+// Schedule write-back of a file-backed state; no-op for anonymous memory.
+void engine_state_sync(void)
+{
+    if (engine_state && engine_state_mapped) {
+        msync(engine_state, sizeof(*engine_state), MS_ASYNC);
+    }
+}
+
+void engine_state_close(void)
+{
+    if (!engine_state) return;
+    munmap(engine_state, sizeof(*engine_state));
+    engine_state = NULL;
+}
+
+static long long generation_ms;   // when the last generation started
+
+/*
+ * Start a new generation: entries written from now on are one younger,
+ * and old history counts fade so the current position dominates. Other
+ * threads may be searching, so neither update may lose theirs.
+ */
+static void engine_new_generation(void)
+{
+    __atomic_fetch_add(&engine_state->age, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < HISTORY_SIZE; i++) {
+        int32_t *history = &engine_state->history[i];
+        int32_t v = __atomic_load_n(history, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(history, &v, v >> 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+}
+
+void engine_state_next_search(void)
+{
+    if (!engine_state) return;
+    long long now = get_time_ms();
+    long long last = __atomic_load_n(&generation_ms, __ATOMIC_RELAXED);
+    if (now - last < GENERATION_MS) return;
+    // Only the thread that moves the clock on starts the generation.
+    if (__atomic_compare_exchange_n(&generation_ms, &last, now, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        engine_new_generation();
+    }
+}
+
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Hash of a position from the side to move's point of view.
+template <class G>
+static inline uint64_t hash_position(typename G::Bits my_mask,
+                                     typename G::Bits opp_mask,
+                                     typename G::Bits wall_mask)
+{
+    const uint64_t salt = (0x9E3779B97F4A7C15ULL + (uint64_t)(G::kWidth * 256 + G::kHeight))
+                        ^ (patterns_active<G>() ? eval_salt : 0);
+    return mix64(bb_fold(my_mask) ^
+                 mix64(bb_fold(opp_mask) ^ mix64(bb_fold(wall_mask) ^ salt)));
+}
+
+// Find 'key' and copy its packed data into 'data'.
+static inline bool tt_probe(uint64_t key, uint64_t *data)
+{
+    TTBucket *bucket = &engine_state->tt[key & (TT_BUCKETS - 1)];
+    for (int i = 0; i < TT_WAYS; i++) {
+        uint64_t d = __atomic_load_n(&bucket->entry[i].data, __ATOMIC_RELAXED);
+        uint64_t c = __atomic_load_n(&bucket->entry[i].check, __ATOMIC_RELAXED);
+        if ((c ^ d) == key) {
+            *data = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Store a search result. An entry for the same position is overwritten;
+ * otherwise the least valuable entry of the bucket goes, where every
+ * generation an entry has aged costs it as much as 8 plies of depth.
+ */
+static void tt_store(uint64_t key, PackedMove move, int score, int depth,
+                     int bound)
+{
+    TTBucket *bucket = &engine_state->tt[key & (TT_BUCKETS - 1)];
+    uint32_t age = __atomic_load_n(&engine_state->age, __ATOMIC_RELAXED) & AGE_MASK;
+    TTEntry *victim = &bucket->entry[0];
+    int victim_worth = INT_MAX;
+
+    for (int i = 0; i < TT_WAYS; i++) {
+        TTEntry *e = &bucket->entry[i];
+        uint64_t d = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+        uint64_t c = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+        if ((c ^ d) == key) {
+            victim = e;
+            if (!move) move = tt_move(d);
+            break;
+        }
+        int e_age = (int)((age - (tt_flags(d) >> 2)) & AGE_MASK);
+        int worth = tt_depth(d) - 8 * e_age;
+        if (worth < victim_worth) {
+            victim_worth = worth;
+            victim = e;
+        }
+    }
+    uint64_t data = (uint64_t)move
+                  | (uint64_t)(uint16_t)score << 16
+                  | (uint64_t)(uint8_t)depth << 32
+                  | (uint64_t)(uint8_t)(bound | (age << 2)) << 40;
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+}
+
+// Material swing of a move: +1 for a clone, +2 per flipped piece.
+template <class G>
+static inline int move_gain(PackedMove move, typename G::Bits opp_mask)
+{
+    return 2 * bb_popcount(G::kNeighbours.m[G::to(move)] & opp_mask)
+         + !(move & G::kJump);
+}
+
+/**
+ * Ordering key: the hash move first, then the material swing, then the
+ * late-game preference for the destination's region (0..15, see
+ * RegionInfo), then how often the move caused a cutoff before.
+ */
+template <class G>
+static inline int move_order_key(PackedMove move, PackedMove hash_move,
+                                 typename G::Bits opp_mask, int region_term)
+{
+    if (move == hash_move) return INT_MAX;
+    int history = __atomic_load_n(&engine_state->history[move & (HISTORY_SIZE - 1)],
+                                  __ATOMIC_RELAXED);
+    if (history > 0xFFFF) history = 0xFFFF;
+    return (move_gain<G>(move, opp_mask) << 20) | (region_term << 16) | history;
+}
+
+// Swap the best remaining move (by ordering key) into slot 'i'.
+static inline void pick_next_move(PackedMove *moves, int *order, int i, int n)
+{
+    int best = i;
+    for (int j = i + 1; j < n; j++) {
+        if (order[j] > order[best]) best = j;
+    }
+    if (best != i) {
+        PackedMove m = moves[i]; moves[i] = moves[best]; moves[best] = m;
+        int o = order[i]; order[i] = order[best]; order[best] = o;
+    }
+}
+
+/**
+ * Split 'empty' into regions of adjacent squares by flood fill: grow a
+ * region from its lowest square, adding the empty neighbours of each
+ * square as it is reached, so every square costs one table lookup. Returns
+ * the number of regions, at most REGION_MAX.
+ */
+template <class G>
+static int empty_regions(typename G::Bits empty,
+                         typename G::Bits regions[REGION_MAX])
+{
+    typedef typename G::Bits Bits;
+    int count = 0;
+    while (bb_any(empty)) {
+        if (count == REGION_MAX - 1) {
+            regions[count++] = empty;
+            break;
+        }
+        Bits region = bb_square<Bits>(bb_lsb(empty));
+        Bits frontier = region;
+        while (bb_any(frontier)) {
+            Bits added = G::kNeighbours.m[bb_lsb(frontier)] & empty & ~region;
+            region = region | added;
+            frontier = bb_drop_lsb(frontier) | added;
+        }
+        regions[count++] = region;
+        empty = empty & ~region;
+    }
+    return count;
+}
+
+/*
+ * The regions of a late-game node, for move ordering. A move's region is
+ * that of its destination. Its ordering term prefers odd regions, where
+ * the side that moves first can also move last, and then small regions,
+ * so that regions are finished one at a time instead of interleaved.
+ */
+template <class G>
+struct RegionInfo {
+    int              count;         // 0 unless there are several regions
+    typename G::Bits mask[REGION_MAX];
+    uint64_t         key[REGION_MAX];
+    int              term[REGION_MAX];
+    PackedMove       hint[REGION_MAX];  // cached best move, or 0
+};
+
+// Key of a region and the pieces around it, which a move into the region
+// may flip. Jump sources further out are left out on purpose: the key only
+// selects a hint, and the coarser key finds one far more often.
+template <class G>
+static inline uint64_t region_key(typename G::Bits region,
+                                  typename G::Bits my_mask,
+                                  typename G::Bits opp_mask)
+{
+    typename G::Bits zone = dilate_neighbours<G>(region);
+    return mix64(bb_fold(region) ^
+                 mix64(bb_fold(my_mask & zone) ^ mix64(bb_fold(opp_mask & zone))));
+}
+
+template <class G>
+static void region_setup(const SearchContext<G> *ctx,
+                         typename G::Bits my_mask,
+                         typename G::Bits opp_mask,
+                         typename G::Bits empty,
+                         RegionInfo<G> *info)
+{
+    info->count = 0;
+    int count = empty_regions<G>(empty, info->mask);
+    if (count < 2) return;
+    for (int r = 0; r < count; r++) {
+        int size = bb_popcount(info->mask[r]);
+        info->term[r] = ((size & 1) ? 8 : 0) + (size < 8 ? 8 - size : 0);
+        info->key[r] = region_key<G>(info->mask[r], my_mask, opp_mask);
+        const RegionCacheEntry *e =
+            &ctx->region_cache[info->key[r] & (REGION_CACHE_SIZE - 1)];
+        info->hint[r] = (e->key == info->key[r]) ? e->move : 0;
+    }
+    info->count = count;
+}
+
+template <class G>
+static inline int region_of(const RegionInfo<G> *info, int sq)
+{
+    for (int r = 0; r < info->count; r++) {
+        if (bb_test(info->mask[r], sq)) return r;
+    }
+    return -1;
+}
+
+/**
+ * Depth-1 search with the pattern evaluation: the best child score, or the
+ * position's own score if the side to move has to pass.
+ */
+template <class G>
+static int pattern_leaf_score(SearchContext<G> *ctx,
+                              typename G::Bits my_mask,
+                              typename G::Bits opp_mask,
+                              typename G::Bits wall_mask)
+{
+    PackedMove *moves = ctx->move_top;
+    int move_count = generate_moves_bitboard<G>(my_mask, opp_mask, wall_mask,
+                                                moves);
+    uint32_t index[EVAL_INSTANCES];
+    pattern_indices<G>(my_mask, opp_mask, index);
+    if (move_count == 0) {
+        return game_over_after_pass<G>(my_mask, opp_mask, wall_mask)
+             ? final_score(evaluate_board(my_mask, opp_mask))
+             : pattern_score<G>(index, my_mask, opp_mask, wall_mask);
+    }
+    int best = -SCORE_INF;
+    for (int i = 0; i < move_count; i++) {
+        int score = pattern_child_score<G>(index, my_mask, opp_mask, wall_mask,
+                                           moves[i]);
+        if (score > best) best = score;
+    }
+    return best;
+}
+
+/**
+ * The search before node types: one alpha-beta function for every node,
+ * with a full window throughout. Kept only as the baseline of
+ * engine_search_rate().
+ */
+template <class G>
+static int minimax_plain(SearchContext<G> *ctx,
+                         typename G::Bits my_mask,
+                         typename G::Bits opp_mask,
+                         typename G::Bits wall_mask,
+                         int depth,
+                         int ply,
+                         int alpha,
+                         int beta)
+{
+    typedef typename G::Bits Bits;
+    ctx->nodes++;
+    ctx->pv_len[ply] = 0;
+    if ((ctx->nodes & 1023) == 0 && search_should_stop(ctx)) {
+        ctx->stopped = 1;
+    }
+    if (ctx->stopped) {
+        return 0;
+    }
+    if (depth == 0) {
+        return patterns_active<G>()
+             ? pattern_position_score<G>(my_mask, opp_mask, wall_mask)
+             : evaluate_board(my_mask, opp_mask);
+    }
+    if (depth == 1) {
+        return patterns_active<G>()
+             ? pattern_leaf_score<G>(ctx, my_mask, opp_mask, wall_mask)
+             : leaf_score_bitboard<G>(my_mask, opp_mask, wall_mask);
+    }
+
+    int alpha_orig = alpha;
+    uint64_t key = hash_position<G>(my_mask, opp_mask, wall_mask);
+    PackedMove hash_move = 0;
+    uint64_t entry;
+    if (tt_probe(key, &entry)) {
+        hash_move = tt_move(entry);
+        if (tt_depth(entry) >= depth) {
+            int bound = tt_flags(entry) & 3;
+            int score = tt_score(entry);
+            if (bound == TT_EXACT ||
+                (bound == TT_LOWER && score >= beta) ||
+                (bound == TT_UPPER && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    PackedMove *moves = ctx->move_top;
+    int *order = ctx->order_stack + (moves - ctx->move_stack);
+    int move_count = generate_moves_bitboard<G>(my_mask, opp_mask, wall_mask,
+                                                moves);
+    if (move_count == 0) {
+        if (game_over_after_pass<G>(my_mask, opp_mask, wall_mask)) {
+            return final_score(evaluate_board(my_mask, opp_mask));
+        }
+        return -minimax_plain<G>(ctx, opp_mask, my_mask, wall_mask,
+                                 depth - 1, ply + 1, -beta, -alpha);
+    }
+    ctx->move_top = moves + move_count;
+    RegionInfo<G> regions;
+    regions.count = 0;
+    Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+    if (bb_popcount(empty) <= REGION_MAX_EMPTIES) {
+        region_setup<G>(ctx, my_mask, opp_mask, empty, &regions);
+    }
+    for (int i = 0; i < move_count; i++) {
+        int r = regions.count ? region_of<G>(&regions, G::to(moves[i])) : -1;
+        if (r >= 0 && moves[i] == regions.hint[r] && moves[i] != hash_move) {
+            order[i] = INT_MAX - 1;     // right after the hash move
+        } else {
+            order[i] = move_order_key<G>(moves[i], hash_move, opp_mask,
+                                         r >= 0 ? regions.term[r] : 0);
+        }
+    }
+
+    int best = -SCORE_INF;
+    PackedMove best_move = 0;
+    for (int i = 0; i < move_count; i++) {
+        pick_next_move(moves, order, i, move_count);
+        Bits nm, no;
+        apply_move_bitboard<G>(my_mask, opp_mask, moves[i], &nm, &no);
+        int score = -minimax_plain<G>(ctx, no, nm, wall_mask,
+                                      depth - 1, ply + 1,
+                                      -beta, -alpha);
+        if (ctx->stopped) {
+            break;
+        }
+        if (score > best) {
+            best = score;
+            best_move = moves[i];
+        }
+        if (score > alpha) {
+            alpha = score;
+            ctx->pv[ply][0] = moves[i];
+            memcpy(&ctx->pv[ply][1], ctx->pv[ply + 1],
+                   ctx->pv_len[ply + 1] * sizeof(PackedMove));
+            ctx->pv_len[ply] = ctx->pv_len[ply + 1] + 1;
+            if (alpha >= beta) {
+                __atomic_fetch_add(&engine_state->history[moves[i] & (HISTORY_SIZE - 1)],
+                                   depth * depth, __ATOMIC_RELAXED);
+                break;  // cutoff
+            }
+        }
+    }
+    ctx->move_top = moves;
+    if (ctx->stopped) {
+        return 0;
+    }
+
+    int bound = (best <= alpha_orig) ? TT_UPPER
+              : (best >= beta)       ? TT_LOWER
+              :                        TT_EXACT;
+    tt_store(key, best_move, best, depth, bound);
+    if (regions.count && bound != TT_UPPER) {
+        int r = region_of<G>(&regions, G::to(best_move));
+        RegionCacheEntry *e = &ctx->region_cache[regions.key[r] & (REGION_CACHE_SIZE - 1)];
+        e->key = regions.key[r];
+        e->move = best_move;
+    }
+    return best;
+}
+
+// Node types of search_node(). The root searches the caller's move list;
+// PV nodes have an open window and keep the principal variation; non-PV
+// nodes only test a null window.
+enum { NODE_ROOT = 0, NODE_PV, NODE_NON_PV };
+
+/**
+ * Principal variation search, compiled once per node type and evaluator so
+ * each node carries only the code that applies to it. At PV nodes (and the
+ * root) the first move is searched with the full window and the others
+ * with a null window, again with the full one if they land inside it.
+ * Non-PV nodes pass their null window on and skip the PV table.
+ *
+ * @param ctx       per-thread search state (move stack, node counter, PV)
+ * @param my_mask   current player's bits
+ * @param opp_mask  opponent's bits
+ * @param wall_mask wall bits
+ * @param depth     how many plies left; at least 1 at the root
+ * @param ply       distance from the root
+ * @param alpha
+ * @param beta      alpha + 1 at non-PV nodes
+ *
+ * Fail-soft: returns the best score from "my" perspective, an upper bound
+ * if at most alpha and a lower bound if at least beta. The root searches
+ * ctx->root in order, leaves each score in ctx->iter_scores and the best
+ * move's index in ctx->root_best. Once the search has to stop,
+ * ctx->stopped is set and the returned value must be ignored.
+ */
+template <class G, int Node, bool Patterns>
+static int search_node(SearchContext<G> *ctx,
+                       typename G::Bits my_mask,
+                       typename G::Bits opp_mask,
+                       typename G::Bits wall_mask,
+                       int depth,
+                       int ply,
+                       int alpha,
+                       int beta)
+{
+    typedef typename G::Bits Bits;
+    const bool pv_node = (Node != NODE_NON_PV);
+    ctx->nodes++;
+    if (pv_node) ctx->pv_len[ply] = 0;
+    if ((ctx->nodes & 1023) == 0 && search_should_stop(ctx)) {
+        ctx->stopped = 1;
+    }
+    if (ctx->stopped) {
+        return 0;
+    }
+    if (Node != NODE_ROOT && depth == 0) {
+        return Patterns ? pattern_position_score<G>(my_mask, opp_mask, wall_mask)
+                        : evaluate_board(my_mask, opp_mask);
+    }
+    if (Node != NODE_ROOT && depth == 1) {
+        return Patterns ? pattern_leaf_score<G>(ctx, my_mask, opp_mask, wall_mask)
+                        : leaf_score_bitboard<G>(my_mask, opp_mask, wall_mask);
+    }
+
+    int alpha_orig = alpha;
+    uint64_t key = 0;
+    PackedMove hash_move = 0;
+    PackedMove *moves;
+    int *order = NULL;
+    int move_count;
+    RegionInfo<G> regions;
+    regions.count = 0;
+    if (Node == NODE_ROOT) {
+        moves = ctx->root;
+        move_count = ctx->root_moves;
+        ctx->root_best = 0;
+    } else {
+        key = hash_position<G>(my_mask, opp_mask, wall_mask);
+        uint64_t entry;
+        if (tt_probe(key, &entry)) {
+            hash_move = tt_move(entry);
+            if (tt_depth(entry) >= depth) {
+                int bound = tt_flags(entry) & 3;
+                int score = tt_score(entry);
+                if (bound == TT_EXACT ||
+                    (bound == TT_LOWER && score >= beta) ||
+                    (bound == TT_UPPER && score <= alpha)) {
+                    return score;
+                }
+            }
+        }
+
+        moves = ctx->move_top;
+        order = ctx->order_stack + (moves - ctx->move_stack);
+        move_count = generate_moves_bitboard<G>(my_mask, opp_mask, wall_mask,
+                                                moves);
+        if (move_count == 0) {
+            if (game_over_after_pass<G>(my_mask, opp_mask, wall_mask)) {
+                return final_score(evaluate_board(my_mask, opp_mask));
+            }
+            return -search_node<G, Node, Patterns>(ctx, opp_mask, my_mask, wall_mask,
+                                                   depth - 1, ply + 1, -beta, -alpha);
+        }
+        ctx->move_top = moves + move_count;
+        Bits empty = ~(my_mask | opp_mask | wall_mask) & G::kBoard;
+        if (bb_popcount(empty) <= REGION_MAX_EMPTIES) {
+            region_setup<G>(ctx, my_mask, opp_mask, empty, &regions);
+        }
+        for (int i = 0; i < move_count; i++) {
+            int r = regions.count ? region_of<G>(&regions, G::to(moves[i])) : -1;
+            if (r >= 0 && moves[i] == regions.hint[r] && moves[i] != hash_move) {
+                order[i] = INT_MAX - 1;     // right after the hash move
+            } else {
+                order[i] = move_order_key<G>(moves[i], hash_move, opp_mask,
+                                             r >= 0 ? regions.term[r] : 0);
+            }
+        }
+    }
+
+    int best = -SCORE_INF;
+    PackedMove best_move = 0;
+    for (int i = 0; i < move_count; i++) {
+        if (Node != NODE_ROOT) pick_next_move(moves, order, i, move_count);
+        Bits nm, no;
+        apply_move_bitboard<G>(my_mask, opp_mask, moves[i], &nm, &no);
+        int score;
+        if (!pv_node) {
+            score = -search_node<G, NODE_NON_PV, Patterns>(ctx, no, nm, wall_mask,
+                                                           depth - 1, ply + 1,
+                                                           -beta, -alpha);
+        } else if (i == 0) {
+            score = -search_node<G, NODE_PV, Patterns>(ctx, no, nm, wall_mask,
+                                                       depth - 1, ply + 1,
+                                                       -beta, -alpha);
+        } else {
+            score = -search_node<G, NODE_NON_PV, Patterns>(ctx, no, nm, wall_mask,
+                                                           depth - 1, ply + 1,
+                                                           -alpha - 1, -alpha);
+            if (score > alpha && score < beta && !ctx->stopped) {
+                score = -search_node<G, NODE_PV, Patterns>(ctx, no, nm, wall_mask,
+                                                           depth - 1, ply + 1,
+                                                           -beta, -alpha);
+            }
+        }
+        if (ctx->stopped) {
+            break;
+        }
+        if (Node == NODE_ROOT) ctx->iter_scores[i] = score;
+        if (score > best) {
+            best = score;
+            best_move = moves[i];
+            if (Node == NODE_ROOT) ctx->root_best = i;
+        }
+        if (score > alpha) {
+            alpha = score;
+            if (pv_node) {
+                ctx->pv[ply][0] = moves[i];
+                memcpy(&ctx->pv[ply][1], ctx->pv[ply + 1],
+                       ctx->pv_len[ply + 1] * sizeof(PackedMove));
+                ctx->pv_len[ply] = ctx->pv_len[ply + 1] + 1;
+            }
+            if (alpha >= beta) {
+                __atomic_fetch_add(&engine_state->history[moves[i] & (HISTORY_SIZE - 1)],
+                                   depth * depth, __ATOMIC_RELAXED);
+                break;  // cutoff
+            }
+        }
+    }
+    if (Node == NODE_ROOT) {
+        return best;    // the caller keeps the root's table entry
+    }
+    ctx->move_top = moves;
+    if (ctx->stopped) {
+        return 0;
+    }
+
+    int bound = (best <= alpha_orig) ? TT_UPPER
+              : (best >= beta)       ? TT_LOWER
+              :                        TT_EXACT;
+    tt_store(key, best_move, best, depth, bound);
+    if (regions.count && bound != TT_UPPER) {
+        int r = region_of<G>(&regions, G::to(best_move));
+        RegionCacheEntry *e = &ctx->region_cache[regions.key[r] & (REGION_CACHE_SIZE - 1)];
+        e->key = regions.key[r];
+        e->move = best_move;
+    }
+    return best;
+}
+
+// search_node() with the evaluator picked for the board size.
+template <class G, int Node>
+static inline int search_entry(SearchContext<G> *ctx,
+                               typename G::Bits my_mask,
+                               typename G::Bits opp_mask,
+                               typename G::Bits wall_mask,
+                               int depth, int ply, int alpha, int beta)
+{
+    return patterns_active<G>()
+         ? search_node<G, Node, true>(ctx, my_mask, opp_mask, wall_mask,
+                                      depth, ply, alpha, beta)
+         : search_node<G, Node, false>(ctx, my_mask, opp_mask, wall_mask,
+                                       depth, ply, alpha, beta);
+}
+
+/**
+ * Whether every root move but the first scores below 'bound' when searched
+ * to 'depth' plies. Null windows make this much cheaper than an iteration.
+ */
+template <class G>
+static bool root_alternatives_below(SearchContext<G> *ctx,
+                                    const PackedMove *root, int root_moves,
+                                    typename G::Bits my_mask,
+                                    typename G::Bits opp_mask,
+                                    typename G::Bits wall_mask,
+                                    int depth, int bound)
+{
+    for (int i = 1; i < root_moves; i++) {
+        typename G::Bits nm, no;
+        apply_move_bitboard<G>(my_mask, opp_mask, root[i], &nm, &no);
+        int score = -search_entry<G, NODE_NON_PV>(ctx, no, nm, wall_mask,
+                                                  depth - 1, 1, -bound, -bound + 1);
+        if (ctx->stopped || score >= bound) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a root move is one of limits->exclude. Clones to one square are
+// the same move, of which the generator keeps one.
+template <class G>
+static bool root_excluded(const SearchContext<G> *ctx, PackedMove move)
+{
+    for (int i = 0; i < ctx->exclude_count; i++) {
+        const EngineMove *x = &ctx->exclude[i];
+        int from = x->from_row * G::kWidth + x->from_col;
+        int to = x->to_row * G::kWidth + x->to_col;
+        bool clone = abs(x->to_row - x->from_row) <= 1 &&
+                     abs(x->to_col - x->from_col) <= 1;
+        if (G::to(move) == to &&
+            (clone ? !(move & G::kJump) : G::from(move) == from)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Iteratively deepen the root position up to 'max_depth' plies or until the
+ * deadline, and return the best move of the last completed iteration (0 if
+ * there is no legal move). Root moves live at the bottom of ctx's move
+ * stack; the best one is moved to the front after every iteration.
+ *
+ * The search commits early to a single legal move, to a proven win or
+ * loss, and (when timed) to an easy move; 'stop_reason' tells which.
+ *
+ * On return the persistent state holds the remainder of the principal
+ * variation, keyed by the position expected after our move and the
+ * predicted reply, so the next search starts from it.
+ */
+template <class G>
+static PackedMove search_root(SearchContext<G> *ctx,
+                              typename G::Bits my_mask,
+                              typename G::Bits opp_mask,
+                              typename G::Bits wall_mask,
+                              int max_depth,
+                              int *best_score,
+                              int *completed_depth,
+                              int *stop_reason)
+{
+    typedef typename G::Bits Bits;
+    PackedMove *root = ctx->move_top;
+    int *order = ctx->order_stack;
+    int root_moves = generate_moves_bitboard<G>(my_mask, opp_mask, wall_mask,
+                                                root);
+    if (ctx->exclude_count) {
+        int kept = 0;
+        for (int i = 0; i < root_moves; i++) {
+            if (!root_excluded(ctx, root[i])) root[kept++] = root[i];
+        }
+        root_moves = kept;
+    }
+    if (root_moves == 0) {
+        return 0;
+    }
+    ctx->move_top = root + root_moves;
+
+    // Hint: the table's move, else what the last search predicted here.
+    uint64_t key = hash_position<G>(my_mask, opp_mask, wall_mask);
+    PackedMove hint = 0;
+    uint64_t entry;
+    if (tt_probe(key, &entry)) {
+        hint = tt_move(entry);
+    } else if (engine_state->pv_key == key && engine_state->pv_len > 0) {
+        hint = engine_state->pv[0];
+    }
+    for (int i = 0; i < root_moves; i++) {
+        order[i] = move_order_key<G>(root[i], hint, opp_mask, 0);
+    }
+    for (int i = 0; i < root_moves; i++) {
+        pick_next_move(root, order, i, root_moves);
+    }
+
+    PackedMove best_move = root[0];
+    int best = evaluate_board(my_mask, opp_mask);
+    int done = 0;
+    PackedMove *pv = ctx->root_pv;
+    int stable = 0;
+    int timed = (ctx->deadline_ms != LLONG_MAX);
+    int reason = ENGINE_STOP_DEPTH;
+
+    if (root_moves == 1) {
+        reason = ENGINE_STOP_ONLY_MOVE;
+        max_depth = 0;
+    }
+    ctx->root = root;
+    ctx->root_moves = root_moves;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        int alpha = search_entry<G, NODE_ROOT>(ctx, my_mask, opp_mask, wall_mask,
+                                               depth, 0, -SCORE_INF, SCORE_INF);
+        int iter_best = ctx->root_best;
+        if (ctx->stopped) {
+            reason = search_stop_reason(ctx);
+            break;
+        }
+
+        stable = (done > 0 && root[iter_best] == best_move) ? stable + 1 : 1;
+        best_move = root[iter_best];
+        best = alpha;
+        done = depth;
+        ctx->root_pv_len = ctx->pv_len[0];
+        memcpy(pv, ctx->pv[0], ctx->root_pv_len * sizeof(PackedMove));
+        memmove(&root[1], &root[0], iter_best * sizeof(PackedMove));
+        root[0] = best_move;
+        int *scores = ctx->root_scores;
+        memcpy(scores, ctx->iter_scores, root_moves * sizeof(int));
+        memmove(&scores[1], &scores[0], iter_best * sizeof(int));
+        scores[0] = best;
+        ctx->root_count = root_moves;
+        // Without some root moves the score isn't the position's: the
+        // shared table must not take it as exact.
+        if (!ctx->exclude_count) tt_store(key, best_move, best, depth, TT_EXACT);
+
+        if (best >= SCORE_WIN / 2 || best <= -SCORE_WIN / 2) {
+            reason = ENGINE_STOP_PROVEN;
+            break;
+        }
+        if (timed && depth >= EASY_MIN_DEPTH &&
+            stable >= EASY_STABLE_ITERATIONS &&
+            root_alternatives_below<G>(ctx, root, root_moves,
+                                       my_mask, opp_mask, wall_mask,
+                                       depth - 2, best - EASY_MARGIN)) {
+            reason = ENGINE_STOP_EASY_MOVE;
+            break;
+        }
+        if (ctx->stopped || search_should_stop(ctx)) {
+            reason = search_stop_reason(ctx);
+            break;
+        }
+    }
+
+    // Keep the PV beyond our move and the expected reply for next time.
+    int pv_len = ctx->root_pv_len;
+    engine_state->pv_len = 0;
+    if (pv_len > 2) {
+        Bits m1, o1, m2, o2;
+        apply_move_bitboard<G>(my_mask, opp_mask, pv[0], &m1, &o1);
+        apply_move_bitboard<G>(o1, m1, pv[1], &o2, &m2);
+        engine_state->pv_key = hash_position<G>(m2, o2, wall_mask);
+        engine_state->pv_len = pv_len - 2;
+        memcpy(engine_state->pv, &pv[2], (pv_len - 2) * sizeof(PackedMove));
+    }
+
+    ctx->move_top = root;
+    if (best_score) *best_score = best;
+    if (completed_depth) *completed_depth = done;
+    if (stop_reason) *stop_reason = reason;
+    return best_move;
+}
+
+/**
+ * The calling thread's search context for one board size, allocated and
+ * touched on first use (or by engine_prepare()), so sizes that are never
+ * played cost no memory. Contexts live as long as their thread.
+ */
+template <int W, int H>
+static SearchContext<Geometry<W, H> > *search_context(void)
+{
+    static __thread SearchContext<Geometry<W, H> > *ctx;
+    if (!ctx) {
+        ctx = (SearchContext<Geometry<W, H> > *)malloc(sizeof(*ctx));
+        if (ctx) memset(ctx, 0, sizeof(*ctx));
+    }
+    return ctx;
+}
+
+template <class G>
+static inline void unpack_move(PackedMove move, EngineMove *out)
+{
+    out->from_row = G::from(move) / G::kWidth;
+    out->from_col = G::from(move) % G::kWidth;
+    out->to_row   = G::to(move) / G::kWidth;
+    out->to_col   = G::to(move) % G::kWidth;
+}
+
+/**
+ * Fill result->ranked from the root moves, best first, left at the bottom
+ * of the move stack with their scores by the last completed iteration.
+ * Ties keep the search's move order. Without a completed iteration only
+ * the best move is known.
+ */
+template <class G>
+static void rank_root_moves(const SearchContext<G> *ctx,
+                            const PackedMove *root, EngineResult *result)
+{
+    result->ranked[0] = result->move;
+    result->ranked_scores[0] = result->score;
+    int len = 1;
+    for (int i = 1; i < ctx->root_count; i++) {
+        int score = ctx->root_scores[i];
+        if (len == ENGINE_MAX_RANKED && score <= result->ranked_scores[len - 1]) {
+            continue;
+        }
+        int k = (len < ENGINE_MAX_RANKED) ? len++ : len - 1;
+        while (k > 1 && result->ranked_scores[k - 1] < score) {
+            result->ranked[k] = result->ranked[k - 1];
+            result->ranked_scores[k] = result->ranked_scores[k - 1];
+            k--;
+        }
+        unpack_move<G>(root[i], &result->ranked[k]);
+        result->ranked_scores[k] = score;
+    }
+    result->ranked_len = len;
+}
+
+// Search entry point for one board size.
+template <int W, int H>
+static int search_position(const EnginePosition *pos,
+                           const EngineLimits *limits,
+                           EngineResult *result)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    SearchContext<G> *ctx = search_context<W, H>();
+    if (!ctx) return -1;
+
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    Bits my_mask  = (pos->to_move == 'R') ? red  : blue;
+    Bits opp_mask = (pos->to_move == 'R') ? blue : red;
+
+    int max_depth = limits->max_depth;
+    if (max_depth < 1 || max_depth > MAX_PLY - 1) max_depth = MAX_PLY - 1;
+
+    search_context_reset(ctx, limits);
+    int score = 0, depth = 0, reason = ENGINE_STOP_DEPTH;
+    PackedMove best = search_root<G>(ctx, my_mask, opp_mask, wall,
+                                     max_depth, &score, &depth, &reason);
+    result->score = score;
+    result->depth = depth;
+    result->nodes = ctx->nodes;
+    result->stop_reason = reason;
+    if (!best) {
+        return 0;
+    }
+    unpack_move<G>(best, &result->move);
+    int pv_len = ctx->root_pv_len;
+    if (pv_len > ENGINE_MAX_PV) pv_len = ENGINE_MAX_PV;
+    for (int i = 0; i < pv_len; i++) {
+        unpack_move<G>(ctx->root_pv[i], &result->pv[i]);
+    }
+    result->pv_len = pv_len;
+    rank_root_moves<G>(ctx, ctx->move_stack, result);
+    return 1;
+}
+
+// Boards with a compiled specialization; keep in sync with ENGINE_*_SIDE.
+#define ENGINE_FOR_EACH_SIDE(X) \
+    X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11)
+
+int engine_supports(int height, int width)
+{
+    return height == width &&
+           height >= ENGINE_MIN_SIDE && height <= ENGINE_MAX_SIDE;
+}
+
+int engine_prepare(int height, int width)
+{
+    if (!engine_supports(height, width)) return -1;
+    switch (width) {
+#define ENGINE_PREPARE_CASE(N) \
+    case N: return search_context<N, N>() ? 0 : -1;
+    ENGINE_FOR_EACH_SIDE(ENGINE_PREPARE_CASE)
+#undef ENGINE_PREPARE_CASE
+    }
+    return -1;
+}
+
+int engine_position_from_rows(EnginePosition *pos,
+                              const char *const *rows,
+                              int height, int width,
+                              char to_move)
+{
+    if (!engine_supports(height, width)) return -1;
+    memset(pos, 0, sizeof(*pos));
+    pos->height = height;
+    pos->width = width;
+    pos->to_move = to_move;
+
+    for (int r = 0; r < height; r++) {
+        for (int c = 0; c < width; c++) {
+            int idx = r * width + c;
+            uint64_t bit = 1ULL << (idx & 63);
+            if (rows[r][c] == 'R') {
+                pos->red[idx >> 6] |= bit;
+            } else if (rows[r][c] == 'B') {
+                pos->blue[idx >> 6] |= bit;
+            } else if (rows[r][c] == '#') {
+                pos->wall[idx >> 6] |= bit;
+            }
+            // else '.' → do nothing
+        }
+    }
+    return 0;
+}
+
+int engine_start_position(EnginePosition *pos, int side)
+{
+    if (!engine_supports(side, side)) return -1;
+    int last = side - 1;
+    memset(pos, 0, sizeof(*pos));
+    pos->height = side;
+    pos->width = side;
+    pos->to_move = 'R';
+    pos->red[0] = 1ULL;
+    pos->blue[0] = 1ULL << last;
+    int bottom_left = last * side, bottom_right = last * side + last;
+    pos->blue[bottom_left >> 6] |= 1ULL << (bottom_left & 63);
+    pos->red[bottom_right >> 6] |= 1ULL << (bottom_right & 63);
+    return 0;
+}
+
+static_assert(Geometry<ENGINE_MAX_SIDE, ENGINE_MAX_SIDE>::kMaxMoves <= ENGINE_MAX_MOVES,
+              "ENGINE_MAX_MOVES too small");
+
+template <int W, int H>
+static int legal_moves(const EnginePosition *pos, EngineMove *out)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    PackedMove moves[G::kMaxMoves];
+    int move_count = (pos->to_move == 'R')
+                   ? generate_moves_bitboard<G>(red, blue, wall, moves)
+                   : generate_moves_bitboard<G>(blue, red, wall, moves);
+    for (int i = 0; i < move_count; i++) {
+        unpack_move<G>(moves[i], &out[i]);
+    }
+    return move_count;
+}
+
+int engine_legal_moves(const EnginePosition *pos, EngineMove *moves)
+{
+    if (!engine_supports(pos->height, pos->width)) return -1;
+    switch (pos->width) {
+#define ENGINE_MOVES_CASE(N) \
+    case N: return legal_moves<N, N>(pos, moves);
+    ENGINE_FOR_EACH_SIDE(ENGINE_MOVES_CASE)
+#undef ENGINE_MOVES_CASE
+    }
+    return -1;
+}
+
+template <int W, int H>
+static int play_move(EnginePosition *pos, const EngineMove *move)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    uint64_t *mine   = (pos->to_move == 'R') ? pos->red  : pos->blue;
+    uint64_t *theirs = (pos->to_move == 'R') ? pos->blue : pos->red;
+    if (move) {
+        if (move->from_row < 0 || move->from_row >= H ||
+            move->from_col < 0 || move->from_col >= W ||
+            move->to_row < 0 || move->to_row >= H ||
+            move->to_col < 0 || move->to_col >= W) {
+            return -1;
+        }
+        Bits my_mask  = bb_from_words<Bits>(mine);
+        Bits opp_mask = bb_from_words<Bits>(theirs);
+        Bits wall     = bb_from_words<Bits>(pos->wall);
+        int from = move->from_row * W + move->from_col;
+        int to   = move->to_row * W + move->to_col;
+        bool clone = bb_test(G::kNeighbours.m[from], to);
+        if (!bb_test(my_mask, from) || bb_test(my_mask | opp_mask | wall, to) ||
+            (!clone && !bb_test(G::kJumps.m[from], to))) {
+            return -1;
+        }
+        Bits nm, no;
+        apply_move_bitboard<G>(my_mask, opp_mask, G::pack(from, to, !clone),
+                               &nm, &no);
+        bb_to_words(nm, mine);
+        bb_to_words(no, theirs);
+    }
+    pos->to_move = (pos->to_move == 'R') ? 'B' : 'R';
+    return 0;
+}
+
+int engine_play(EnginePosition *pos, const EngineMove *move)
+{
+    if (!engine_supports(pos->height, pos->width)) return -1;
+    switch (pos->width) {
+#define ENGINE_PLAY_CASE(N) \
+    case N: return play_move<N, N>(pos, move);
+    ENGINE_FOR_EACH_SIDE(ENGINE_PLAY_CASE)
+#undef ENGINE_PLAY_CASE
+    }
+    return -1;
+}
+
+template <int W, int H>
+static int static_score(const EnginePosition *pos)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    Bits my_mask  = (pos->to_move == 'R') ? red  : blue;
+    Bits opp_mask = (pos->to_move == 'R') ? blue : red;
+    return patterns_active<G>()
+         ? pattern_position_score<G>(my_mask, opp_mask, wall)
+         : evaluate_board(my_mask, opp_mask);
+}
+
+int engine_evaluate(const EnginePosition *pos, int *score)
+{
+    if (!engine_supports(pos->height, pos->width)) return -1;
+    switch (pos->width) {
+#define ENGINE_EVALUATE_CASE(N) \
+    case N: *score = static_score<N, N>(pos); return 0;
+    ENGINE_FOR_EACH_SIDE(ENGINE_EVALUATE_CASE)
+#undef ENGINE_EVALUATE_CASE
+    }
+    return -1;
+}
+
+int engine_search(const EnginePosition *pos,
+                  const EngineLimits *limits,
+                  EngineResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (!engine_supports(pos->height, pos->width)) return -1;
+    switch (pos->width) {
+#define ENGINE_SEARCH_CASE(N) \
+    case N: return search_position<N, N>(pos, limits, result);
+    ENGINE_FOR_EACH_SIDE(ENGINE_SEARCH_CASE)
+#undef ENGINE_SEARCH_CASE
+    }
+    return -1;
+}
+
+template <int W, int H>
+static int window_search(const EnginePosition *pos, int depth,
+                         int alpha, int beta, const EngineLimits *limits,
+                         int *score, unsigned long long *nodes)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    SearchContext<G> *ctx = search_context<W, H>();
+    if (!ctx) return -1;
+
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    Bits my_mask  = (pos->to_move == 'R') ? red  : blue;
+    Bits opp_mask = (pos->to_move == 'R') ? blue : red;
+
+    if (depth < 0) depth = 0;
+    if (depth > MAX_PLY - 2) depth = MAX_PLY - 2;
+    if (alpha < -SCORE_INF) alpha = -SCORE_INF;
+    if (beta > SCORE_INF) beta = SCORE_INF;
+
+    search_context_reset(ctx, limits);
+    int s = (beta - alpha > 1)
+          ? search_entry<G, NODE_PV>(ctx, my_mask, opp_mask, wall, depth, 1,
+                                     alpha, beta)
+          : search_entry<G, NODE_NON_PV>(ctx, my_mask, opp_mask, wall, depth, 1,
+                                         alpha, beta);
+    *nodes = ctx->nodes;
+    if (ctx->stopped) return 0;
+    *score = s;
+    return 1;
+}
+
+int engine_search_window(const EnginePosition *pos, int depth,
+                         int alpha, int beta, const EngineLimits *limits,
+                         int *score, unsigned long long *nodes)
+{
+    *nodes = 0;
+    if (!engine_supports(pos->height, pos->width)) return -1;
+    switch (pos->width) {
+#define ENGINE_WINDOW_CASE(N) \
+    case N: return window_search<N, N>(pos, depth, alpha, beta, limits, \
+                                       score, nodes);
+    ENGINE_FOR_EACH_SIDE(ENGINE_WINDOW_CASE)
+#undef ENGINE_WINDOW_CASE
+    }
+    return -1;
+}
+
+/**
+ * Use the pattern tables in 'path' for boards of the size they were fitted
+ * for. Call before any search starts; the tables are shared read-only.
+ *
+ * @return 0 on success, -1 if the file can't be mapped or is malformed
+ */
+int engine_eval_open(const char *path)
+{
+    engine_eval_close();
+    if (eval_weights_open(&eval_weights, path) != 0) {
+        fprintf(stderr, "[engine] cannot load evaluation weights from %s\n", path);
+        return -1;
+    }
+    eval_patterns_init(&eval_patterns, eval_weights.side);
+    // Table scores of different weight files must not mix.
+    const uint64_t *words = (const uint64_t *)eval_weights.map;
+    uint64_t salt = 0;
+    for (size_t i = 0; i < eval_weights.map_size / sizeof(uint64_t); i++) {
+        salt = mix64(salt ^ words[i]);
+    }
+    eval_salt = salt | 1;
+    printf("[engine] pattern evaluation for %dx%d from %s\n",
+           eval_weights.side, eval_weights.side, path);
+    return 0;
+}
+
+void engine_eval_close(void)
+{
+    eval_weights_close(&eval_weights);
+    eval_salt = 0;
+}
+
+/**
+ * Evaluate every child of 'pos' over and over for about 200 ms and return
+ * the evaluations per second: with the piece count, with the pattern
+ * tables updated from the parent's indices as the search does, or with
+ * the tables computed from scratch for every child.
+ */
+static volatile int eval_rate_sink;   // keeps the timed loop from being elided
+
+template <int W, int H>
+static double eval_rate(const EnginePosition *pos, int evaluator)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    SearchContext<G> *ctx = search_context<W, H>();
+    if (!ctx || (evaluator != ENGINE_EVAL_MATERIAL && !patterns_active<G>())) {
+        return 0;
+    }
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    Bits my_mask  = (pos->to_move == 'R') ? red  : blue;
+    Bits opp_mask = (pos->to_move == 'R') ? blue : red;
+    PackedMove *moves = ctx->move_stack;
+    int move_count = generate_moves_bitboard<G>(my_mask, opp_mask, wall, moves);
+    if (move_count == 0) return 0;
+
+    unsigned long long calls = 0;
+    long long start_time = get_time_ms(), elapsed;
+    int sum = 0;
+    do {
+        for (int rep = 0; rep < 1000; rep++) {
+            uint32_t index[EVAL_INSTANCES];
+            if (evaluator == ENGINE_EVAL_PATTERNS) {
+                pattern_indices<G>(my_mask, opp_mask, index);
+            }
+            for (int i = 0; i < move_count; i++) {
+                Bits nm, no;
+                switch (evaluator) {
+                case ENGINE_EVAL_MATERIAL:
+                    apply_move_bitboard<G>(my_mask, opp_mask, moves[i], &nm, &no);
+                    sum += evaluate_board(nm, no);
+                    break;
+                case ENGINE_EVAL_PATTERNS:
+                    sum += pattern_child_score<G>(index, my_mask, opp_mask, wall,
+                                                  moves[i]);
+                    break;
+                default:
+                    apply_move_bitboard<G>(my_mask, opp_mask, moves[i], &nm, &no);
+                    sum += pattern_position_score<G>(nm, no, wall);
+                    break;
+                }
+            }
+            calls += move_count;
+        }
+        elapsed = get_time_ms() - start_time;
+    } while (elapsed < 200);
+    eval_rate_sink = sum;
+    return calls * 1000.0 / elapsed;
+}
+
+template <int W, int H>
+static double search_rate(const EnginePosition *pos, int depth, int search,
+                          unsigned long long *nodes)
+{
+    typedef Geometry<W, H> G;
+    typedef typename G::Bits Bits;
+    SearchContext<G> *ctx = search_context<W, H>();
+    if (!ctx || !engine_state) return 0;
+    Bits red  = bb_from_words<Bits>(pos->red);
+    Bits blue = bb_from_words<Bits>(pos->blue);
+    Bits wall = bb_from_words<Bits>(pos->wall);
+    Bits my_mask  = (pos->to_move == 'R') ? red  : blue;
+    Bits opp_mask = (pos->to_move == 'R') ? blue : red;
+    if (depth < 1) depth = 1;
+    if (depth > MAX_PLY - 1) depth = MAX_PLY - 1;
+
+    EngineLimits limits = { 0, LLONG_MAX, NULL, 0, NULL, 0 };
+    engine_state_clear();
+    search_context_reset(ctx, &limits);
+    long long start_time = get_time_ms();
+    for (int d = 1; d <= depth; d++) {
+        if (search == ENGINE_SEARCH_PLAIN) {
+            minimax_plain<G>(ctx, my_mask, opp_mask, wall, d, 0,
+                             -SCORE_INF, SCORE_INF);
+        } else {
+            search_entry<G, NODE_PV>(ctx, my_mask, opp_mask, wall, d, 0,
+                                     -SCORE_INF, SCORE_INF);
+        }
+    }
+    long long elapsed = get_time_ms() - start_time;
+    if (elapsed < 1) elapsed = 1;
+    if (nodes) *nodes = ctx->nodes;
+    return ctx->nodes * 1000.0 / elapsed;
+}
+
+double engine_search_rate(const EnginePosition *pos, int depth, int search,
+                          unsigned long long *nodes)
+{
+    if (!engine_supports(pos->height, pos->width)) return 0;
+    switch (pos->width) {
+#define ENGINE_SEARCH_RATE_CASE(N) \
+    case N: return search_rate<N, N>(pos, depth, search, nodes);
+    ENGINE_FOR_EACH_SIDE(ENGINE_SEARCH_RATE_CASE)
+#undef ENGINE_SEARCH_RATE_CASE
+    }
+    return 0;
+}
+
+double engine_eval_rate(const EnginePosition *pos, int evaluator)
+{
+    if (!engine_supports(pos->height, pos->width)) return 0;
+    switch (pos->width) {
+#define ENGINE_EVAL_RATE_CASE(N) \
+    case N: return eval_rate<N, N>(pos, evaluator);
+    ENGINE_FOR_EACH_SIDE(ENGINE_EVAL_RATE_CASE)
+#undef ENGINE_EVAL_RATE_CASE
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+// eval.c
+#include "eval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint32_t pow3(int n)
+{
+    uint32_t p = 1;
+    while (n-- > 0) p *= 3;
+    return p;
+}
+
+size_t eval_file_size(int side)
+{
+    return sizeof(EvalFileHeader)
+         + (size_t)EVAL_PHASES * (EVAL_CORNER_SIZE + pow3(side) + EVAL_LINEAR)
+           * sizeof(int16_t);
+}
+
+int eval_weights_open(EvalWeights *weights, const char *path)
+{
+    memset(weights, 0, sizeof(*weights));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(EvalFileHeader)) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE,
+                 fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+
+    const EvalFileHeader *h = (const EvalFileHeader *)p;
+    if (h->magic != EVAL_MAGIC || h->version != EVAL_VERSION ||
+        h->side < ENGINE_MIN_SIDE || h->side > ENGINE_MAX_SIDE ||
+        h->phases != EVAL_PHASES || h->corner_size != EVAL_CORNER_SIZE ||
+        h->edge_size != pow3((int)h->side) || h->linear_size != EVAL_LINEAR ||
+        (size_t)st.st_size != eval_file_size((int)h->side)) {
+        munmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    const int16_t *tables = (const int16_t *)(h + 1);
+    weights->side = (int)h->side;
+    weights->edge_size = h->edge_size;
+    weights->corner = tables;
+    weights->edge = weights->corner + EVAL_PHASES * EVAL_CORNER_SIZE;
+    weights->linear = weights->edge + EVAL_PHASES * h->edge_size;
+    weights->map = p;
+    weights->map_size = (size_t)st.st_size;
+    return 0;
+}
+
+void eval_weights_close(EvalWeights *weights)
+{
+    if (weights->map) munmap(weights->map, weights->map_size);
+    memset(weights, 0, sizeof(*weights));
+}
+
+int eval_weights_save(const char *path, int side, const int16_t *corner,
+                      const int16_t *edge, const int16_t *linear)
+{
+    EvalFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = EVAL_MAGIC;
+    h.version = EVAL_VERSION;
+    h.side = (uint32_t)side;
+    h.phases = EVAL_PHASES;
+    h.corner_size = EVAL_CORNER_SIZE;
+    h.edge_size = pow3(side);
+    h.linear_size = EVAL_LINEAR;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(corner, sizeof(int16_t), (size_t)EVAL_PHASES * EVAL_CORNER_SIZE, f)
+                 == (size_t)EVAL_PHASES * EVAL_CORNER_SIZE &&
+             fwrite(edge, sizeof(int16_t), (size_t)EVAL_PHASES * h.edge_size, f)
+                 == (size_t)EVAL_PHASES * h.edge_size &&
+             fwrite(linear, sizeof(int16_t), (size_t)EVAL_PHASES * EVAL_LINEAR, f)
+                 == (size_t)EVAL_PHASES * EVAL_LINEAR;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+static void add_cell(EvalPatterns *p, int instance, int r, int c)
+{
+    int sq = r * p->side + c;
+    int digit = p->cells[instance]++;
+    p->square[instance][digit] = (uint8_t)sq;
+    EvalMembership *m = &p->member[sq][p->member_count[sq]++];
+    m->instance = (uint8_t)instance;
+    m->weight = pow3(digit);
+}
+
+/**
+ * Corner k reads its 3×3 region row by row from the corner inwards; edge k
+ * runs clockwise from corner k. Corner 0 is the top left, then clockwise,
+ * so region k of either kind is region 0 turned or mirrored.
+ */
+void eval_patterns_init(EvalPatterns *p, int side)
+{
+    memset(p, 0, sizeof(*p));
+    p->side = side;
+    const int last = side - 1;
+    const int corner_row[EVAL_CORNERS] = { 0, 0, last, last };
+    const int corner_col[EVAL_CORNERS] = { 0, last, last, 0 };
+    for (int k = 0; k < EVAL_CORNERS; k++) {
+        int dr = corner_row[k] ? -1 : 1;
+        int dc = corner_col[k] ? -1 : 1;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                add_cell(p, k, corner_row[k] + dr * i, corner_col[k] + dc * j);
+            }
+        }
+    }
+    for (int i = 0; i < side; i++) {
+        add_cell(p, EVAL_CORNERS + 0, 0, i);
+        add_cell(p, EVAL_CORNERS + 1, i, last);
+        add_cell(p, EVAL_CORNERS + 2, last, last - i);
+        add_cell(p, EVAL_CORNERS + 3, last - i, 0);
+    }
+}
+
+static inline int cell(const uint64_t *mask, int sq)
+{
+    return (int)((mask[sq >> 6] >> (sq & 63)) & 1);
+}
+
+void eval_features(const EvalPatterns *patterns, const EnginePosition *pos,
+                   char perspective, EvalFeatures *features)
+{
+    const uint64_t *mine = (perspective == 'R') ? pos->red : pos->blue;
+    const uint64_t *theirs = (perspective == 'R') ? pos->blue : pos->red;
+    int side = pos->width, squares = side * side;
+
+    for (int i = 0; i < EVAL_INSTANCES; i++) {
+        uint32_t index = 0, weight = 1;
+        for (int k = 0; k < patterns->cells[i]; k++) {
+            int sq = patterns->square[i][k];
+            index += weight * (cell(mine, sq) ? 1 : cell(theirs, sq) ? 2 : 0);
+            weight *= 3;
+        }
+        features->index[i] = index;
+    }
+
+    int empty_count = 0, material = 0, mobility = 0, frontier = 0;
+    for (int sq = 0; sq < squares; sq++) {
+        int r = sq / side, c = sq % side;
+        int is_empty = !cell(mine, sq) && !cell(theirs, sq) && !cell(pos->wall, sq);
+        int near_mine = 0, near_theirs = 0, near_empty = 0;
+        for (int dr = -2; dr <= 2; dr++) {
+            for (int dc = -2; dc <= 2; dc++) {
+                int nr = r + dr, nc = c + dc;
+                if ((dr == 0 && dc == 0) || nr < 0 || nr >= side || nc < 0 || nc >= side)
+                    continue;
+                // Jumps go along lines only.
+                int ring2 = (dr == 2 || dr == -2 || dc == 2 || dc == -2);
+                if (ring2 && dr != 0 && dc != 0 && dr != dc && dr != -dc) continue;
+                int n = nr * side + nc;
+                near_mine |= cell(mine, n);
+                near_theirs |= cell(theirs, n);
+                if (!ring2) {
+                    near_empty |= !cell(mine, n) && !cell(theirs, n) && !cell(pos->wall, n);
+                }
+            }
+        }
+        if (is_empty) {
+            empty_count++;
+            mobility += near_mine - near_theirs;
+        } else if (cell(mine, sq)) {
+            material++;
+            frontier += near_empty;
+        } else if (cell(theirs, sq)) {
+            material--;
+            frontier -= near_empty;
+        }
+    }
+    features->phase = eval_phase(empty_count, squares);
+    features->linear[EVAL_MATERIAL] = material;
+    features->linear[EVAL_MOBILITY] = mobility;
+    features->linear[EVAL_FRONTIER] = frontier;
+}
@@ -0,0 +1,307 @@
+// fit.c
+//
+// Fits pattern evaluation weights (see eval.h) to game outcomes and writes
+// them as a weight file for -eval-file.
+//
+//   ./fit -out <weights> [-size <side>] [-threads <n>] [-epochs <n>]
+//         [-rate <r>] [-ridge <l>] <archive>...
+//
+// Every position of every complete game of the given size is a sample,
+// once from each side's point of view, labelled with that side's final
+// piece difference. The weights are fitted by least squares: each epoch
+// computes every sample's residual and sums, per weight, the residuals of
+// the samples that use it; each weight then moves by its average residual,
+// scaled by the rate and shrunk towards zero by the ridge term so that
+// rarely seen patterns stay near neutral. Epochs are split over the
+// threads by sample range and are deterministic for any thread count.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "engine.h"
+#include "eval.h"
+#include "gamerec.h"
+
+// One position from one side's point of view.
+typedef struct {
+    uint32_t index[EVAL_INSTANCES];
+    int16_t  linear[EVAL_LINEAR];
+    int8_t   phase;
+    int8_t   reserved;
+    int32_t  target;                   // final piece difference, ours - theirs
+} Sample;
+
+// Weights in pieces, laid out like the weight file's tables.
+typedef struct {
+    double *corner;                    // [EVAL_PHASES][EVAL_CORNER_SIZE]
+    double *edge;                      // [EVAL_PHASES][edge_size]
+    double *linear;                    // [EVAL_PHASES][EVAL_LINEAR]
+} Model;
+
+// Per-thread sums for one epoch, per weight and laid out like Model: the
+// residual times the feature's value, and the value squared.
+typedef struct {
+    pthread_t thread;
+    size_t    begin, end;              // sample range
+    double   *gradient;
+    double   *count;
+    double    squared_error;
+} Worker;
+
+static EvalPatterns patterns;
+static uint32_t edge_size;
+static size_t weight_count;            // entries in a Model or Worker array
+
+static const GameRecordHeader **games;
+static size_t *game_first;             // index of each game's first sample
+static size_t game_count;
+static Sample *samples;
+static size_t sample_count;
+static int next_game;                  // claimed with __atomic_fetch_add
+
+static double *model_weights;          // one array, Model points into it
+static Model model;
+
+static void model_point(Model *m, double *base)
+{
+    m->corner = base;
+    m->edge = m->corner + EVAL_PHASES * EVAL_CORNER_SIZE;
+    m->linear = m->edge + EVAL_PHASES * edge_size;
+}
+
+static void set_sample(Sample *s, const EnginePosition *pos, char side,
+                       int target)
+{
+    EvalFeatures f;
+    eval_features(&patterns, pos, side, &f);
+    memcpy(s->index, f.index, sizeof(s->index));
+    for (int i = 0; i < EVAL_LINEAR; i++) s->linear[i] = (int16_t)f.linear[i];
+    s->phase = (int8_t)f.phase;
+    s->reserved = 0;
+    s->target = target;
+}
+
+static void *extract_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        size_t g = (size_t)__atomic_fetch_add(&next_game, 1, __ATOMIC_RELAXED);
+        if (g >= game_count) break;
+        const GameRecordHeader *game = games[g];
+        int red_lead = game->red_score - game->blue_score;
+        Sample *s = &samples[game_first[g]];
+        GameCursor cursor;
+        gamerec_cursor_start(&cursor, game);
+        do {
+            set_sample(s++, &cursor.pos, 'R', red_lead);
+            set_sample(s++, &cursor.pos, 'B', -red_lead);
+        } while (gamerec_cursor_step(&cursor));
+    }
+    return NULL;
+}
+
+static double predict(const Model *m, const Sample *s)
+{
+    const double *corner = m->corner + s->phase * EVAL_CORNER_SIZE;
+    const double *edge = m->edge + s->phase * edge_size;
+    const double *linear = m->linear + s->phase * EVAL_LINEAR;
+    double sum = 0;
+    for (int i = 0; i < EVAL_CORNERS; i++) sum += corner[s->index[i]];
+    for (int i = EVAL_CORNERS; i < EVAL_INSTANCES; i++) sum += edge[s->index[i]];
+    for (int i = 0; i < EVAL_LINEAR; i++) sum += linear[i] * s->linear[i];
+    return sum;
+}
+
+static void *epoch_main(void *arg)
+{
+    Worker *w = (Worker *)arg;
+    memset(w->gradient, 0, weight_count * sizeof(double));
+    memset(w->count, 0, weight_count * sizeof(double));
+    w->squared_error = 0;
+    Model g, n;
+    model_point(&g, w->gradient);
+    model_point(&n, w->count);
+
+    for (size_t k = w->begin; k < w->end; k++) {
+        const Sample *s = &samples[k];
+        double r = s->target - predict(&model, s);
+        w->squared_error += r * r;
+        size_t corner = (size_t)s->phase * EVAL_CORNER_SIZE;
+        size_t edge = (size_t)s->phase * edge_size;
+        size_t linear = (size_t)s->phase * EVAL_LINEAR;
+        for (int i = 0; i < EVAL_CORNERS; i++) {
+            g.corner[corner + s->index[i]] += r;
+            n.corner[corner + s->index[i]] += 1;
+        }
+        for (int i = EVAL_CORNERS; i < EVAL_INSTANCES; i++) {
+            g.edge[edge + s->index[i]] += r;
+            n.edge[edge + s->index[i]] += 1;
+        }
+        for (int i = 0; i < EVAL_LINEAR; i++) {
+            g.linear[linear + i] += r * s->linear[i];
+            n.linear[linear + i] += (double)s->linear[i] * s->linear[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * One pass over every sample, then one update of every weight.
+ *
+ * @return root mean squared error of the weights before the update
+ */
+static double run_epoch(Worker *workers, int threads, double rate, double ridge)
+{
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&workers[t].thread, NULL, epoch_main, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++) pthread_join(workers[t].thread, NULL);
+
+    // Summed in thread order, so the result does not depend on timing.
+    double squared_error = workers[0].squared_error;
+    for (int t = 1; t < threads; t++) {
+        squared_error += workers[t].squared_error;
+        for (size_t i = 0; i < weight_count; i++) {
+            workers[0].gradient[i] += workers[t].gradient[i];
+            workers[0].count[i] += workers[t].count[i];
+        }
+    }
+    for (size_t i = 0; i < weight_count; i++) {
+        double w = model_weights[i];
+        model_weights[i] += rate * (workers[0].gradient[i] - ridge * w)
+                          / (workers[0].count[i] + ridge);
+    }
+    return sqrt(squared_error / (double)sample_count);
+}
+
+static void quantize(const double *w, int16_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        double v = round(w[i] * EVAL_SCALE);
+        out[i] = (int16_t)(v > INT16_MAX ? INT16_MAX : v < -INT16_MAX ? -INT16_MAX : v);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_file = NULL;
+    int side = 8, epochs = 100;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double rate = 0.2, ridge = 4.0;
+    const char *archive_files[64];
+    int archive_count = 0;
+
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (archive_count == 64) { bad_args = 1; break; }
+            archive_files[archive_count++] = argv[i];
+            continue;
+        }
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-out") == 0)     out_file = argv[++i];
+        else if (strcmp(argv[i], "-size") == 0)    side = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-epochs") == 0)  epochs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-rate") == 0)    rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-ridge") == 0)   ridge = atof(argv[++i]);
+        else { bad_args = 1; break; }
+    }
+    if (bad_args || !out_file || archive_count == 0 ||
+        !engine_supports(side, side) || epochs < 0 || rate <= 0 || ridge <= 0) {
+        fprintf(stderr, "Usage: %s -out <weights> [-size <side>] [-threads <n>] [-epochs <n>]\n"
+                        "       [-rate <r>] [-ridge <l>] <archive>...\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    // Index the complete games of the right size.
+    GameArchive archives[64];
+    size_t capacity = 0;
+    for (int a = 0; a < archive_count; a++) {
+        if (gamerec_archive_open(&archives[a], archive_files[a]) != 0) {
+            fprintf(stderr, "[fit] cannot read %s\n", archive_files[a]);
+            return 1;
+        }
+        for (const GameRecordHeader *game = gamerec_first(&archives[a]); game;
+             game = gamerec_next(&archives[a], game)) {
+            if (game->height != side || game->width != side ||
+                (game->flags & GAMEREC_INCOMPLETE)) continue;
+            if (game_count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                games = (const GameRecordHeader **)realloc(games, capacity * sizeof(*games));
+                game_first = (size_t *)realloc(game_first, capacity * sizeof(size_t));
+            }
+            games[game_count] = game;
+            game_first[game_count++] = sample_count;
+            sample_count += 2 * (game->ply_count + 1ULL);
+        }
+    }
+    if (sample_count == 0) {
+        fprintf(stderr, "[fit] no complete %dx%d games\n", side, side);
+        return 1;
+    }
+
+    long long t0 = get_time_ms();
+    eval_patterns_init(&patterns, side);
+    samples = (Sample *)malloc(sample_count * sizeof(Sample));
+    pthread_t *extractors = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&extractors[t], NULL, extract_main, NULL);
+    }
+    for (int t = 0; t < threads; t++) pthread_join(extractors[t], NULL);
+    free(extractors);
+    for (int a = 0; a < archive_count; a++) gamerec_archive_close(&archives[a]);
+    printf("%zu games, %zu samples extracted in %lld ms\n",
+           game_count, sample_count, get_time_ms() - t0);
+
+    // Start from the plain piece count.
+    edge_size = 1;
+    for (int i = 0; i < side; i++) edge_size *= 3;
+    weight_count = (size_t)EVAL_PHASES * (EVAL_CORNER_SIZE + edge_size + EVAL_LINEAR);
+    model_weights = (double *)calloc(weight_count, sizeof(double));
+    model_point(&model, model_weights);
+    for (int p = 0; p < EVAL_PHASES; p++) model.linear[p * EVAL_LINEAR + EVAL_MATERIAL] = 1.0;
+
+    Worker *workers = (Worker *)calloc(threads, sizeof(Worker));
+    for (int t = 0; t < threads; t++) {
+        workers[t].begin = sample_count * t / threads;
+        workers[t].end = sample_count * (t + 1) / threads;
+        workers[t].gradient = (double *)malloc(weight_count * sizeof(double));
+        workers[t].count = (double *)malloc(weight_count * sizeof(double));
+    }
+    t0 = get_time_ms();
+    for (int e = 1; e <= epochs; e++) {
+        double rmse = run_epoch(workers, threads, rate, ridge);
+        if (e == 1 || e % 10 == 0 || e == epochs) {
+            printf("epoch %d: rms error %.3f pieces\n", e, rmse);
+        }
+    }
+    printf("%d epochs in %lld ms on %d threads\n", epochs, get_time_ms() - t0, threads);
+
+    int16_t *tables = (int16_t *)malloc(weight_count * sizeof(int16_t));
+    quantize(model_weights, tables, weight_count);
+    size_t edge_offset = (size_t)EVAL_PHASES * EVAL_CORNER_SIZE;
+    size_t linear_offset = edge_offset + (size_t)EVAL_PHASES * edge_size;
+    int status = 0;
+    if (eval_weights_save(out_file, side, tables, tables + edge_offset,
+                          tables + linear_offset) != 0) {
+        fprintf(stderr, "[fit] cannot write %s\n", out_file);
+        status = 1;
+    } else {
+        printf("weights for %dx%d written to %s\n", side, side, out_file);
+    }
+
+    free(tables);
+    for (int t = 0; t < threads; t++) {
+        free(workers[t].gradient);
+        free(workers[t].count);
+    }
+    free(workers);
+    free(model_weights);
+    free(samples);
+    free(games);
+    free(game_first);
+    return status;
+}
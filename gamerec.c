@@ -0,0 +1,374 @@
+// gamerec.c
+#include "gamerec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+static inline int square_test(const uint64_t *mask, int sq)
+{
+    return (int)((mask[sq >> 6] >> (sq & 63)) & 1);
+}
+
+static inline void square_set(uint64_t *mask, int sq)
+{
+    mask[sq >> 6] |= 1ULL << (sq & 63);
+}
+
+static inline void square_clear(uint64_t *mask, int sq)
+{
+    mask[sq >> 6] &= ~(1ULL << (sq & 63));
+}
+
+// The single square set in 'mask', or -1 if there are none or several.
+static int single_square(const uint64_t *mask)
+{
+    int sq = -1;
+    for (int w = 0; w < 2; w++) {
+        uint64_t bits = mask[w];
+        if (!bits) continue;
+        if (sq >= 0 || (bits & (bits - 1))) return -1;
+        sq = w * 64 + __builtin_ctzll(bits);
+    }
+    return sq;
+}
+
+static int same_board(const EnginePosition *a, const EnginePosition *b)
+{
+    return memcmp(a->red, b->red, sizeof(a->red)) == 0 &&
+           memcmp(a->blue, b->blue, sizeof(a->blue)) == 0;
+}
+
+/**
+ * Play a ply on a position: a jump vacates 'from', a clone keeps it; the
+ * mover then takes 'to' and every opposing piece around it.
+ */
+void gamerec_apply(EnginePosition *pos, const GamePly *ply)
+{
+    int red_moves = (pos->to_move == 'R');
+    pos->to_move = red_moves ? 'B' : 'R';
+    if (ply->from == GAMEREC_PASS) return;
+
+    uint64_t *mine = red_moves ? pos->red : pos->blue;
+    uint64_t *theirs = red_moves ? pos->blue : pos->red;
+    int w = pos->width;
+    int fr = ply->from / w, fc = ply->from % w;
+    int tr = ply->to / w, tc = ply->to % w;
+    if (abs(fr - tr) > 1 || abs(fc - tc) > 1) square_clear(mine, ply->from);
+    square_set(mine, ply->to);
+    for (int r = tr - 1; r <= tr + 1; r++) {
+        for (int c = tc - 1; c <= tc + 1; c++) {
+            if (r < 0 || r >= pos->height || c < 0 || c >= w) continue;
+            int sq = r * w + c;
+            if (square_test(theirs, sq)) {
+                square_clear(theirs, sq);
+                square_set(mine, sq);
+            }
+        }
+    }
+}
+
+void gamerec_header_init(GameRecordHeader *h, const EnginePosition *start,
+                         char our_color)
+{
+    memset(h, 0, sizeof(*h));
+    h->magic = GAMEREC_MAGIC;
+    h->version = GAMEREC_VERSION;
+    h->header_size = sizeof(GameRecordHeader);
+    h->height = (uint8_t)start->height;
+    h->width = (uint8_t)start->width;
+    h->to_move = (uint8_t)start->to_move;
+    h->our_color = (uint8_t)our_color;
+    h->start_time = (int64_t)time(NULL);
+    memcpy(h->red, start->red, sizeof(h->red));
+    memcpy(h->blue, start->blue, sizeof(h->blue));
+    memcpy(h->wall, start->wall, sizeof(h->wall));
+}
+
+void gamerec_make_ply(GamePly *ply, const EngineMove *move, int width,
+                      int time_ms, int eval, int depth)
+{
+    memset(ply, 0, sizeof(*ply));
+    if (move) {
+        ply->from = (uint8_t)(move->from_row * width + move->from_col);
+        ply->to = (uint8_t)(move->to_row * width + move->to_col);
+    } else {
+        ply->from = ply->to = GAMEREC_PASS;
+    }
+    ply->time_ms = (uint16_t)(time_ms > 65535 ? 65535 : time_ms);
+    ply->eval = (int16_t)eval;
+    ply->depth = (uint8_t)depth;
+}
+
+/**
+ * Append one game with a single writev(). On a file opened with O_APPEND
+ * the game lands in one piece even when several writers share the file.
+ *
+ * @return 0 on success, -1 if it was not fully written
+ */
+int gamerec_append(int fd, const GameRecordHeader *header, const GamePly *plies)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)header;
+    iov[0].iov_len = sizeof(*header);
+    iov[1].iov_base = (void *)plies;
+    iov[1].iov_len = header->ply_count * sizeof(GamePly);
+    ssize_t n = writev(fd, iov, 2);
+    return n == (ssize_t)(iov[0].iov_len + iov[1].iov_len) ? 0 : -1;
+}
+
+int gamerec_open(GameRecorder *rec, const char *path)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->fd = -1;
+    if (!path) return 0;
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (rec->fd < 0) {
+        fprintf(stderr, "[record] cannot open %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void push_ply(GameRecorder *rec, const GamePly *ply)
+{
+    if (rec->header.ply_count == rec->capacity) {
+        uint32_t capacity = rec->capacity ? rec->capacity * 2 : 128;
+        GamePly *plies = (GamePly *)realloc(rec->plies, capacity * sizeof(GamePly));
+        if (!plies) {
+            rec->header.flags |= GAMEREC_INCOMPLETE;
+            return;
+        }
+        rec->plies = plies;
+        rec->capacity = capacity;
+    }
+    rec->plies[rec->header.ply_count++] = *ply;
+    rec->last_ply_ms = get_time_ms();
+}
+
+/**
+ * Work out the ply that turned rec->expected into 'pos'. The square the
+ * mover gained that was empty before is 'to'; a square the mover vacated
+ * is 'from' (a jump), otherwise any of its pieces next to 'to' (a clone).
+ * An unchanged board is a pass. Returns -1 if no single ply explains the
+ * change, e.g. after a message was lost.
+ */
+static int infer_ply(const GameRecorder *rec, const EnginePosition *pos,
+                     GamePly *ply)
+{
+    const EnginePosition *before = &rec->expected;
+    int red_moved = (before->to_move == 'R');
+    const uint64_t *was = red_moved ? before->red : before->blue;
+    const uint64_t *now = red_moved ? pos->red : pos->blue;
+    uint64_t placed[2], vacated[2];
+    for (int i = 0; i < 2; i++) {
+        uint64_t was_empty = ~(before->red[i] | before->blue[i]);
+        uint64_t now_empty = ~(pos->red[i] | pos->blue[i]);
+        placed[i] = now[i] & ~was[i] & was_empty;
+        vacated[i] = was[i] & now_empty;
+    }
+
+    memset(ply, 0, sizeof(*ply));
+    long long elapsed = get_time_ms() - rec->last_ply_ms;
+    ply->time_ms = (uint16_t)(elapsed > 65535 ? 65535 : elapsed);
+    ply->eval = GAMEREC_NO_EVAL;
+    if (same_board(before, pos)) {
+        ply->from = ply->to = GAMEREC_PASS;
+        return 0;
+    }
+
+    int to = single_square(placed);
+    if (to < 0) return -1;
+    int from = -1;
+    if (vacated[0] | vacated[1]) {
+        from = single_square(vacated);
+    } else {
+        int w = pos->width, tr = to / w, tc = to % w;
+        for (int r = tr - 1; r <= tr + 1 && from < 0; r++) {
+            for (int c = tc - 1; c <= tc + 1; c++) {
+                if (r < 0 || r >= pos->height || c < 0 || c >= w) continue;
+                if (square_test(was, r * w + c)) { from = r * w + c; break; }
+            }
+        }
+    }
+    if (from < 0) return -1;
+    ply->from = (uint8_t)from;
+    ply->to = (uint8_t)to;
+
+    EnginePosition check = *before;
+    gamerec_apply(&check, ply);
+    return same_board(&check, pos) ? 0 : -1;
+}
+
+static void record_opponent(GameRecorder *rec, const EnginePosition *pos)
+{
+    GamePly ply;
+    if (infer_ply(rec, pos, &ply) != 0) {
+        fprintf(stderr, "[record] lost track of the game, keeping %u plies\n",
+                rec->header.ply_count);
+        rec->header.flags |= GAMEREC_INCOMPLETE;
+        return;
+    }
+    push_ply(rec, &ply);
+    rec->last_is_ours = 0;
+    gamerec_apply(&rec->expected, &ply);
+}
+
+void gamerec_observe(GameRecorder *rec, const EnginePosition *pos,
+                     char our_color)
+{
+    if (rec->fd < 0) return;
+    if (!rec->active) {
+        gamerec_header_init(&rec->header, pos, our_color);
+        rec->expected = *pos;
+        rec->last_is_ours = 0;
+        rec->last_ply_ms = get_time_ms();
+        rec->active = 1;
+        return;
+    }
+    // Nothing was played since our last look (e.g. our move was rejected).
+    if (pos->to_move == rec->expected.to_move) return;
+    if (rec->header.flags & GAMEREC_INCOMPLETE) return;
+    record_opponent(rec, pos);
+}
+
+void gamerec_record_move(GameRecorder *rec, const EngineMove *move,
+                         int time_ms, int eval, int depth)
+{
+    if (!rec->active || (rec->header.flags & GAMEREC_INCOMPLETE)) return;
+    GamePly ply;
+    gamerec_make_ply(&ply, move, rec->header.width, time_ms, eval, depth);
+    uint32_t count = rec->header.ply_count;
+    rec->before_last = rec->expected;
+    push_ply(rec, &ply);
+    rec->last_is_ours = rec->header.ply_count != count;
+    gamerec_apply(&rec->expected, &ply);
+}
+
+void gamerec_undo_move(GameRecorder *rec)
+{
+    if (!rec->active || !rec->last_is_ours) return;
+    rec->header.ply_count--;
+    rec->expected = rec->before_last;
+    rec->last_is_ours = 0;
+}
+
+void gamerec_finish(GameRecorder *rec, const EnginePosition *final_pos,
+                    int red_score, int blue_score)
+{
+    if (!rec->active) return;
+    if (final_pos && !(rec->header.flags & GAMEREC_INCOMPLETE) &&
+        !same_board(final_pos, &rec->expected)) {
+        record_opponent(rec, final_pos);
+    }
+    rec->header.red_score = (int16_t)red_score;
+    rec->header.blue_score = (int16_t)blue_score;
+    if (gamerec_append(rec->fd, &rec->header, rec->plies) != 0) {
+        fprintf(stderr, "[record] game record not fully written\n");
+    }
+    rec->active = 0;
+}
+
+void gamerec_close(GameRecorder *rec)
+{
+    if (rec->fd >= 0) close(rec->fd);
+    free(rec->plies);
+    memset(rec, 0, sizeof(*rec));
+    rec->fd = -1;
+}
+
+int gamerec_archive_open(GameArchive *archive, const char *path)
+{
+    archive->base = NULL;
+    archive->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+        archive->base = (const uint8_t *)p;
+        archive->size = (size_t)st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+void gamerec_archive_close(GameArchive *archive)
+{
+    if (archive->base) munmap((void *)archive->base, archive->size);
+    archive->base = NULL;
+    archive->size = 0;
+}
+
+// The game at 'offset' if a complete, well-formed one starts there. Its
+// plies are checked too: gamerec_apply() trusts their squares.
+static const GameRecordHeader *game_at(const GameArchive *archive, size_t offset)
+{
+    if (offset + sizeof(GameRecordHeader) > archive->size) return NULL;
+    const GameRecordHeader *game = (const GameRecordHeader *)(archive->base + offset);
+    if (game->magic != GAMEREC_MAGIC || game->version != GAMEREC_VERSION ||
+        game->header_size < sizeof(GameRecordHeader) || (game->header_size & 7) ||
+        !engine_supports(game->height, game->width)) {
+        return NULL;
+    }
+    size_t end = offset + game->header_size + (size_t)game->ply_count * sizeof(GamePly);
+    if (end > archive->size) return NULL;
+    const GamePly *plies = gamerec_plies(game);
+    const int squares = game->height * game->width;
+    for (uint32_t i = 0; i < game->ply_count; i++) {
+        if (plies[i].from != GAMEREC_PASS &&
+            (plies[i].from >= squares || plies[i].to >= squares)) {
+            return NULL;
+        }
+    }
+    return game;
+}
+
+const GameRecordHeader *gamerec_first(const GameArchive *archive)
+{
+    return game_at(archive, 0);
+}
+
+const GameRecordHeader *gamerec_next(const GameArchive *archive,
+                                     const GameRecordHeader *game)
+{
+    size_t offset = (size_t)((const uint8_t *)game - archive->base)
+                  + game->header_size + (size_t)game->ply_count * sizeof(GamePly);
+    return game_at(archive, offset);
+}
+
+void gamerec_cursor_start(GameCursor *cursor, const GameRecordHeader *game)
+{
+    cursor->game = game;
+    cursor->ply = 0;
+    memset(&cursor->pos, 0, sizeof(cursor->pos));
+    cursor->pos.height = game->height;
+    cursor->pos.width = game->width;
+    cursor->pos.to_move = (char)game->to_move;
+    memcpy(cursor->pos.red, game->red, sizeof(game->red));
+    memcpy(cursor->pos.blue, game->blue, sizeof(game->blue));
+    memcpy(cursor->pos.wall, game->wall, sizeof(game->wall));
+}
+
+int gamerec_cursor_step(GameCursor *cursor)
+{
+    if (cursor->ply >= cursor->game->ply_count) return 0;
+    gamerec_apply(&cursor->pos, &gamerec_plies(cursor->game)[cursor->ply]);
+    cursor->ply++;
+    return 1;
+}
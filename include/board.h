@@ -1,35 +1,91 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include <pthread.h>
+#include <stdint.h>
 #include "led-matrix-c.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Holds the RGB LED matrix, its canvas, and a font handle.
-struct LedPanelSettings {
+// A flip of the cells a move changes takes LED_FLIP_STEPS frames, the last
+// one the new board, each shown for LED_FLIP_FRACTION refreshes of the
+// panel (refreshed at LED_REFRESH_HZ): 6 × 8 / 200 Hz = 240 ms.
+#define LED_FLIP_STEPS     6
+#define LED_FLIP_FRACTION  8
+#define LED_REFRESH_HZ     200
+#define LED_FRAMES         (LED_FLIP_STEPS + 1)
+
+#define LED_CELL_UNKNOWN   0xff
+
+// A canvas and the colour of every cell as last drawn into it, so a frame
+// only repaints the cells that differ from it.
+struct LedFrame {
     struct LedCanvas *canvas;
+    unsigned char     cells[8][8];  // colour index, or LED_CELL_UNKNOWN
+    int               valid;        // grid lines drawn, cells filled in
+};
+
+// Holds the RGB LED matrix, its frames, and a font handle.
+struct LedPanelSettings {
     struct RGBLedMatrix *matrix;
     struct LedFont   *font;
     int               size;  // panel size (e.g., 64)
+
+    // The frame on the panel, and the others to render into: a flip is
+    // rendered into all of them first, then played back by swapping.
+    struct LedFrame   frames[LED_FRAMES];
+    int               front;
+
+    // Boards are drawn and animated on their own thread; draw_board() and
+    // led_clear() only leave it a request.
+    pthread_t         thread;
+    pthread_mutex_t   lock;
+    pthread_cond_t    wake;
+    char              request_board[8][8];
+    int               board_requested;
+    int               clear_requested;
+    int               stopping;
+    unsigned          request_id;   // of the latest draw_board()/led_clear()
+    unsigned          shown_id;     // the latest one on the panel, and when
+    int64_t           shown_us;     // it was swapped in
 };
 
-// Initialize a 64×64 RGB LED panel. Returns NULL on failure.
+// Start building the 64×64 panel on a background thread and return at once.
+// Does nothing if it is built or being built.
+void led_start(void);
+
+// The 64×64 RGB LED panel: waits for one led_start() began, or builds it
+// now. Built once per process; later calls return the same panel until
+// led_delete(). Returns NULL on failure (and keeps failing without retrying).
 struct LedPanelSettings *led_initialize(void);
 
-// Draw an 8×8 logical board onto the 64×64 panel in a single pass.
+// The panel's font, loaded on first use from $LED_FONT_FILE or
+// fonts/5x8.bdf. NULL without a panel or if the file cannot be loaded.
+struct LedFont *led_font(void);
+
+// Draw an 8×8 logical board onto the 64×64 panel.
 //   – Any pixel where (x%8 == 0) || (x%8 == 7) || (y%8 == 0) || (y%8 == 7)
-//     should be painted white (grid line).
+//     is white (grid line).
 //   – Otherwise, compute row = y/8, col = x/8, and pick color from board[row][col]:
 //       'R' → red, 'B' → blue, '#' → gray, else → black.
-// Finally, call swap_on_vsync(...) once to update the display.
-void draw_board(char board[8][8]);
+// Returns at once: the panel's thread flips the cells that changed since
+// the board on display, or draws the board outright when there is none,
+// repainting only the cells each frame lacks (6×6 pixels each).
+// Returns the request's number for led_board_shown(), or 0 without a panel.
+unsigned draw_board(char board[8][8]);
+
+// Whether request 'id' of draw_board(), or a later request that replaced
+// it, is on the panel; if so '*shown_us' is when it was swapped in, in
+// microseconds on the monotonic clock.
+int led_board_shown(unsigned id, int64_t *shown_us);
 
-// Clear the entire 64×64 panel to black (one clear + one swap).
+// Clear the entire 64×64 panel to black (on the panel's thread).
 void led_clear();
 
-// Free all resources (font, matrix, struct).
+// Free all resources (thread, font, matrix, struct); 'leds' becomes NULL
+// and the next led_initialize() builds a new panel.
 void led_delete();
 
 #ifdef __cplusplus
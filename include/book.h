@@ -0,0 +1,75 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opening book. A book file is a BookFileHeader followed by 'count'
+// BookEntry structs sorted by key, so it is memory-mapped and probed with
+// a binary search in place.
+//
+// Positions are keyed from the side to move's point of view (its pieces,
+// the opponent's, the walls) after turning the board into whichever of its
+// 8 rotations and reflections hashes lowest, so all symmetric variations
+// of an opening share one entry. The move is stored in that orientation
+// and turned back when probed.
+
+#define BOOK_MAGIC    0x4b42464fu   // "OFBK"
+#define BOOK_VERSION  1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t side;                  // square board the book is for
+    uint32_t count;                 // entries
+} BookFileHeader;
+
+typedef struct {
+    uint64_t key;                   // book_key() of the position
+    uint8_t  from, to;              // square r*side + c, canonical orientation
+    int16_t  score;                 // search score for the side to move
+    uint8_t  depth;                 // search depth
+    uint8_t  reserved[3];
+} BookEntry;
+
+typedef struct {
+    int              side;          // 0 when nothing is loaded
+    const BookEntry *entries;
+    uint32_t         count;
+    void            *map;
+    size_t           map_size;
+} Book;
+
+// Canonical key of 'pos'. '*symmetry' receives the transformation that
+// takes the board to the canonical orientation, for book_orient_move().
+uint64_t book_key(const EnginePosition *pos, int *symmetry);
+
+// Turn a move on 'pos' into the canonical orientation, or back from it
+// with 'inverse' set.
+void book_orient_move(EngineMove *move, int side, int symmetry, int inverse);
+
+// Map a book file read-only. Returns -1 if it can't be mapped or is
+// malformed.
+int book_open(Book *book, const char *path);
+void book_close(Book *book);
+
+// Look up 'pos'. Returns 1 with the book's move (checked to be playable on
+// 'pos'), score and depth, 0 if the position is not in the book.
+int book_probe(const Book *book, const EnginePosition *pos, EngineMove *move,
+               int *score, int *depth);
+
+// Sort 'entries' by key and write them as a book for boards of 'side'. Of
+// several entries for one position (met at different plies) one is kept.
+// Returns the number of entries written, -1 if the file can't be written.
+int book_save(const char *path, int side, BookEntry *entries, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOK_H
@@ -46,6 +46,39 @@ public:
 
   // Fill screen with given 24bpp color.
   virtual void Fill(uint8_t red, uint8_t green, uint8_t blue) = 0;
+
+  // -- Bulk operations. These default to one SetPixel() per pixel; the
+  // FrameCanvas and RGBMatrix write whole spans at once.
+
+  // Set "width" pixels of row "y", starting at column "x", from 8-bit
+  // red, green, blue triples "pixel_stride" bytes apart in "rgb" (3 for
+  // packed RGB, 4 to skip the fourth byte of RGBA/RGBX).
+  virtual void SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                         int pixel_stride = 3) {
+    for (int i = 0; i < width; ++i, rgb += pixel_stride) {
+      SetPixel(x + i, y, rgb[0], rgb[1], rgb[2]);
+    }
+  }
+
+  // Copy a "width" x "height" image, or part of a larger one, to (x,y):
+  // its rows are "row_stride" bytes apart, its pixels as in SetRGBRow().
+  virtual void SetRGBImage(int x, int y, int width, int height,
+                           const uint8_t *rgb, int row_stride,
+                           int pixel_stride = 3) {
+    for (int iy = 0; iy < height; ++iy, rgb += row_stride) {
+      SetRGBRow(x, y + iy, width, rgb, pixel_stride);
+    }
+  }
+
+  // Fill the rectangle of "width" x "height" pixels at (x,y).
+  virtual void FillRect(int x, int y, int width, int height,
+                        uint8_t red, uint8_t green, uint8_t blue) {
+    for (int iy = y; iy < y + height; ++iy) {
+      for (int ix = x; ix < x + width; ++ix) {
+        SetPixel(ix, iy, red, green, blue);
+      }
+    }
+  }
 };
 
 }  // namespace rgb_matrix
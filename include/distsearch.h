@@ -0,0 +1,49 @@
+#ifndef DISTSEARCH_H
+#define DISTSEARCH_H
+
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Search spread over worker processes on other machines (see worker.c),
+// each reached over TCP.
+//
+// The coordinator searches the first DIST_LOCAL_DEPTH plies itself for a
+// move order, then splits every deeper iteration by root move: the best
+// move so far is searched first with an open window, the others in
+// parallel with a null window at its score, and a move that beats that
+// score again with an open window. Every rise of the best score is
+// broadcast, so workers narrow the searches they are running. The jobs of
+// a worker that disconnects are dispatched again; a job running much longer
+// than the others is also given to an idle worker, and the first answer
+// wins.
+
+#define DIST_LOCAL_DEPTH  4
+
+typedef struct DistPool DistPool;
+
+// Connect to the workers in 'spec', "host:port[,host:port...]". Workers
+// that are down are retried every few seconds. Returns NULL if 'spec' is
+// malformed or lists more than 32 workers.
+DistPool *dist_open(const char *spec);
+
+void dist_close(DistPool *pool);
+
+// Workers currently connected.
+int dist_workers(const DistPool *pool);
+
+// engine_search() across the workers, with the same limits and result
+// (the PV is just the move). Searches locally while no worker is up.
+int dist_search(DistPool *pool, const EnginePosition *pos,
+                const EngineLimits *limits, EngineResult *result);
+
+// Forget what the workers and this process have learned, for benchmarks.
+void dist_clear(DistPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DISTSEARCH_H
@@ -0,0 +1,204 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Octaflip search engine. The core is specialized at compile time for each
+// supported board size; this interface picks the specialization at runtime
+// from the position's dimensions.
+
+// Square boards from ENGINE_MIN_SIDE to ENGINE_MAX_SIDE are supported.
+// Up to 8×8 a position fits one 64-bit word per colour, above that two.
+#define ENGINE_MIN_SIDE 4
+#define ENGINE_MAX_SIDE 11
+
+// A position. Square (r, c) is bit r*width + c, low word first.
+typedef struct {
+    int      height, width;
+    uint64_t red[2], blue[2], wall[2];
+    char     to_move;              // 'R' or 'B'
+} EnginePosition;
+
+// A move in 0-based board coordinates.
+typedef struct {
+    int from_row, from_col;
+    int to_row, to_col;
+} EngineMove;
+
+// Deepest iteration of a search.
+#define ENGINE_MAX_DEPTH 63
+
+typedef struct {
+    int       max_depth;           // plies; clamped to ENGINE_MAX_DEPTH
+    long long deadline_ms;         // get_time_ms() value to stop at, or
+                                   // LLONG_MAX for an untimed search
+    const int *cancel;             // optional; the search stops soon after
+                                   // another thread sets *cancel non-zero
+    unsigned long long max_nodes;  // stop after about this many nodes, or
+                                   // 0 for no limit
+    const EngineMove *exclude;     // optional root moves not to play, e.g.
+    int        exclude_count;      // ones the server rejected; a clone
+                                   // excludes every clone to its square
+} EngineLimits;
+
+// Longest principal variation reported in EngineResult.
+#define ENGINE_MAX_PV 16
+
+// Most root moves ranked in EngineResult.
+#define ENGINE_MAX_RANKED 16
+
+// Why a search returned.
+enum {
+    ENGINE_STOP_DEPTH = 0,         // reached limits->max_depth
+    ENGINE_STOP_TIME,              // reached limits->deadline_ms
+    ENGINE_STOP_ONLY_MOVE,         // a single legal move, nothing to search
+    ENGINE_STOP_EASY_MOVE,         // best move stable and clearly ahead
+    ENGINE_STOP_PROVEN,            // the game's outcome is decided
+    ENGINE_STOP_CANCELLED,         // *limits->cancel was set
+    ENGINE_STOP_NODES              // reached limits->max_nodes
+};
+
+typedef struct {
+    EngineMove         move;
+    int                score;      // piece difference for the side to move;
+                                   // ±ENGINE_SCORE_WIN added once proven
+    int                depth;      // last completed iteration
+    unsigned long long nodes;
+    int                stop_reason;
+    EngineMove         pv[ENGINE_MAX_PV];  // expected line, starting with move
+    int                pv_len;
+    // Root moves in the order of the last completed iteration, starting
+    // with move, for ordering a later search. Only the first score is
+    // exact; the others failed low and are upper bounds, so their order
+    // says nothing about which is second best. To play without move,
+    // search again with it in EngineLimits::exclude.
+    EngineMove         ranked[ENGINE_MAX_RANKED];
+    int                ranked_scores[ENGINE_MAX_RANKED];
+    int                ranked_len;
+} EngineResult;
+
+// Added to the final piece difference of a finished game, so that proven
+// wins and losses order before any heuristic score.
+#define ENGINE_SCORE_WIN 1000
+
+// Beyond any score: the open ends of a search window.
+#define ENGINE_SCORE_INF 10000
+
+// Milliseconds on the wall clock, the time base of EngineLimits.
+long long get_time_ms();
+
+// Map the search state (transposition table, history, PV) that persists
+// between searches. With a path it is kept in that file and reused by the
+// next run. Returns 0 on success, -1 if no memory could be mapped.
+int engine_state_open(const char *path);
+
+// Schedule write-back of a file-backed state.
+void engine_state_sync(void);
+
+// Forget everything learned so far.
+void engine_state_clear(void);
+
+// Start a new generation of table entries and fade the history. Call it
+// when the position searched moves on (before each of our moves, or a new
+// query); searches don't do it themselves. However many threads call it,
+// a generation lasts at least a second, so they may call it freely.
+void engine_state_next_search(void);
+
+void engine_state_close(void);
+
+// Whether a board of this size has a specialization.
+int engine_supports(int height, int width);
+
+// Allocate and touch the calling thread's search context for a board size
+// ahead of its first search on it. Returns 0 on success, -1 if unsupported
+// or out of memory.
+int engine_prepare(int height, int width);
+
+// Fill 'pos' from 'height' strings of 'width' cells ('R', 'B', '#', '.').
+// Returns 0 on success, -1 if the size is not supported.
+int engine_position_from_rows(EnginePosition *pos,
+                              const char *const *rows,
+                              int height, int width,
+                              char to_move);
+
+// The opening position: red in the top-left and bottom-right corners, blue
+// in the other two, red to move. Returns -1 if the size is not supported.
+int engine_start_position(EnginePosition *pos, int side);
+
+// Upper bound on the legal moves of any supported position.
+#define ENGINE_MAX_MOVES 512
+
+// List the legal moves of the side to move into 'moves' (room for
+// ENGINE_MAX_MOVES), clones once per destination square. Returns the count,
+// or -1 if the size is unsupported.
+int engine_legal_moves(const EnginePosition *pos, EngineMove *moves);
+
+// Play 'move' on 'pos', or pass if it is NULL, and hand the turn to the
+// other side. Returns 0 on success, -1 if the size is unsupported or the
+// move is not legal.
+int engine_play(EnginePosition *pos, const EngineMove *move);
+
+// Static evaluation of 'pos' for the side to move, as the search scores a
+// leaf: the pattern tables if loaded for this size, else the piece
+// difference. Returns 0 on success, -1 if the size is unsupported.
+int engine_evaluate(const EnginePosition *pos, int *score);
+
+// Search 'pos' within 'limits'. Returns 1 with the best move in 'result',
+// 0 if the side to move has no legal move (or all are excluded), -1 if the
+// size is unsupported.
+// Any number of threads may search at once; they share the persistent
+// state, and each uses a search context of its own.
+int engine_search(const EnginePosition *pos,
+                  const EngineLimits *limits,
+                  EngineResult *result);
+
+// Score 'pos' for the side to move by a 'depth'-ply search within the
+// window (alpha, beta). There is no iterative deepening; callers search
+// depth after depth themselves, and the table orders the moves. Fail-soft:
+// a score <= alpha is an upper bound, one >= beta a lower bound. Only
+// deadline_ms, cancel and max_nodes of 'limits' apply.
+// Returns 1 with '*score', 0 if stopped by 'limits' first, -1 if the size
+// is unsupported; '*nodes' counts the nodes searched either way.
+int engine_search_window(const EnginePosition *pos, int depth,
+                         int alpha, int beta, const EngineLimits *limits,
+                         int *score, unsigned long long *nodes);
+
+// Evaluate leaves with the pattern tables in 'path' (see eval.h) on boards
+// of the size they were fitted for; other sizes keep the piece count. Call
+// before searching. Returns 0 on success, -1 if the file is unusable.
+int engine_eval_open(const char *path);
+
+void engine_eval_close(void);
+
+// Leaf evaluators, for engine_eval_rate().
+enum {
+    ENGINE_EVAL_MATERIAL = 0,      // piece count
+    ENGINE_EVAL_PATTERNS,          // pattern tables, updated incrementally
+    ENGINE_EVAL_PATTERNS_FULL      // pattern tables, computed from scratch
+};
+
+// Evaluations per second on the children of 'pos', for benchmarks. 0 if the
+// evaluator is not available for this board size.
+double engine_eval_rate(const EnginePosition *pos, int evaluator);
+
+// Search functions, for engine_search_rate().
+enum {
+    ENGINE_SEARCH_NODE_TYPES = 0,  // the engine's, specialized by node type
+    ENGINE_SEARCH_PLAIN            // one alpha-beta function for all nodes
+};
+
+// Nodes per second of a search of 'pos' deepened to 'depth' plies from an
+// empty table, for benchmarks; '*nodes' gets the nodes searched. Clears the
+// persistent state. 0 if the size is unsupported.
+double engine_search_rate(const EnginePosition *pos, int depth, int search,
+                          unsigned long long *nodes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENGINE_H
@@ -0,0 +1,150 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pattern-table evaluation: the weight file format, the pattern layout and
+// a reference feature extractor shared by the engine and the fitter.
+//
+// A position is scored from one player's point of view as the sum of
+//   - a table entry for each of the 4 corner regions (3×3 squares) and the
+//     4 edges, indexed by the region's squares in base 3 (0 empty or wall,
+//     1 ours, 2 theirs);
+//   - linear terms for the piece, mobility and frontier differences;
+// with separate weights for EVAL_PHASES stages of the game. The regions
+// map onto each other by symmetries of the board, so each kind shares one
+// table. Weights are in 1/EVAL_SCALE pieces.
+
+#define EVAL_MAGIC    0x5645464fu   // "OFEV"
+#define EVAL_VERSION  1
+
+#define EVAL_PHASES        4        // by the share of empty squares left
+#define EVAL_SCALE         64
+#define EVAL_CORNER_CELLS  9
+#define EVAL_CORNERS       4
+#define EVAL_EDGES         4
+#define EVAL_INSTANCES     (EVAL_CORNERS + EVAL_EDGES)   // eval_sum() assumes 4 + 4
+#define EVAL_CORNER_SIZE   19683    // 3^9
+
+// Scores are clamped to ±EVAL_SCORE_LIMIT pieces, well clear of the
+// engine's proven results (ENGINE_SCORE_WIN).
+#define EVAL_SCORE_LIMIT   400
+
+enum {
+    EVAL_MATERIAL = 0,              // our pieces minus theirs
+    EVAL_MOBILITY,                  // squares we can move to minus theirs
+    EVAL_FRONTIER,                  // our pieces next to an empty square
+                                    // minus theirs
+    EVAL_LINEAR
+};
+
+// File layout: this header, then int16_t corner[phases][corner_size],
+// int16_t edge[phases][edge_size] and int16_t linear[phases][linear_size].
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t side;                  // square board the weights are for
+    uint32_t phases;
+    uint32_t corner_size;
+    uint32_t edge_size;             // 3^side
+    uint32_t linear_size;
+    uint32_t reserved;
+} EvalFileHeader;
+
+typedef struct {
+    int            side;            // 0 when nothing is loaded
+    const int16_t *corner;          // [EVAL_PHASES][EVAL_CORNER_SIZE]
+    const int16_t *edge;            // [EVAL_PHASES][edge_size]
+    const int16_t *linear;          // [EVAL_PHASES][EVAL_LINEAR]
+    uint32_t       edge_size;
+    void          *map;
+    size_t         map_size;
+} EvalWeights;
+
+// Size of a weight file for boards of 'side' squares.
+size_t eval_file_size(int side);
+
+// Map a weight file read-only. Returns -1 if it can't be mapped or its
+// header doesn't match the layout above.
+int eval_weights_open(EvalWeights *weights, const char *path);
+void eval_weights_close(EvalWeights *weights);
+
+// Write a weight file from tables laid out as in EvalWeights.
+int eval_weights_save(const char *path, int side, const int16_t *corner,
+                      const int16_t *edge, const int16_t *linear);
+
+/*
+ * Which squares make up each region on a board of 'side' squares: regions
+ * 0..3 are the corners, 4..7 the edges. Square 'square[i][k]' is base-3
+ * digit k of region i's index. 'member' lists, per square, the regions it
+ * is part of and the value of its digit there, so an index can be updated
+ * from just the squares a move changes.
+ */
+#define EVAL_MAX_MEMBERSHIPS 8
+
+typedef struct {
+    uint8_t  instance;
+    uint32_t weight;                // 3^digit
+} EvalMembership;
+
+typedef struct {
+    int            side;
+    int            cells[EVAL_INSTANCES];
+    uint8_t        square[EVAL_INSTANCES][ENGINE_MAX_SIDE];
+    int            member_count[ENGINE_MAX_SIDE * ENGINE_MAX_SIDE];
+    EvalMembership member[ENGINE_MAX_SIDE * ENGINE_MAX_SIDE][EVAL_MAX_MEMBERSHIPS];
+} EvalPatterns;
+
+void eval_patterns_init(EvalPatterns *patterns, int side);
+
+// Game stage of a position with 'empty' empty squares out of 'squares'.
+static inline int eval_phase(int empty, int squares)
+{
+    return empty * EVAL_PHASES / (squares + 1);
+}
+
+typedef struct {
+    int      phase;
+    uint32_t index[EVAL_INSTANCES];
+    int      linear[EVAL_LINEAR];
+} EvalFeatures;
+
+// Features of 'pos' from the point of view of 'perspective' ('R' or 'B').
+// Straightforward and slow; the engine has its own incremental version.
+void eval_features(const EvalPatterns *patterns, const EnginePosition *pos,
+                   char perspective, EvalFeatures *features);
+
+// Weighted sum of a phase's tables and linear terms, in pieces, clamped.
+static inline int eval_sum(const EvalWeights *weights, int phase,
+                           const uint32_t index[EVAL_INSTANCES],
+                           const int linear_terms[EVAL_LINEAR])
+{
+    const int16_t *corner = weights->corner + phase * EVAL_CORNER_SIZE;
+    const int16_t *edge = weights->edge + phase * weights->edge_size;
+    const int16_t *linear = weights->linear + phase * EVAL_LINEAR;
+    int sum = corner[index[0]] + corner[index[1]] + corner[index[2]] + corner[index[3]]
+            + edge[index[4]] + edge[index[5]] + edge[index[6]] + edge[index[7]];
+    for (int i = 0; i < EVAL_LINEAR; i++) sum += linear[i] * linear_terms[i];
+    sum /= EVAL_SCALE;
+    return sum > EVAL_SCORE_LIMIT ? EVAL_SCORE_LIMIT
+         : sum < -EVAL_SCORE_LIMIT ? -EVAL_SCORE_LIMIT : sum;
+}
+
+// Score of a feature set in pieces, from the same point of view.
+static inline int eval_score(const EvalWeights *weights,
+                             const EvalFeatures *features)
+{
+    return eval_sum(weights, features->phase, features->index, features->linear);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVAL_H
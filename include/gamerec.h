@@ -0,0 +1,148 @@
+#ifndef GAMEREC_H
+#define GAMEREC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary game records. An archive is a file of games appended one after
+// another; each game is a GameRecordHeader followed by 'ply_count'
+// GamePly structs. Everything is fixed-size and 8-byte aligned, so a
+// memory-mapped archive is read in place without any parsing.
+
+#define GAMEREC_MAGIC    0x5247464fu   // "OFGR"
+#define GAMEREC_VERSION  1
+
+#define GAMEREC_PASS     0xFF          // GamePly::from/to of a pass
+#define GAMEREC_NO_EVAL  INT16_MIN     // GamePly::eval when not searched
+
+// GameRecordHeader::flags
+#define GAMEREC_INCOMPLETE 1           // plies stop before the end of the game
+#define GAMEREC_SELF_PLAY  2           // both sides played by the engine
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;              // sizeof(GameRecordHeader)
+    uint32_t ply_count;
+    uint8_t  height, width;
+    uint8_t  to_move;                  // 'R' or 'B' in the start position
+    uint8_t  our_color;                // side the recording client played
+    int16_t  red_score, blue_score;    // as reported by game_over
+    uint16_t flags;
+    uint16_t reserved;
+    int64_t  start_time;               // seconds since the epoch
+    uint64_t red[2], blue[2], wall[2]; // start position, as in EnginePosition
+} GameRecordHeader;
+
+typedef struct {
+    uint8_t  from, to;                 // square r*width + c, or GAMEREC_PASS
+    uint16_t time_ms;                  // thinking time, saturated at 65535
+    int16_t  eval;                     // mover's search score or GAMEREC_NO_EVAL
+    uint8_t  depth;                    // search depth, 0 if not searched
+    uint8_t  reserved;
+} GamePly;
+
+// A header for a game starting at 'start', with no plies yet.
+void gamerec_header_init(GameRecordHeader *header, const EnginePosition *start,
+                         char our_color);
+
+// Fill 'ply' from a move ('move' NULL is a pass) on a board 'width' wide.
+void gamerec_make_ply(GamePly *ply, const EngineMove *move, int width,
+                      int time_ms, int eval, int depth);
+
+// Append a finished game to an archive opened with O_APPEND, in a single
+// write. Returns 0 on success, -1 if it was not fully written.
+int gamerec_append(int fd, const GameRecordHeader *header, const GamePly *plies);
+
+/*
+ * Recording. The client only sees the board when it is about to move, so
+ * the opponent's plies are inferred by comparing that board with the one
+ * expected after our own last move. The game is appended to the archive
+ * with a single write once it is over.
+ */
+typedef struct {
+    int              fd;               // -1 when not recording
+    int              active;           // a game is in progress
+    GameRecordHeader header;
+    EnginePosition   expected;         // position after the last ply
+    EnginePosition   before_last;      // position before our last ply
+    int              last_is_ours;     // the top of 'plies' is our last ply
+    long long        last_ply_ms;
+    GamePly         *plies;
+    uint32_t         capacity;
+} GameRecorder;
+
+// Start appending to 'path'; with NULL the recorder does nothing. Returns
+// -1 if the file can't be opened.
+int gamerec_open(GameRecorder *rec, const char *path);
+
+// The board as the server sent it. Starts a game on the first call and
+// records the opponent's ply (or pass) on later ones.
+void gamerec_observe(GameRecorder *rec, const EnginePosition *pos,
+                     char our_color);
+
+// Record our own ply; 'move' NULL is a pass.
+void gamerec_record_move(GameRecorder *rec, const EngineMove *move,
+                         int time_ms, int eval, int depth);
+
+// Withdraw our last ply, which the server rejected. Does nothing if that
+// ply never made it into the record.
+void gamerec_undo_move(GameRecorder *rec);
+
+// Append the game to the archive and get ready for the next one. If
+// 'final_pos' is given and differs from our last move's result, the
+// opponent's closing ply is inferred from it first.
+void gamerec_finish(GameRecorder *rec, const EnginePosition *final_pos,
+                    int red_score, int blue_score);
+
+void gamerec_close(GameRecorder *rec);
+
+/*
+ * Reading. Games are visited in file order with gamerec_first() and
+ * gamerec_next(); a GameCursor replays one game's positions.
+ */
+typedef struct {
+    const uint8_t *base;
+    size_t         size;
+} GameArchive;
+
+// Map an archive read-only. Returns -1 if it can't be opened or mapped.
+int gamerec_archive_open(GameArchive *archive, const char *path);
+void gamerec_archive_close(GameArchive *archive);
+
+// First game, or NULL if there is none. A truncated or foreign tail, or a
+// ply off the board, ends the iteration.
+const GameRecordHeader *gamerec_first(const GameArchive *archive);
+const GameRecordHeader *gamerec_next(const GameArchive *archive,
+                                     const GameRecordHeader *game);
+
+static inline const GamePly *gamerec_plies(const GameRecordHeader *game)
+{
+    return (const GamePly *)((const uint8_t *)game + game->header_size);
+}
+
+typedef struct {
+    const GameRecordHeader *game;
+    EnginePosition          pos;       // position before ply 'ply'
+    uint32_t                ply;
+} GameCursor;
+
+void gamerec_cursor_start(GameCursor *cursor, const GameRecordHeader *game);
+
+// Play the next ply. Returns 0, leaving the position alone, once every ply
+// has been played.
+int gamerec_cursor_step(GameCursor *cursor);
+
+// Apply a ply to a position in place; the side to move changes.
+void gamerec_apply(EnginePosition *pos, const GamePly *ply);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GAMEREC_H
@@ -0,0 +1,110 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Where the time of a turn goes, from reading your_turn off the socket to
+// sending our move. Each stage is stamped on the monotonic clock; a turn's
+// breakdown is the time between consecutive stages, kept in histograms
+// shared by every game and session of the process.
+
+// Stages in the order a turn passes them. One that a turn skips (no panel,
+// a book move without a search) takes the time of the stage before it.
+enum {
+    LATENCY_RECV = 0,              // your_turn read from the socket
+    LATENCY_PARSED,                // JSON parsed, board rows copied
+    LATENCY_DRAW_SUBMITTED,        // board handed to the LED panel
+    LATENCY_BOARD,                 // bitboards built
+    LATENCY_SEARCH_START,
+    LATENCY_SEARCH_END,
+    LATENCY_SENT,                  // move written to the socket
+    LATENCY_STAGES
+};
+
+// Intervals reported: one per pair of consecutive stages, then the whole
+// turn, the part of it not spent searching, and the time from handing the
+// board to the panel until its thread swapped it in (alongside the rest of
+// the turn, on that thread; only for turns that drew).
+enum {
+    LATENCY_TOTAL = LATENCY_STAGES - 1,
+    LATENCY_OVERHEAD,
+    LATENCY_DRAW,
+    LATENCY_INTERVALS
+};
+
+// Log-linear buckets of microseconds: exact below 64, then 64 per power
+// of two (within 1.6%), up to 2^36 µs (19 hours).
+#define LATENCY_SUB_BITS     6
+#define LATENCY_SUB_BUCKETS  (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS      ((37 - LATENCY_SUB_BITS) * LATENCY_SUB_BUCKETS)
+
+// The stamps of one turn.
+typedef struct {
+    int64_t  stamp[LATENCY_STAGES];
+    int      stamped[LATENCY_STAGES];
+    int64_t  shown_us;             // the panel showed the board; 0 until then
+    int      active;               // a turn is being timed
+    int      retry;                // it answers invalid_move
+    // An ended turn whose board the panel has not shown yet waits here.
+    int      pending;
+    int64_t  us[LATENCY_INTERVALS];
+    const char *session;
+    int      number;
+} LatencyTurn;
+
+// Histograms of every turn so far; any thread may add to them.
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t count[LATENCY_INTERVALS][LATENCY_BUCKETS];
+    uint64_t samples[LATENCY_INTERVALS];
+    uint64_t turns;
+    int      games;
+    FILE    *metrics;              // NULL without a metrics file
+} TurnLatency;
+
+// Microseconds on the monotonic clock.
+int64_t latency_now_us(void);
+
+// Start collecting; with a path, per-turn breakdowns and the percentiles at
+// every game_over are appended to that file, one JSON object per line.
+// Returns 0 on success, -1 if the file cannot be opened (the histograms
+// are still kept).
+int latency_open(TurnLatency *lat, const char *metrics_path);
+
+// Begin a turn whose message was read at 'recv_us' and parsed at
+// 'parsed_us'. A previous turn still waiting for its board to be shown is
+// recorded without the draw.
+void latency_begin_turn(TurnLatency *lat, LatencyTurn *turn, int64_t recv_us,
+                        int64_t parsed_us, int retry);
+
+// Stamp a stage of the turn now. Does nothing between turns.
+void latency_mark(LatencyTurn *turn, int stage);
+
+// Close the turn, number 'number' of the game 'session' plays: add it to
+// the histograms, log its breakdown and append it to the metrics file. If
+// it handed a board to the panel that is not shown yet, that waits for
+// latency_draw_shown().
+void latency_end_turn(TurnLatency *lat, LatencyTurn *turn,
+                      const char *session, int number);
+
+// The panel swapped in the turn's board at 'shown_us'. Records the turn if
+// it ended already.
+void latency_draw_shown(TurnLatency *lat, LatencyTurn *turn, int64_t shown_us);
+
+// Log p50/p95/p99 of every interval over all turns so far, and append them
+// to the metrics file. Call at game_over.
+void latency_report(TurnLatency *lat);
+
+void latency_close(TurnLatency *lat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_H
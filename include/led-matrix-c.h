@@ -158,6 +158,14 @@ struct RGBLedMatrixOptions {
    * processes when waiting and renders single core boards more responsive.
    */
   bool disable_busy_waiting;     /* Corresponding flag: --led-busy-waiting */
+
+  /* Palette mode: the colours the application draws with. The matrix then
+   * shows only as many bitplanes as these colours need (the top ones, with
+   * their usual timings) instead of pwm_bits. Read once when the matrix is
+   * created.
+   */
+  const struct Color *palette;
+  int palette_size;
 };
 
 /**
@@ -333,6 +341,28 @@ void led_canvas_clear(struct LedCanvas *canvas);
 /** Fill matrix with given color. */
 void led_canvas_fill(struct LedCanvas *canvas, uint8_t r, uint8_t g, uint8_t b);
 
+/**
+ * Set "width" pixels of row y, starting at column x, from 8-bit r, g, b
+ * triples "pixel_stride" bytes apart in "rgb" (3 for packed RGB, 4 for
+ * RGBA/RGBX). Pixels outside the canvas are skipped.
+ * Much faster than led_canvas_set_pixel() for each pixel.
+ */
+void led_canvas_set_rgb_row(struct LedCanvas *canvas, int x, int y, int width,
+                            const uint8_t *rgb, int pixel_stride);
+
+/**
+ * Copy a "width" x "height" image, or part of a larger one, to (x, y): its
+ * rows are "row_stride" bytes apart, its pixels as in led_canvas_set_rgb_row().
+ */
+void led_canvas_set_rgb_image(struct LedCanvas *canvas, int x, int y,
+                              int width, int height, const uint8_t *rgb,
+                              int row_stride, int pixel_stride);
+
+/** Fill the rectangle of "width" x "height" pixels at (x, y) with a color. */
+void led_canvas_fill_rect(struct LedCanvas *canvas, int x, int y,
+                          int width, int height,
+                          uint8_t r, uint8_t g, uint8_t b);
+
 /*** API to provide double-buffering. ***/
 
 /**
@@ -356,6 +386,15 @@ struct LedCanvas *led_matrix_create_offscreen_canvas(struct RGBLedMatrix *matrix
 struct LedCanvas *led_matrix_swap_on_vsync(struct RGBLedMatrix *matrix,
                                            struct LedCanvas *canvas);
 
+/**
+ * Like led_matrix_swap_on_vsync(), but swaps on the next refresh that is a
+ * multiple of "framerate_fraction": an animation played with it runs at an
+ * exact fraction of the refresh rate (see RGBMatrix::SwapOnVSync()).
+ */
+struct LedCanvas *led_matrix_swap_on_vsync_fraction(
+  struct RGBLedMatrix *matrix, struct LedCanvas *canvas,
+  unsigned framerate_fraction);
+
 uint8_t led_matrix_get_brightness(struct RGBLedMatrix *matrix);
 void led_matrix_set_brightness(struct RGBLedMatrix *matrix, uint8_t brightness);
 
@@ -159,6 +159,18 @@ public:
     // Sleep instead of busy wait to free CPU cycles but get slightly less
     // accurate frame timing.
     bool disable_busy_waiting;   // Flag: --led-busy-waiting
+
+    // Palette mode, for displays that only draw with a few flat colours.
+    // Given the "palette_size" colours of "palette", the matrix uses the
+    // fewest bitplanes that still show each of them within 2% of its
+    // brightness instead of pwm_bits, like pwm_bits the top ones with their
+    // usual timings: fewer planes are clocked out, so refresh is faster and
+    // takes less CPU. Other colours are rounded to those planes. Dithering
+    // is off and SetPWMBits() can't change the planes.
+    // The palette is read once, when the matrix is created, at the
+    // initial brightness. Default: NULL, 0 (no palette).
+    const Color *palette;
+    int palette_size;
   };
 
   // Factory to create a matrix. Additional functionality includes dropping
@@ -203,6 +215,13 @@ public:
                         uint8_t red, uint8_t green, uint8_t blue);
   virtual void Clear();
   virtual void Fill(uint8_t red, uint8_t green, uint8_t blue);
+  virtual void SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                         int pixel_stride = 3);
+  virtual void SetRGBImage(int x, int y, int width, int height,
+                           const uint8_t *rgb, int row_stride,
+                           int pixel_stride = 3);
+  virtual void FillRect(int x, int y, int width, int height,
+                        uint8_t red, uint8_t green, uint8_t blue);
 
   // -- Double- and Multibuffering.
 
@@ -386,6 +405,16 @@ public:
                          Color *colors);
   virtual void Clear();
   virtual void Fill(uint8_t red, uint8_t green, uint8_t blue);
+  // The bulk operations convert whole runs of a row to bitplanes at once, a
+  // lot faster than a SetPixel() for each pixel. Pixels outside the canvas
+  // are skipped.
+  virtual void SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                         int pixel_stride = 3);
+  virtual void SetRGBImage(int x, int y, int width, int height,
+                           const uint8_t *rgb, int row_stride,
+                           int pixel_stride = 3);
+  virtual void FillRect(int x, int y, int width, int height,
+                        uint8_t red, uint8_t green, uint8_t blue);
 
 private:
   friend class RGBMatrix;
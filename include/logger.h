@@ -0,0 +1,59 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous logging. Records are formatted into a lock-free ring buffer
+// and written out by a background thread, so a slow terminal or log file
+// never stalls the caller. When the ring is full the record is dropped and
+// counted instead of waiting.
+
+enum LogLevel {
+    LOG_ERROR = 0,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+    LOG_LEVELS
+};
+
+// Records above this level are discarded before any formatting.
+extern int log_level;
+
+// Start the writer thread. Records go to 'path' (appended) or to stdout if
+// 'path' is NULL. Returns 0 on success, -1 if the file can't be opened or
+// the thread can't be started; logging then stays synchronous on stdout.
+int log_open(const char *path, int level);
+
+// Write out everything still queued, report drops and stop the writer.
+void log_close(void);
+
+// Parse "error", "warn", "info" or "debug". Returns -1 if unknown.
+int log_level_from_name(const char *name);
+
+// Queue one line (no trailing newline needed). Longer lines are truncated.
+void log_write(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Queue 'len' bytes of 'text' as one line without any formatting. Lines
+// longer than a record take several; beyond 8000 bytes they are cut, and
+// counted by log_dropped().
+void log_write_raw(int level, const char *text, size_t len);
+
+// Records dropped so far because the ring was full, and raw lines cut.
+unsigned long long log_dropped(int level);
+
+#define LOG(level, ...) \
+    do { if ((level) <= log_level) log_write((level), __VA_ARGS__); } while (0)
+
+#define LOG_RAW(level, text, len) \
+    do { if ((level) <= log_level) log_write_raw((level), (text), (len)); } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOGGER_H
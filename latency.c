@@ -0,0 +1,187 @@
+// latency.c
+#include "latency.h"
+
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+
+static const char *const interval_names[LATENCY_INTERVALS] = {
+    "parse", "draw_submit", "board", "prepare", "search", "send",
+    "total", "overhead", "draw"
+};
+
+int64_t latency_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int bucket_of(int64_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS) return us < 0 ? 0 : (int)us;
+    int e = 63 - __builtin_clzll((unsigned long long)us);
+    int index = (e - LATENCY_SUB_BITS) * LATENCY_SUB_BUCKETS +
+                (int)(us >> (e - LATENCY_SUB_BITS));
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+// Middle of a bucket, in microseconds.
+static double bucket_value(int index)
+{
+    if (index < LATENCY_SUB_BUCKETS) return index;
+    int shift = index / LATENCY_SUB_BUCKETS - 1;
+    int sub = index % LATENCY_SUB_BUCKETS;
+    double width = (double)(1LL << shift);
+    return (LATENCY_SUB_BUCKETS + sub) * width + width / 2;
+}
+
+// The 'p'-th percentile of an interval's histogram, in microseconds.
+static double percentile(const TurnLatency *lat, int interval, double p)
+{
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)lat->samples[interval] + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += lat->count[interval][i];
+        if (seen >= rank) return bucket_value(i);
+    }
+    return 0;
+}
+
+int latency_open(TurnLatency *lat, const char *metrics_path)
+{
+    memset(lat, 0, sizeof(*lat));
+    pthread_mutex_init(&lat->lock, NULL);
+    if (!metrics_path) return 0;
+    lat->metrics = fopen(metrics_path, "a");
+    return lat->metrics ? 0 : -1;
+}
+
+// Add an ended turn to the histograms, log it and write its metrics line.
+static void record_turn(TurnLatency *lat, LatencyTurn *turn)
+{
+    const int64_t *us = turn->us;
+    const int drew = turn->stamped[LATENCY_DRAW_SUBMITTED] && turn->shown_us;
+    turn->pending = 0;
+    pthread_mutex_lock(&lat->lock);
+    for (int i = 0; i < LATENCY_INTERVALS; i++) {
+        if (i == LATENCY_DRAW && !drew) continue;
+        lat->count[i][bucket_of(us[i])]++;
+        lat->samples[i]++;
+    }
+    lat->turns++;
+    if (lat->metrics) {
+        fprintf(lat->metrics, "{\"type\":\"turn\",\"session\":\"%s\",\"turn\":%d,\"retry\":%s",
+                turn->session, turn->number, turn->retry ? "true" : "false");
+        for (int i = 0; i < LATENCY_INTERVALS; i++) {
+            if (i == LATENCY_DRAW && !drew) continue;
+            fprintf(lat->metrics, ",\"%s_us\":%lld", interval_names[i], (long long)us[i]);
+        }
+        fputs("}\n", lat->metrics);
+        fflush(lat->metrics);
+    }
+    pthread_mutex_unlock(&lat->lock);
+
+    LOG(LOG_INFO, "[latency] %s turn %d%s: %.3f ms, %.3f searching, %.3f overhead "
+        "(parse %.3f, draw submit %.3f, board %.3f, prepare %.3f, send %.3f; "
+        "shown after %.3f)",
+        turn->session, turn->number, turn->retry ? " (retry)" : "",
+        us[LATENCY_TOTAL] / 1000.0,
+        (us[LATENCY_TOTAL] - us[LATENCY_OVERHEAD]) / 1000.0,
+        us[LATENCY_OVERHEAD] / 1000.0, us[0] / 1000.0, us[1] / 1000.0,
+        us[2] / 1000.0, us[3] / 1000.0, us[5] / 1000.0,
+        drew ? us[LATENCY_DRAW] / 1000.0 : 0.0);
+}
+
+void latency_begin_turn(TurnLatency *lat, LatencyTurn *turn, int64_t recv_us,
+                        int64_t parsed_us, int retry)
+{
+    if (turn->pending) record_turn(lat, turn);
+    memset(turn->stamped, 0, sizeof(turn->stamped));
+    turn->stamp[LATENCY_RECV] = recv_us;
+    turn->stamp[LATENCY_PARSED] = parsed_us;
+    turn->stamped[LATENCY_RECV] = turn->stamped[LATENCY_PARSED] = 1;
+    turn->shown_us = 0;
+    turn->retry = retry;
+    turn->active = 1;
+}
+
+void latency_mark(LatencyTurn *turn, int stage)
+{
+    if (!turn->active) return;
+    turn->stamp[stage] = latency_now_us();
+    turn->stamped[stage] = 1;
+}
+
+void latency_end_turn(TurnLatency *lat, LatencyTurn *turn,
+                      const char *session, int number)
+{
+    if (!turn->active) return;
+    if (!turn->stamped[LATENCY_SENT]) latency_mark(turn, LATENCY_SENT);
+    turn->active = 0;
+
+    int64_t *us = turn->us;
+    for (int s = 1; s < LATENCY_STAGES; s++) {
+        if (!turn->stamped[s]) turn->stamp[s] = turn->stamp[s - 1];
+        us[s - 1] = turn->stamp[s] - turn->stamp[s - 1];
+    }
+    us[LATENCY_TOTAL] = turn->stamp[LATENCY_SENT] - turn->stamp[LATENCY_RECV];
+    us[LATENCY_OVERHEAD] = us[LATENCY_TOTAL] -
+                           (turn->stamp[LATENCY_SEARCH_END] -
+                            turn->stamp[LATENCY_SEARCH_START]);
+    turn->session = session;
+    turn->number = number;
+    turn->pending = 1;
+    if (!turn->stamped[LATENCY_DRAW_SUBMITTED]) {
+        record_turn(lat, turn);
+    } else if (turn->shown_us) {
+        latency_draw_shown(lat, turn, turn->shown_us);
+    }
+}
+
+void latency_draw_shown(TurnLatency *lat, LatencyTurn *turn, int64_t shown_us)
+{
+    turn->shown_us = shown_us;
+    if (!turn->pending) return;
+    turn->us[LATENCY_DRAW] = shown_us - turn->stamp[LATENCY_DRAW_SUBMITTED];
+    record_turn(lat, turn);
+}
+
+void latency_report(TurnLatency *lat)
+{
+    pthread_mutex_lock(&lat->lock);
+    lat->games++;
+    if (lat->turns == 0) {
+        pthread_mutex_unlock(&lat->lock);
+        return;
+    }
+    LOG(LOG_INFO, "[latency] %llu turns over %d games, p50/p95/p99 in ms:",
+        (unsigned long long)lat->turns, lat->games);
+    for (int i = 0; i < LATENCY_INTERVALS; i++) {
+        if (!lat->samples[i]) continue;
+        LOG(LOG_INFO, "[latency]   %-11s %9.3f %9.3f %9.3f", interval_names[i],
+            percentile(lat, i, 50) / 1000.0, percentile(lat, i, 95) / 1000.0,
+            percentile(lat, i, 99) / 1000.0);
+    }
+    if (lat->metrics) {
+        fprintf(lat->metrics, "{\"type\":\"summary\",\"games\":%d,\"turns\":%llu",
+                lat->games, (unsigned long long)lat->turns);
+        for (int i = 0; i < LATENCY_INTERVALS; i++) {
+            if (!lat->samples[i]) continue;
+            fprintf(lat->metrics, ",\"%s_us\":[%.0f,%.0f,%.0f]", interval_names[i],
+                    percentile(lat, i, 50), percentile(lat, i, 95),
+                    percentile(lat, i, 99));
+        }
+        fputs("}\n", lat->metrics);
+        fflush(lat->metrics);
+    }
+    pthread_mutex_unlock(&lat->lock);
+}
+
+void latency_close(TurnLatency *lat)
+{
+    if (lat->metrics) fclose(lat->metrics);
+    lat->metrics = NULL;
+    pthread_mutex_destroy(&lat->lock);
+}
@@ -105,6 +105,19 @@ public:
   bool SetPWMBits(uint8_t value);
   uint8_t pwmbits() { return pwm_bits_; }
 
+  // Palette mode. Returns the fewest bitplanes that show each of the
+  // "count" colours within kPaletteTolerance of full brightness (and keep
+  // them apart), at the given luminance correction and brightness.
+  static int PaletteBitPlanes(const Color *palette, int count,
+                              bool luminance_correct, uint8_t brightness);
+  static constexpr float kPaletteTolerance = 0.02;
+
+  // Show only the top "planes" bitplanes, with colours rounded to them.
+  // The planes keep their full-depth timings, so a row is lit as long as
+  // with all of them. Fixes pwm-bits to "planes".
+  void SetPaletteBitPlanes(int planes);
+  int palette_bit_planes() const { return palette_bit_planes_; }
+
   // Map brightness of output linearly to input with CIE1931 profile.
   void set_luminance_correct(bool on) { do_luminance_correct_ = on; }
   bool luminance_correct() const { return do_luminance_correct_; }
@@ -128,6 +141,16 @@ public:
   int height() const;
   void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue);
   void SetPixels(int x, int y, int width, int height, Color *colors);
+  // Set "width" pixels of row "y" from x on, from 8-bit RGB triples
+  // "pixel_stride" bytes apart. Writes the bitplanes of runs of pixels at
+  // once.
+  void SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                 int pixel_stride);
+  // The same for "height" rows, "row_stride" bytes apart.
+  void SetRGBImage(int x, int y, int width, int height, const uint8_t *rgb,
+                   int row_stride, int pixel_stride);
+  void FillRect(int x, int y, int width, int height,
+                uint8_t red, uint8_t green, uint8_t blue);
   void Clear();
   void Fill(uint8_t red, uint8_t green, uint8_t blue);
 
@@ -146,6 +169,13 @@ private:
                              PixelDesignator *designator);
   inline void  MapColors(uint8_t r, uint8_t g, uint8_t b,
                          uint16_t *red, uint16_t *green, uint16_t *blue);
+  // Recompute color_lookup_ if brightness, luminance correction or palette
+  // mode changed since.
+  void UpdateColorLookup();
+  // Write "count" mapped pixels, run by run, to where "designator" says.
+  void WriteMappedRow(const PixelDesignator *designator, int count,
+                      const uint16_t *red, const uint16_t *green,
+                      const uint16_t *blue);
   const int rows_;     // Number of rows. 16 or 32.
   const int parallel_; // Parallel rows of chains. 1 or 2.
   const int height_;   // rows * parallel
@@ -155,9 +185,15 @@ private:
   const bool inverse_color_;
 
   uint8_t pwm_bits_;   // PWM bits to display.
+  int palette_bit_planes_;  // 0 unless in palette mode.
   bool do_luminance_correct_;
   uint8_t brightness_;
 
+  // MapColors() of every 8-bit value (the same for all three channels),
+  // for bulk writes; valid for the settings encoded in color_lookup_key_.
+  uint16_t color_lookup_[256];
+  int color_lookup_key_;
+
   const int double_rows_;
   const size_t buffer_size_;
 
@@ -28,6 +28,15 @@
 #include <string.h>
 
 #include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#endif
 
 #include "gpio.h"
 #include "../include/graphics.h"
@@ -331,7 +340,9 @@ Framebuffer::Framebuffer(int rows, int columns, int parallel,
     columns_(columns),
     scan_mode_(scan_mode),
     inverse_color_(inverse_color),
-    pwm_bits_(kBitPlanes), do_luminance_correct_(true), brightness_(100),
+    pwm_bits_(kBitPlanes), palette_bit_planes_(0),
+    do_luminance_correct_(true), brightness_(100),
+    color_lookup_key_(-1),
     double_rows_(rows / SUB_PANELS_),
     buffer_size_(double_rows_ * columns_ * kBitPlanes * sizeof(gpio_bits_t)),
     shared_mapper_(mapper) {
@@ -611,10 +622,18 @@ static void InitFM6127(GPIO *io, const struct HardwareMapping &h, int columns) {
 bool Framebuffer::SetPWMBits(uint8_t value) {
   if (value < 1 || value > kBitPlanes)
     return false;
+  if (palette_bit_planes_ && value != palette_bit_planes_)
+    return false;  // Colours are rounded to the palette's planes.
   pwm_bits_ = value;
   return true;
 }
 
+void Framebuffer::SetPaletteBitPlanes(int planes) {
+  if (planes < 0 || planes > kBitPlanes) return;
+  palette_bit_planes_ = planes;
+  if (planes) pwm_bits_ = planes;
+}
+
 inline gpio_bits_t *Framebuffer::ValueAt(int double_row, int column, int bit) {
   return &bitplane_buffer_[ double_row * (columns_ * kBitPlanes)
                             + bit * columns_
@@ -665,6 +684,56 @@ static inline uint16_t DirectMapColor(uint8_t brightness, uint8_t c) {
   return (shift > 0) ? (c << shift) : (c >> -shift);
 }
 
+// Round a full-depth value to the top "planes" bitplanes. Those planes keep
+// their usual timings, so they give q / (2^planes - 1) of full brightness.
+static inline uint16_t QuantizeToPlanes(uint16_t v, int planes) {
+  constexpr int kFull = (1 << internal::Framebuffer::kBitPlanes) - 1;
+  const int levels = (1 << planes) - 1;
+  const int q = (v * levels + kFull / 2) / kFull;
+  return q << (internal::Framebuffer::kBitPlanes - planes);
+}
+
+/*static*/ int Framebuffer::PaletteBitPlanes(const Color *palette, int count,
+                                             bool luminance_correct,
+                                             uint8_t brightness) {
+  if (palette == NULL || count <= 0) return kBitPlanes;
+  if (brightness < 1) brightness = 1;
+  if (brightness > 100) brightness = 100;
+  std::vector<uint16_t> values;  // Three channels per colour.
+  for (int i = 0; i < count; ++i) {
+    const uint8_t c[3] = { palette[i].r, palette[i].g, palette[i].b };
+    for (int ch = 0; ch < 3; ++ch) {
+      values.push_back(luminance_correct
+                       ? CIEMapColor(brightness, c[ch])
+                       : DirectMapColor(brightness, c[ch]));
+    }
+  }
+  constexpr float kFull = (1 << kBitPlanes) - 1;
+  for (int planes = 1; planes < kBitPlanes; ++planes) {
+    const float levels = (1 << planes) - 1;
+    bool good = true;
+    for (size_t i = 0; good && i < values.size(); ++i) {
+      const uint16_t q = QuantizeToPlanes(values[i], planes);
+      const float shown = (q >> (kBitPlanes - planes)) / levels;
+      good = fabsf(shown - values[i] / kFull) <= kPaletteTolerance;
+    }
+    // Colours that differ must not collapse into one.
+    for (size_t a = 0; good && a < values.size(); a += 3) {
+      for (size_t b = a + 3; good && b < values.size(); b += 3) {
+        bool differ = false, differ_shown = false;
+        for (int ch = 0; ch < 3; ++ch) {
+          differ |= values[a + ch] != values[b + ch];
+          differ_shown |= QuantizeToPlanes(values[a + ch], planes)
+            != QuantizeToPlanes(values[b + ch], planes);
+        }
+        good = !differ || differ_shown;
+      }
+    }
+    if (good) return planes;
+  }
+  return kBitPlanes;
+}
+
 inline void Framebuffer::MapColors(
   uint8_t r, uint8_t g, uint8_t b,
   uint16_t *red, uint16_t *green, uint16_t *blue) {
@@ -679,6 +748,12 @@ inline void Framebuffer::MapColors(
     *blue  = DirectMapColor(brightness_, b);
   }
 
+  if (palette_bit_planes_) {
+    *red   = QuantizeToPlanes(*red, palette_bit_planes_);
+    *green = QuantizeToPlanes(*green, palette_bit_planes_);
+    *blue  = QuantizeToPlanes(*blue, palette_bit_planes_);
+  }
+
   if (inverse_color_) {
     *red = ~(*red);
     *green = ~(*green);
@@ -737,13 +812,251 @@ void Framebuffer::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void Framebuffer::SetPixels(int x, int y, int width, int height, Color *colors) {
+  static_assert(sizeof(Color) == 3, "Color must be packed RGB");
   for (int iy = 0; iy < height; ++iy) {
-    for (int ix = 0; ix < width; ++ix) {
-      SetPixel(x + ix, y + iy, colors->r, colors->g, colors->b);
-      ++colors;
+    SetRGBRow(x, y + iy, width, reinterpret_cast<const uint8_t*>(colors),
+              sizeof(Color));
+    colors += width;
+  }
+}
+
+void Framebuffer::UpdateColorLookup() {
+  const int key = brightness_ | (do_luminance_correct_ << 7)
+    | (palette_bit_planes_ << 8);
+  if (key == color_lookup_key_) return;
+  for (int c = 0; c < 256; ++c) {
+    uint16_t red, green, blue;
+    MapColors(c, c, c, &red, &green, &blue);
+    color_lookup_[c] = red;
+  }
+  color_lookup_key_ = key;
+}
+
+// Bulk writes: SetPixel() for a run of pixels that sit in consecutive
+// columns and share their colour bits (a row of a panel, unless a pixel
+// mapper rotates or mirrors it). Each plane's words for a group of pixels
+// are built at once, transposing their colour values into bitplanes: the
+// plane's bit of every pixel is shifted up to the sign bit and spread into a
+// lane mask that selects that pixel's r/g/b gpio bit.
+//
+// "bits" is the first pixel's word in plane 0; planes are "columns" apart.
+static void WriteBitplaneRun(gpio_bits_t *bits, int columns, int min_plane,
+                             const uint16_t *red, const uint16_t *green,
+                             const uint16_t *blue, int count,
+                             const PixelDesignator &d) {
+  constexpr int kPlanes = Framebuffer::kBitPlanes;
+  int i = 0;
+#if !defined(ENABLE_WIDE_GPIO_COMPUTE_MODULE)
+#if defined(__AVX2__)
+  const __m256i r_bit = _mm256_set1_epi32(d.r_bit);
+  const __m256i g_bit = _mm256_set1_epi32(d.g_bit);
+  const __m256i b_bit = _mm256_set1_epi32(d.b_bit);
+  const __m256i keep = _mm256_set1_epi32(d.mask);
+  for (; i + 8 <= count; i += 8) {
+    const __m256i r = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(red + i)));
+    const __m256i g = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(green + i)));
+    const __m256i b = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(blue + i)));
+    for (int plane = min_plane; plane < kPlanes; ++plane) {
+      const __m128i up = _mm_cvtsi32_si128(31 - plane);
+      __m256i color = _mm256_and_si256(
+        _mm256_srai_epi32(_mm256_sll_epi32(r, up), 31), r_bit);
+      color = _mm256_or_si256(color, _mm256_and_si256(
+        _mm256_srai_epi32(_mm256_sll_epi32(g, up), 31), g_bit));
+      color = _mm256_or_si256(color, _mm256_and_si256(
+        _mm256_srai_epi32(_mm256_sll_epi32(b, up), 31), b_bit));
+      __m256i *word = reinterpret_cast<__m256i*>(bits + plane * columns + i);
+      _mm256_storeu_si256(word, _mm256_or_si256(
+        _mm256_and_si256(_mm256_loadu_si256(word), keep), color));
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i r_bit = _mm_set1_epi32(d.r_bit);
+  const __m128i g_bit = _mm_set1_epi32(d.g_bit);
+  const __m128i b_bit = _mm_set1_epi32(d.b_bit);
+  const __m128i keep = _mm_set1_epi32(d.mask);
+  for (; i + 4 <= count; i += 4) {
+    const __m128i r = _mm_unpacklo_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(red + i)), zero);
+    const __m128i g = _mm_unpacklo_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(green + i)), zero);
+    const __m128i b = _mm_unpacklo_epi16(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(blue + i)), zero);
+    for (int plane = min_plane; plane < kPlanes; ++plane) {
+      const __m128i up = _mm_cvtsi32_si128(31 - plane);
+      __m128i color = _mm_and_si128(
+        _mm_srai_epi32(_mm_sll_epi32(r, up), 31), r_bit);
+      color = _mm_or_si128(color, _mm_and_si128(
+        _mm_srai_epi32(_mm_sll_epi32(g, up), 31), g_bit));
+      color = _mm_or_si128(color, _mm_and_si128(
+        _mm_srai_epi32(_mm_sll_epi32(b, up), 31), b_bit));
+      __m128i *word = reinterpret_cast<__m128i*>(bits + plane * columns + i);
+      _mm_storeu_si128(word, _mm_or_si128(
+        _mm_and_si128(_mm_loadu_si128(word), keep), color));
+    }
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const uint32x4_t r_bit = vdupq_n_u32(d.r_bit);
+  const uint32x4_t g_bit = vdupq_n_u32(d.g_bit);
+  const uint32x4_t b_bit = vdupq_n_u32(d.b_bit);
+  const uint32x4_t keep = vdupq_n_u32(d.mask);
+  for (; i + 4 <= count; i += 4) {
+    const uint32x4_t r = vmovl_u16(vld1_u16(red + i));
+    const uint32x4_t g = vmovl_u16(vld1_u16(green + i));
+    const uint32x4_t b = vmovl_u16(vld1_u16(blue + i));
+    for (int plane = min_plane; plane < kPlanes; ++plane) {
+      const int32x4_t up = vdupq_n_s32(31 - plane);
+      uint32x4_t color = vandq_u32(vreinterpretq_u32_s32(vshrq_n_s32(
+        vreinterpretq_s32_u32(vshlq_u32(r, up)), 31)), r_bit);
+      color = vorrq_u32(color, vandq_u32(vreinterpretq_u32_s32(vshrq_n_s32(
+        vreinterpretq_s32_u32(vshlq_u32(g, up)), 31)), g_bit));
+      color = vorrq_u32(color, vandq_u32(vreinterpretq_u32_s32(vshrq_n_s32(
+        vreinterpretq_s32_u32(vshlq_u32(b, up)), 31)), b_bit));
+      uint32_t *word = bits + plane * columns + i;
+      vst1q_u32(word, vorrq_u32(vandq_u32(vld1q_u32(word), keep), color));
+    }
+  }
+#endif
+#endif  // !ENABLE_WIDE_GPIO_COMPUTE_MODULE
+  // Scalar fallback, and the pixels left over.
+  for (; i < count; ++i) {
+    gpio_bits_t *word = bits + min_plane * columns + i;
+    for (int plane = min_plane; plane < kPlanes; ++plane, word += columns) {
+      const gpio_bits_t color_bits =
+        (-(gpio_bits_t)((red[i] >> plane) & 1) & d.r_bit)
+        | (-(gpio_bits_t)((green[i] >> plane) & 1) & d.g_bit)
+        | (-(gpio_bits_t)((blue[i] >> plane) & 1) & d.b_bit);
+      *word = (*word & d.mask) | color_bits;
+    }
+  }
+}
+
+// A run of pixels of one colour: each plane's bits are the same for all.
+static void FillBitplaneRun(gpio_bits_t *bits, int columns, int min_plane,
+                            uint16_t red, uint16_t green, uint16_t blue,
+                            int count, const PixelDesignator &d) {
+  for (int plane = min_plane; plane < Framebuffer::kBitPlanes; ++plane) {
+    const gpio_bits_t color_bits =
+      (-(gpio_bits_t)((red >> plane) & 1) & d.r_bit)
+      | (-(gpio_bits_t)((green >> plane) & 1) & d.g_bit)
+      | (-(gpio_bits_t)((blue >> plane) & 1) & d.b_bit);
+    gpio_bits_t *word = bits + plane * columns;
+    for (int i = 0; i < count; ++i) {
+      word[i] = (word[i] & d.mask) | color_bits;
+    }
+  }
+}
+
+// Whether "next" continues the run "d" starts, "offset" pixels on.
+static inline bool ContinuesRun(const PixelDesignator &d,
+                                const PixelDesignator &next, int offset) {
+  return next.gpio_word == d.gpio_word + offset
+    && next.r_bit == d.r_bit && next.g_bit == d.g_bit
+    && next.b_bit == d.b_bit && next.mask == d.mask;
+}
+
+// Pixels are mapped in chunks, so their values stay in cache for the planes.
+static constexpr int kRowChunk = 64;
+
+void Framebuffer::WriteMappedRow(const PixelDesignator *designator, int count,
+                                 const uint16_t *red, const uint16_t *green,
+                                 const uint16_t *blue) {
+  const int min_bit_plane = kBitPlanes - pwm_bits_;
+  for (int i = 0; i < count; /**/) {
+    const PixelDesignator &d = designator[i];
+    if (d.gpio_word < 0) {  // non-used pixel marker.
+      ++i;
+      continue;
     }
+    int run = 1;
+    while (i + run < count && ContinuesRun(d, designator[i + run], run))
+      ++run;
+    WriteBitplaneRun(bitplane_buffer_ + d.gpio_word, columns_, min_bit_plane,
+                     red + i, green + i, blue + i, run, d);
+    i += run;
+  }
+}
+
+// Clip the span of "width" pixels at x, y to the canvas. Returns the number
+// of pixels left of x that were cut off, or -1 if nothing is left.
+static int ClipSpan(const PixelDesignatorMap *mapper, int *x, int y,
+                    int *width) {
+  if (y < 0 || y >= mapper->height()) return -1;
+  int skipped = 0;
+  if (*x < 0) {
+    skipped = -*x;
+    *width += *x;
+    *x = 0;
   }
+  *width = std::min(*width, mapper->width() - *x);
+  return *width > 0 ? skipped : -1;
 }
+
+void Framebuffer::SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                            int pixel_stride) {
+  PixelDesignatorMap *const mapper = *shared_mapper_;
+  const int skipped = ClipSpan(mapper, &x, y, &width);
+  if (skipped < 0) return;
+  rgb += skipped * pixel_stride;
+
+  UpdateColorLookup();
+  const PixelDesignator *designator = mapper->get(x, y);
+  uint16_t red[kRowChunk], green[kRowChunk], blue[kRowChunk];
+  while (width > 0) {
+    const int n = std::min(width, kRowChunk);
+    for (int i = 0; i < n; ++i, rgb += pixel_stride) {
+      red[i]   = color_lookup_[rgb[0]];
+      green[i] = color_lookup_[rgb[1]];
+      blue[i]  = color_lookup_[rgb[2]];
+    }
+    WriteMappedRow(designator, n, red, green, blue);
+    designator += n;
+    width -= n;
+  }
+}
+
+void Framebuffer::SetRGBImage(int x, int y, int width, int height,
+                              const uint8_t *rgb, int row_stride,
+                              int pixel_stride) {
+  for (int iy = 0; iy < height; ++iy, rgb += row_stride) {
+    SetRGBRow(x, y + iy, width, rgb, pixel_stride);
+  }
+}
+
+void Framebuffer::FillRect(int x, int y, int width, int height,
+                           uint8_t r, uint8_t g, uint8_t b) {
+  PixelDesignatorMap *const mapper = *shared_mapper_;
+  if (y < 0) {
+    height += y;
+    y = 0;
+  }
+  height = std::min(height, mapper->height() - y);
+  if (height <= 0 || ClipSpan(mapper, &x, y, &width) < 0) return;
+
+  uint16_t red, green, blue;
+  MapColors(r, g, b, &red, &green, &blue);
+  const int min_bit_plane = kBitPlanes - pwm_bits_;
+  for (int iy = y; iy < y + height; ++iy) {
+    const PixelDesignator *designator = mapper->get(x, iy);
+    for (int i = 0; i < width; /**/) {
+      const PixelDesignator &d = designator[i];
+      if (d.gpio_word < 0) {  // non-used pixel marker.
+        ++i;
+        continue;
+      }
+      int run = 1;
+      while (i + run < width && ContinuesRun(d, designator[i + run], run))
+        ++run;
+      FillBitplaneRun(bitplane_buffer_ + d.gpio_word, columns_, min_bit_plane,
+                      red, green, blue, run, d);
+      i += run;
+    }
+  }
+}
+
 // Strange LED-mappings such as RBG or so are handled here.
 gpio_bits_t Framebuffer::GetGpioFromLedSequence(char col,
                                                 const char *led_sequence,
@@ -48,31 +48,30 @@ bool SetImage(Canvas *c, int canvas_offset_x, int canvas_offset_y,
   const int w = std::min(c->width(), canvas_offset_x + image_display_w);
   const int h = std::min(c->height(), canvas_offset_y + image_display_h);
 
-  // Bytes to skip for wider than canvas image at the end of a row
-  const size_t skip_end_row = (canvas_offset_x + image_display_w > w)
-    ? (canvas_offset_x + image_display_w - w) * 3
-    : 0;
-
-  // Let's make this a combined skip per row and ajust where we start.
-  const size_t next_row_skip = skip_start_row + skip_end_row;
   buffer += skip_start_row;
 
+  const int span = w - canvas_offset_x;
+  if (span <= 0 || h <= canvas_offset_y) return true;
+  const int row_stride = 3 * width;  // Rows of the whole image.
   if (is_bgr) {
-    for (int y = canvas_offset_y; y < h; ++y) {
-      for (int x = canvas_offset_x; x < w; ++x) {
-        c->SetPixel(x, y, buffer[2], buffer[1], buffer[0]);
-        buffer += 3;
+    // Swapped into RGB a chunk of each row at a time, on the stack.
+    static const int kChunk = 64;
+    uint8_t rgb[3 * kChunk];
+    for (int y = canvas_offset_y; y < h; ++y, buffer += row_stride) {
+      for (int done = 0; done < span; done += kChunk) {
+        const uint8_t *from = buffer + 3 * done;
+        const int n = std::min(kChunk, span - done);
+        for (int x = 0; x < n; ++x) {
+          rgb[3*x + 0] = from[3*x + 2];
+          rgb[3*x + 1] = from[3*x + 1];
+          rgb[3*x + 2] = from[3*x + 0];
+        }
+        c->SetRGBRow(canvas_offset_x + done, y, n, rgb);
       }
-      buffer += next_row_skip;
     }
   } else {
-    for (int y = canvas_offset_y; y < h; ++y) {
-      for (int x = canvas_offset_x; x < w; ++x) {
-        c->SetPixel(x, y, buffer[0], buffer[1], buffer[2]);
-        buffer += 3;
-      }
-      buffer += next_row_skip;
-    }
+    c->SetRGBImage(canvas_offset_x, canvas_offset_y, span, h - canvas_offset_y,
+                   buffer, row_stride);
   }
   return true;
 }
@@ -89,7 +89,12 @@ static struct RGBLedMatrix *led_matrix_create_from_options_optional_edit(
     OPT_COPY_IF_SET(panel_type);
     OPT_COPY_IF_SET(limit_refresh_rate_hz);
     OPT_COPY_IF_SET(disable_busy_waiting);
+    OPT_COPY_IF_SET(palette_size);
 #undef OPT_COPY_IF_SET
+    if (opts->palette) {
+      default_opts.palette
+        = reinterpret_cast<const rgb_matrix::Color*>(opts->palette);
+    }
   }
 
   if (rt_opts) {
@@ -136,7 +141,9 @@ static struct RGBLedMatrix *led_matrix_create_from_options_optional_edit(
     ACTUAL_VALUE_BACK_TO_OPT(panel_type);
     ACTUAL_VALUE_BACK_TO_OPT(limit_refresh_rate_hz);
     ACTUAL_VALUE_BACK_TO_OPT(disable_busy_waiting);
+    ACTUAL_VALUE_BACK_TO_OPT(palette_size);
 #undef ACTUAL_VALUE_BACK_TO_OPT
+    opts->palette = reinterpret_cast<const struct Color*>(matrix_options.palette);
   }
 
   if (rt_opts) {
@@ -207,6 +214,13 @@ struct LedCanvas *led_matrix_swap_on_vsync(struct RGBLedMatrix *matrix,
   return from_canvas(to_matrix(matrix)->SwapOnVSync(to_canvas(canvas)));
 }
 
+struct LedCanvas *led_matrix_swap_on_vsync_fraction(
+  struct RGBLedMatrix *matrix, struct LedCanvas *canvas,
+  unsigned framerate_fraction) {
+  return from_canvas(to_matrix(matrix)->SwapOnVSync(to_canvas(canvas),
+                                                    framerate_fraction));
+}
+
 void led_matrix_set_brightness(struct RGBLedMatrix *matrix,
                                uint8_t brightness) {
   to_matrix(matrix)->SetBrightness(brightness);
@@ -242,6 +256,24 @@ void led_canvas_fill(struct LedCanvas *canvas, uint8_t r, uint8_t g, uint8_t b)
   to_canvas(canvas)->Fill(r, g, b);
 }
 
+void led_canvas_set_rgb_row(struct LedCanvas *canvas, int x, int y, int width,
+                            const uint8_t *rgb, int pixel_stride) {
+  to_canvas(canvas)->SetRGBRow(x, y, width, rgb, pixel_stride);
+}
+
+void led_canvas_set_rgb_image(struct LedCanvas *canvas, int x, int y,
+                              int width, int height, const uint8_t *rgb,
+                              int row_stride, int pixel_stride) {
+  to_canvas(canvas)->SetRGBImage(x, y, width, height, rgb, row_stride,
+                                 pixel_stride);
+}
+
+void led_canvas_fill_rect(struct LedCanvas *canvas, int x, int y,
+                          int width, int height,
+                          uint8_t r, uint8_t g, uint8_t b) {
+  to_canvas(canvas)->FillRect(x, y, width, height, r, g, b);
+}
+
 struct LedFont *load_font(const char *bdf_font_file) {
   rgb_matrix::Font* font = new rgb_matrix::Font();
   font->LoadFont(bdf_font_file);
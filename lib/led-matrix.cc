@@ -102,6 +102,7 @@ private:
                               int chain, int parallel);
 
   Options params_;
+  int palette_bit_planes_;  // 0 unless in palette mode.
   bool do_luminance_correct_;
 
   FrameCanvas *active_;
@@ -325,10 +326,11 @@ RGBMatrix::Options::Options() :
   limit_refresh_rate_hz(0),
 #endif
 #ifdef DISABLE_BUSY_WAITING
-    disable_busy_waiting(true)
+    disable_busy_waiting(true),
 #else
-    disable_busy_waiting(false)
+    disable_busy_waiting(false),
 #endif
+  palette(NULL), palette_size(0)
 {
   // Nothing to see here.
 }
@@ -360,6 +362,7 @@ static void PrintOptions(const RGBMatrix::Options &o) {
   P_STR(panel_type);
   P_INT(limit_refresh_rate_hz);
   P_BOOL(disable_busy_waiting);
+  P_INT(palette_size);
 #undef P_INT
 #undef P_STR
 #undef P_BOOL
@@ -367,7 +370,8 @@ static void PrintOptions(const RGBMatrix::Options &o) {
 #endif  // DEBUG_MATRIX_OPTIONS
 
 RGBMatrix::Impl::Impl(GPIO *io, const Options &options)
-  : params_(options), io_(NULL), updater_(NULL), shared_pixel_mapper_(NULL),
+  : params_(options), palette_bit_planes_(0),
+    io_(NULL), updater_(NULL), shared_pixel_mapper_(NULL),
     user_output_bits_(0) {
   assert(params_.Validate(NULL));
 #if DEBUG_MATRIX_OPTIONS
@@ -390,6 +394,16 @@ RGBMatrix::Impl::Impl(GPIO *io, const Options &options)
 
   Framebuffer::InitHardwareMapping(params_.hardware_mapping);
 
+  if (params_.palette_size > 0) {
+    // Frames start with luminance correction on.
+    palette_bit_planes_ = Framebuffer::PaletteBitPlanes(params_.palette,
+                                                        params_.palette_size,
+                                                        true,
+                                                        params_.brightness);
+    params_.pwm_bits = palette_bit_planes_;
+    params_.pwm_dither_bits = 0;
+  }
+
   active_ = CreateFrameCanvas();
   active_->Clear();
   SetGPIO(io, true);
@@ -509,6 +523,7 @@ FrameCanvas *RGBMatrix::Impl::CreateFrameCanvas() {
     do_luminance_correct_ = result->framebuffer()->luminance_correct();
   }
 
+  result->framebuffer()->SetPaletteBitPlanes(palette_bit_planes_);
   result->framebuffer()->SetPWMBits(params_.pwm_bits);
   result->framebuffer()->set_luminance_correct(do_luminance_correct_);
   result->framebuffer()->SetBrightness(params_.brightness);
@@ -771,6 +786,23 @@ void RGBMatrix::Fill(uint8_t red, uint8_t green, uint8_t blue) {
   impl_->active_->Fill(red, green, blue);
 }
 
+void RGBMatrix::SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                          int pixel_stride) {
+  impl_->active_->SetRGBRow(x, y, width, rgb, pixel_stride);
+}
+
+void RGBMatrix::SetRGBImage(int x, int y, int width, int height,
+                            const uint8_t *rgb, int row_stride,
+                            int pixel_stride) {
+  impl_->active_->SetRGBImage(x, y, width, height, rgb, row_stride,
+                              pixel_stride);
+}
+
+void RGBMatrix::FillRect(int x, int y, int width, int height,
+                         uint8_t red, uint8_t green, uint8_t blue) {
+  impl_->active_->FillRect(x, y, width, height, red, green, blue);
+}
+
 // FrameCanvas implementation of Canvas
 FrameCanvas::~FrameCanvas() { delete frame_; }
 int FrameCanvas::width() const { return frame_->width(); }
@@ -783,6 +815,19 @@ void FrameCanvas::SetPixels(int x, int y, int width, int height,
                          Color *colors) {
   frame_->SetPixels(x, y, width, height, colors);
 }
+void FrameCanvas::SetRGBRow(int x, int y, int width, const uint8_t *rgb,
+                            int pixel_stride) {
+  frame_->SetRGBRow(x, y, width, rgb, pixel_stride);
+}
+void FrameCanvas::SetRGBImage(int x, int y, int width, int height,
+                              const uint8_t *rgb, int row_stride,
+                              int pixel_stride) {
+  frame_->SetRGBImage(x, y, width, height, rgb, row_stride, pixel_stride);
+}
+void FrameCanvas::FillRect(int x, int y, int width, int height,
+                           uint8_t red, uint8_t green, uint8_t blue) {
+  frame_->FillRect(x, y, width, height, red, green, blue);
+}
 void FrameCanvas::Clear() { return frame_->Clear(); }
 void FrameCanvas::Fill(uint8_t red, uint8_t green, uint8_t blue) {
   frame_->Fill(red, green, blue);
@@ -467,6 +467,11 @@ bool RGBMatrix::Options::Validate(std::string *err_in) const {
     success = false;
   }
 
+  if (palette_size < 0 || (palette_size > 0 && palette == NULL)) {
+    err->append("Palette needs palette_size colors.\n");
+    success = false;
+  }
+
   if (led_rgb_sequence == NULL || strlen(led_rgb_sequence) != 3) {
     err->append("led-sequence needs to be three characters long.\n");
     success = false;
@@ -0,0 +1,235 @@
+// logger.c
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+
+#define LOG_SLOTS     1024          // power of two
+#define LOG_TEXT_MAX  500           // bytes of text per slot
+#define LOG_RAW_SLOTS 16            // most slots one raw record may take
+#define LOG_IDLE_NS   2000000L      // writer sleep when the ring is empty
+
+/*
+ * Bounded multi-producer, single-consumer ring. Each slot carries a
+ * sequence number: a producer may fill slot 'pos' when seq == pos and
+ * publishes it with seq = pos + 1; the writer frees it for the next lap
+ * with seq = pos + LOG_SLOTS. Producers never wait on the writer. A raw
+ * record too long for one slot takes several consecutive ones, all but the
+ * last marked 'more', and the writer joins them into one line.
+ */
+typedef struct {
+    uint32_t seq;
+    uint8_t  level;
+    uint8_t  more;                     // the line goes on in the next slot
+    uint16_t len;
+    char     text[LOG_TEXT_MAX];
+} LogSlot;
+
+int log_level = LOG_DEBUG;
+
+static LogSlot *log_ring;
+static uint32_t log_enqueue_pos;
+static uint32_t log_dequeue_pos;       // writer thread only
+static unsigned long long log_drops[LOG_LEVELS];
+static int log_fd = -1;
+static int log_stop;
+static pthread_t log_thread;
+
+static const char *const log_level_names[LOG_LEVELS] = {
+    "error", "warn", "info", "debug"
+};
+
+int log_level_from_name(const char *name)
+{
+    for (int i = 0; i < LOG_LEVELS; i++) {
+        if (strcmp(name, log_level_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Reserve 'count' consecutive slots and return the first, or NULL (and
+// count a drop) if the ring is short of them. The writer frees slots in
+// order, so once the last one is free the others are too.
+static LogSlot *log_reserve(int level, uint32_t count, uint32_t *pos_out)
+{
+    uint32_t pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        uint32_t last = pos + count - 1;
+        uint32_t seq = __atomic_load_n(&log_ring[last & (LOG_SLOTS - 1)].seq,
+                                       __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - last);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&log_enqueue_pos, &pos, pos + count, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos_out = pos;
+                return &log_ring[pos & (LOG_SLOTS - 1)];
+            }
+        } else if (diff < 0) {
+            __atomic_add_fetch(&log_drops[level], 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void log_publish(LogSlot *slot, uint32_t pos)
+{
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+void log_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    if (!log_ring) {
+        vprintf(fmt, ap);
+        putchar('\n');
+        va_end(ap);
+        return;
+    }
+    uint32_t pos;
+    LogSlot *slot = log_reserve(level, 1, &pos);
+    if (slot) {
+        int n = vsnprintf(slot->text, LOG_TEXT_MAX, fmt, ap);
+        if (n < 0) n = 0;
+        slot->len = (uint16_t)((n < LOG_TEXT_MAX) ? n : LOG_TEXT_MAX - 1);
+        slot->level = (uint8_t)level;
+        slot->more = 0;
+        log_publish(slot, pos);
+    }
+    va_end(ap);
+}
+
+void log_write_raw(int level, const char *text, size_t len)
+{
+    if (!log_ring) {
+        fwrite(text, 1, len, stdout);
+        putchar('\n');
+        return;
+    }
+    if (len > LOG_RAW_SLOTS * LOG_TEXT_MAX) {
+        // Cut, and counted like a drop so that it doesn't go unnoticed.
+        len = LOG_RAW_SLOTS * LOG_TEXT_MAX;
+        __atomic_add_fetch(&log_drops[level], 1, __ATOMIC_RELAXED);
+    }
+    uint32_t count = len ? (uint32_t)((len + LOG_TEXT_MAX - 1) / LOG_TEXT_MAX) : 1;
+    uint32_t pos;
+    if (!log_reserve(level, count, &pos)) return;
+    for (uint32_t i = 0; i < count; i++) {
+        LogSlot *slot = &log_ring[(pos + i) & (LOG_SLOTS - 1)];
+        size_t n = (len < LOG_TEXT_MAX) ? len : LOG_TEXT_MAX;
+        memcpy(slot->text, text, n);
+        text += n;
+        len -= n;
+        slot->len = (uint16_t)n;
+        slot->level = (uint8_t)level;
+        slot->more = i + 1 < count;
+        log_publish(slot, pos + i);
+    }
+}
+
+unsigned long long log_dropped(int level)
+{
+    return __atomic_load_n(&log_drops[level], __ATOMIC_RELAXED);
+}
+
+static void log_write_all(const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(log_fd, buf, len);
+        if (n <= 0) return;
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// Move every published record into one buffer and write it with a single
+// system call. Returns the number of records written.
+static int log_drain(void)
+{
+    static char out[64 * 1024];
+    size_t used = 0;
+    int count = 0;
+    for (;;) {
+        LogSlot *slot = &log_ring[log_dequeue_pos & (LOG_SLOTS - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != log_dequeue_pos + 1) break;
+        if (used + slot->len + 1 > sizeof(out)) {
+            log_write_all(out, used);
+            used = 0;
+        }
+        memcpy(out + used, slot->text, slot->len);
+        used += slot->len;
+        if (!slot->more) out[used++] = '\n';
+        __atomic_store_n(&slot->seq, log_dequeue_pos + LOG_SLOTS, __ATOMIC_RELEASE);
+        log_dequeue_pos++;
+        count++;
+    }
+    if (used) log_write_all(out, used);
+    return count;
+}
+
+static void *log_writer(void *arg)
+{
+    (void)arg;
+    struct timespec idle = { 0, LOG_IDLE_NS };
+    while (!__atomic_load_n(&log_stop, __ATOMIC_ACQUIRE)) {
+        if (log_drain() == 0) nanosleep(&idle, NULL);
+    }
+    log_drain();
+    return NULL;
+}
+
+int log_open(const char *path, int level)
+{
+    if (level >= 0 && level < LOG_LEVELS) log_level = level;
+    if (log_ring) return 0;
+
+    fflush(stdout);
+    log_fd = path ? open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)
+                  : STDOUT_FILENO;
+    if (log_fd < 0) {
+        fprintf(stderr, "[log] cannot open %s\n", path);
+        return -1;
+    }
+    LogSlot *ring = (LogSlot *)calloc(LOG_SLOTS, sizeof(LogSlot));
+    if (!ring) return -1;
+    for (uint32_t i = 0; i < LOG_SLOTS; i++) ring[i].seq = i;
+    log_enqueue_pos = 0;
+    log_dequeue_pos = 0;
+    log_stop = 0;
+    log_ring = ring;
+    if (pthread_create(&log_thread, NULL, log_writer, NULL) != 0) {
+        log_ring = NULL;
+        free(ring);
+        return -1;
+    }
+    return 0;
+}
+
+void log_close(void)
+{
+    if (!log_ring) return;
+    __atomic_store_n(&log_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(log_thread, NULL);
+
+    LogSlot *ring = log_ring;
+    log_ring = NULL;
+    for (int i = 0; i < LOG_LEVELS; i++) {
+        if (log_drops[i]) {
+            fprintf(stderr, "[log] dropped %llu %s records\n",
+                    log_drops[i], log_level_names[i]);
+        }
+    }
+    if (log_fd != STDOUT_FILENO) close(log_fd);
+    log_fd = -1;
+    free(ring);
+}
@@ -0,0 +1,131 @@
+// replay.c
+//
+// Reader for game record archives written by client -record-file.
+//
+//   ./replay <archive>              summary of every game, and how fast
+//                                   the archive's positions replay
+//   ./replay <archive> -game <n>    the plies and final board of game n
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "gamerec.h"
+
+static void print_board(const EnginePosition *pos)
+{
+    for (int r = 0; r < pos->height; r++) {
+        char row[ENGINE_MAX_SIDE + 1];
+        for (int c = 0; c < pos->width; c++) {
+            int sq = r * pos->width + c;
+            uint64_t bit = 1ULL << (sq & 63);
+            row[c] = (pos->red[sq >> 6] & bit)  ? 'R'
+                   : (pos->blue[sq >> 6] & bit) ? 'B'
+                   : (pos->wall[sq >> 6] & bit) ? '#' : '.';
+        }
+        row[pos->width] = '\0';
+        printf("  %s\n", row);
+    }
+}
+
+static void print_game(const GameRecordHeader *game, int number)
+{
+    if (game->flags & GAMEREC_SELF_PLAY) {
+        printf("game %d: %dx%d, self-play", number, game->height, game->width);
+    } else {
+        printf("game %d: %dx%d, we played %c", number, game->height, game->width,
+               game->our_color);
+    }
+    printf(", red %d blue %d, %u plies%s\n",
+           game->red_score, game->blue_score, game->ply_count,
+           (game->flags & GAMEREC_INCOMPLETE) ? " (incomplete)" : "");
+
+    GameCursor cursor;
+    gamerec_cursor_start(&cursor, game);
+    const GamePly *plies = gamerec_plies(game);
+    int w = game->width;
+    for (uint32_t i = 0; i < game->ply_count; i++) {
+        const GamePly *ply = &plies[i];
+        printf("%4u %c ", i + 1, cursor.pos.to_move);
+        if (ply->from == GAMEREC_PASS) {
+            printf("pass       ");
+        } else {
+            // 1-based like the game protocol
+            printf("%2d,%-2d->%2d,%-2d", ply->from / w + 1, ply->from % w + 1,
+                   ply->to / w + 1, ply->to % w + 1);
+        }
+        printf(" %5u ms", ply->time_ms);
+        if (ply->eval != GAMEREC_NO_EVAL) {
+            printf("  eval %d depth %d", ply->eval, ply->depth);
+        }
+        printf("\n");
+        gamerec_cursor_step(&cursor);
+    }
+    print_board(&cursor.pos);
+}
+
+static void summarize(const GameArchive *archive)
+{
+    unsigned long long plies = 0, positions = 0, red_pieces = 0;
+    int games = 0, wins = 0, losses = 0, incomplete = 0, self_play = 0;
+    long long start_time = get_time_ms();
+
+    for (const GameRecordHeader *game = gamerec_first(archive); game;
+         game = gamerec_next(archive, game)) {
+        games++;
+        plies += game->ply_count;
+        if (game->flags & GAMEREC_INCOMPLETE) incomplete++;
+        if (game->flags & GAMEREC_SELF_PLAY) self_play++;
+        int ours = (game->our_color == 'R') ? game->red_score : game->blue_score;
+        int theirs = (game->our_color == 'R') ? game->blue_score : game->red_score;
+        if (ours > theirs) wins++;
+        else if (ours < theirs) losses++;
+
+        // Touch every position, as a tuning or benchmark pass would.
+        GameCursor cursor;
+        gamerec_cursor_start(&cursor, game);
+        do {
+            positions++;
+            red_pieces += __builtin_popcountll(cursor.pos.red[0]) +
+                          __builtin_popcountll(cursor.pos.red[1]);
+        } while (gamerec_cursor_step(&cursor));
+    }
+    long long elapsed = get_time_ms() - start_time;
+
+    printf("%d games (%d won, %d lost, %d drawn, %d incomplete, %d self-play), %llu plies\n",
+           games, wins, losses, games - wins - losses, incomplete, self_play, plies);
+    printf("replayed %llu positions in %lld ms (%llu positions/s), %.1f red pieces on average\n",
+           positions, elapsed,
+           elapsed > 0 ? positions * 1000ULL / elapsed : 0ULL,
+           positions ? (double)red_pieces / positions : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    int game_number = 0;
+    if (argc == 4 && strcmp(argv[2], "-game") == 0) {
+        game_number = atoi(argv[3]);
+    } else if (argc != 2) {
+        fprintf(stderr, "Usage: %s <archive> [-game <n>]\n", argv[0]);
+        return 1;
+    }
+
+    GameArchive archive;
+    if (gamerec_archive_open(&archive, argv[1]) != 0) {
+        fprintf(stderr, "[replay] cannot read %s\n", argv[1]);
+        return 1;
+    }
+    if (game_number > 0) {
+        const GameRecordHeader *game = gamerec_first(&archive);
+        for (int i = 1; game && i < game_number; i++) {
+            game = gamerec_next(&archive, game);
+        }
+        if (game) {
+            print_game(game, game_number);
+        } else {
+            fprintf(stderr, "[replay] no game %d\n", game_number);
+        }
+    } else {
+        summarize(&archive);
+    }
+    gamerec_archive_close(&archive);
+    return 0;
+}
@@ -0,0 +1,202 @@
+// selfplay.c
+//
+// Offline training data. Plays games of the engine against itself with a
+// shallow fixed-depth search on every core and appends them to a game
+// record archive (see gamerec.h), one game per write, for fit to learn
+// evaluation weights from.
+//
+//   ./selfplay -out <archive> [-games <n>] [-threads <n>] [-depth <plies>]
+//              [-random-plies <n>] [-size <side>] [-seed <n>]
+//              [-eval-file <path>]
+//
+// Each game opens with a few uniformly random plies so that the games
+// spread over many positions instead of repeating the engine's favourite
+// line. The archive is opened for appending, so several runs, or several
+// machines' archives concatenated, make one data set.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <limits.h>
+#include "engine.h"
+#include "gamerec.h"
+
+#define SELFPLAY_MAX_PLIES 1024        // games end long before this
+
+static int out_fd = -1;
+static int games_total = 1000;
+static int search_depth = 3;
+static int random_plies = 6;
+static int board_side = 8;
+static unsigned long long seed = 1;
+
+static int next_game;                  // claimed with __atomic_fetch_add
+static int games_done;
+static unsigned long long positions_done;
+static int write_errors;
+static long long start_ms;
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static int pieces(const uint64_t *mask)
+{
+    return __builtin_popcountll(mask[0]) + __builtin_popcountll(mask[1]);
+}
+
+/**
+ * Play one game from the start position into 'plies'. The game ends when
+ * the board is full, a side has been wiped out or neither side can move.
+ *
+ * @return the number of plies, with the final position left in 'pos'
+ */
+static uint32_t play_game(EnginePosition *pos, GamePly *plies, uint64_t *rng)
+{
+    static __thread EngineMove moves[ENGINE_MAX_MOVES];
+    int squares = pos->height * pos->width;
+    int walls = pieces(pos->wall);
+    int passes = 0;
+    uint32_t count = 0;
+
+    while (count < SELFPLAY_MAX_PLIES && passes < 2) {
+        int red = pieces(pos->red), blue = pieces(pos->blue);
+        if (red == 0 || blue == 0 || red + blue + walls == squares) break;
+
+        GamePly *ply = &plies[count];
+        int n = engine_legal_moves(pos, moves);
+        if (n <= 0) {
+            gamerec_make_ply(ply, NULL, pos->width, 0, GAMEREC_NO_EVAL, 0);
+            passes++;
+        } else if (count < (uint32_t)random_plies) {
+            const EngineMove *move = &moves[xorshift64(rng) % (uint64_t)n];
+            gamerec_make_ply(ply, move, pos->width, 0, GAMEREC_NO_EVAL, 0);
+            passes = 0;
+        } else {
+            EngineLimits limits = { search_depth, LLONG_MAX, NULL, 0, NULL, 0 };
+            EngineResult result;
+            long long t0 = get_time_ms();
+            engine_state_next_search();
+            engine_search(pos, &limits, &result);
+            gamerec_make_ply(ply, &result.move, pos->width,
+                             (int)(get_time_ms() - t0), result.score, result.depth);
+            passes = 0;
+        }
+        gamerec_apply(pos, ply);
+        count++;
+    }
+    return count;
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    GamePly *plies = (GamePly *)malloc(SELFPLAY_MAX_PLIES * sizeof(GamePly));
+    if (!plies) return NULL;
+    engine_prepare(board_side, board_side);
+
+    for (;;) {
+        int game = __atomic_fetch_add(&next_game, 1, __ATOMIC_RELAXED);
+        if (game >= games_total) break;
+        // Seeded per game, so a game's opening does not depend on which
+        // thread happened to claim it.
+        uint64_t rng = splitmix64(seed ^ ((uint64_t)game << 32)) | 1;
+
+        EnginePosition pos;
+        engine_start_position(&pos, board_side);
+        GameRecordHeader header;
+        gamerec_header_init(&header, &pos, 'R');
+        header.flags = GAMEREC_SELF_PLAY;
+        header.ply_count = play_game(&pos, plies, &rng);
+        header.red_score = (int16_t)pieces(pos.red);
+        header.blue_score = (int16_t)pieces(pos.blue);
+        if (gamerec_append(out_fd, &header, plies) != 0) {
+            __atomic_fetch_add(&write_errors, 1, __ATOMIC_RELAXED);
+        }
+
+        __atomic_fetch_add(&positions_done, header.ply_count + 1ULL, __ATOMIC_RELAXED);
+        int done = __atomic_add_fetch(&games_done, 1, __ATOMIC_RELAXED);
+        if (done % 1000 == 0) {
+            long long elapsed = get_time_ms() - start_ms;
+            fprintf(stderr, "[selfplay] %d/%d games, %lld s\n", done, games_total,
+                    elapsed / 1000);
+        }
+    }
+    free(plies);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_file = NULL, *eval_file = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-out") == 0)          out_file = argv[++i];
+        else if (strcmp(argv[i], "-games") == 0)        games_total = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0)      threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-depth") == 0)        search_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-random-plies") == 0) random_plies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-size") == 0)         board_side = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0)         seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-eval-file") == 0)    eval_file = argv[++i];
+        else { bad_args = 1; break; }
+    }
+    if (bad_args || !out_file || games_total <= 0 || search_depth <= 0 ||
+        random_plies < 0 || !engine_supports(board_side, board_side)) {
+        fprintf(stderr, "Usage: %s -out <archive> [-games <n>] [-threads <n>] [-depth <plies>]\n"
+                        "       [-random-plies <n>] [-size <side>] [-seed <n>] [-eval-file <path>]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    out_fd = open(out_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "[selfplay] cannot open %s\n", out_file);
+        return 1;
+    }
+    if (engine_state_open(NULL) != 0) {
+        fprintf(stderr, "[selfplay] cannot allocate the search state\n");
+        close(out_fd);
+        return 1;
+    }
+    if (eval_file && engine_eval_open(eval_file) != 0) {
+        fprintf(stderr, "[selfplay] using the piece count evaluation\n");
+    }
+
+    start_ms = get_time_ms();
+    pthread_t *workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker_main, NULL);
+    }
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+    free(workers);
+    long long elapsed = get_time_ms() - start_ms;
+
+    printf("%d games, %llu positions in %lld ms on %d threads (%lld games/hour)\n",
+           games_done, positions_done, elapsed, threads,
+           elapsed > 0 ? games_done * 3600000LL / elapsed : 0LL);
+    if (write_errors) {
+        fprintf(stderr, "[selfplay] %d games not fully written\n", write_errors);
+    }
+    close(out_fd);
+    engine_state_close();
+    engine_eval_close();
+    return write_errors ? 1 : 0;
+}
@@ -92,15 +92,24 @@ static void StoreInStream(const Magick::Image &img, int delay_time_us,
   scratch->Clear();
   const int x_offset = do_center ? (scratch->width() - img.columns()) / 2 : 0;
   const int y_offset = do_center ? (scratch->height() - img.rows()) / 2 : 0;
+  // Each run of non-transparent pixels in a row is set at once.
+  std::vector<uint8_t> row(3 * img.columns());
   for (size_t y = 0; y < img.rows(); ++y) {
-    for (size_t x = 0; x < img.columns(); ++x) {
-      const Magick::Color &c = img.pixelColor(x, y);
-      if (c.alphaQuantum() < 255) {
-        scratch->SetPixel(x + x_offset, y + y_offset,
-                          ScaleQuantumToChar(c.redQuantum()),
-                          ScaleQuantumToChar(c.greenQuantum()),
-                          ScaleQuantumToChar(c.blueQuantum()));
+    size_t x = 0;
+    while (x < img.columns()) {
+      size_t end = x;
+      for (/**/; end < img.columns(); ++end) {
+        const Magick::Color &c = img.pixelColor(end, y);
+        if (c.alphaQuantum() >= 255) break;
+        uint8_t *pixel = &row[3 * end];
+        pixel[0] = ScaleQuantumToChar(c.redQuantum());
+        pixel[1] = ScaleQuantumToChar(c.greenQuantum());
+        pixel[2] = ScaleQuantumToChar(c.blueQuantum());
       }
+      if (end > x) {
+        scratch->SetRGBRow(x + x_offset, y + y_offset, end - x, &row[3 * x]);
+      }
+      x = end + 1;
     }
   }
   output->Stream(*scratch, delay_time_us);
@@ -61,17 +61,12 @@ static void InterruptHandler(int) {
   interrupt_received = true;
 }
 
-struct LedPixel {
-  uint8_t r, g, b;
-};
 void CopyFrame(AVFrame *pFrame, FrameCanvas *canvas,
                int offset_x, int offset_y,
                int width, int height) {
   for (int y = 0; y < height; ++y) {
-    LedPixel *pix = (LedPixel*) (pFrame->data[0] + y*pFrame->linesize[0]);
-    for (int x = 0; x < width; ++x, ++pix) {
-      canvas->SetPixel(x + offset_x, y + offset_y, pix->r, pix->g, pix->b);
-    }
+    canvas->SetRGBRow(offset_x, y + offset_y, width,
+                      pFrame->data[0] + y*pFrame->linesize[0]);
   }
 }
 
@@ -246,6 +241,8 @@ int main(int argc, char *argv[]) {
   FrameCanvas *offscreen_canvas = matrix->CreateFrameCanvas();
 
   long frame_count = 0;
+  int64_t copy_nanos = 0;     // Time and pixels of CopyFrame(), for -v
+  int64_t copy_pixels = 0;
   StreamIO *stream_io = NULL;
   StreamWriter *stream_writer = NULL;
   if (stream_output_fd >= 0) {
@@ -426,9 +423,15 @@ int main(int argc, char *argv[]) {
             sws_scale(sws_ctx, (uint8_t const * const *)decode_frame->data,
                       decode_frame->linesize, 0, codec_context->height,
                       output_frame->data, output_frame->linesize);
+            struct timespec copy_start, copy_end;
+            clock_gettime(CLOCK_MONOTONIC, &copy_start);
             CopyFrame(output_frame, offscreen_canvas,
                       display_offset_x, display_offset_y,
                       display_width, display_height);
+            clock_gettime(CLOCK_MONOTONIC, &copy_end);
+            copy_nanos += (copy_end.tv_sec - copy_start.tv_sec) * 1000000000LL
+              + (copy_end.tv_nsec - copy_start.tv_nsec);
+            copy_pixels += display_width * display_height;
             frame_count++;
             frames_left--;
             if (stream_writer) {
@@ -464,6 +467,10 @@ int main(int argc, char *argv[]) {
   delete stream_writer;
   delete stream_io;
   fprintf(stderr, "Total of %ld frames decoded\n", frame_count);
+  if (verbose && copy_nanos > 0) {
+    fprintf(stderr, "Copied to the canvas at %.1f Mpixel/s\n",
+            1e3 * copy_pixels / copy_nanos);
+  }
 
   return 0;
 }
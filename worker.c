@@ -0,0 +1,480 @@
+// worker.c
+//
+// Search worker for distributed search (see distsearch.h). Listens on a TCP
+// port for one coordinator at a time and searches the root moves it hands
+// out on a pool of threads, which share one transposition table.
+//
+// Messages are JSON objects, one per line. The worker greets with
+//
+//   {"type":"hello","slots":4}
+//
+// and the coordinator sends
+//
+//   {"type":"position","board":["R......B",...],"turn":"R"}
+//   {"type":"job","id":17,"move":[1,1,2,2],"depth":8,"alpha":-3,"open":false}
+//   {"type":"alpha","depth":8,"alpha":5}
+//   {"type":"cancel","id":17}
+//   {"type":"clear"}
+//
+// A position drops every job of the previous one. A job scores the position
+// after "move", searched "depth" plies below it, for the side to move in the
+// position: with a null window at "alpha", or with "open" from "alpha" up.
+// Scores are fail-soft, so at or below the alpha searched with they are
+// upper bounds. An alpha message restarts running jobs of its depth that
+// searched with a lower one; queued jobs of that depth start with it. Every
+// job that is not cancelled is answered with
+//
+//   {"type":"result","id":17,"score":-2,"alpha":5,"nodes":123456}
+//
+// Coordinates are 1-based as in the game protocol.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "cJSON.h"
+#include "engine.h"
+#include "logger.h"
+
+#define WORKER_LINE_MAX  4096
+
+typedef struct Job {
+    struct Job        *next;
+    double             id;
+    EngineMove         move;
+    int                depth;
+    int                alpha;
+    int                open;
+    int                cancel;     // EngineLimits::cancel
+    int                restart;    // cancelled for a higher alpha
+    unsigned           generation;
+} Job;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  queue_idle = PTHREAD_COND_INITIALIZER;
+static Job *queue_head, *queue_tail;
+static Job *running;
+static int  running_count;
+static int  stopping;
+
+// Bumped by every position and connection; jobs of an older one are not
+// answered. Guarded by queue_lock, like 'position' and 'alpha'.
+static unsigned       generation;
+static EnginePosition position;
+static int            have_position;
+static int            alpha = -ENGINE_SCORE_INF;
+static int            alpha_depth = -1;   // of the jobs 'alpha' applies to
+
+// The coordinator's connection, -1 without one.
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static int coord_fd = -1;
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig) { (void)sig; quit = 1; }
+
+// Send 'json' if the job that produced it, of 'gen', is still current.
+static void send_reply(cJSON *json, unsigned gen)
+{
+    char *msg = cJSON_PrintUnformatted(json);
+    if (!msg) return;
+    size_t len = strlen(msg);
+    msg[len] = '\n';    // replaces the terminator; cJSON allocates len + 1
+    pthread_mutex_lock(&write_lock);
+    if (coord_fd >= 0 && gen == __atomic_load_n(&generation, __ATOMIC_RELAXED)) {
+        const char *p = msg;
+        size_t left = len + 1;
+        while (left > 0) {
+            ssize_t n = send(coord_fd, p, left, MSG_NOSIGNAL);
+            if (n <= 0) break;   // the coordinator went away
+            p += n;
+            left -= (size_t)n;
+        }
+    }
+    pthread_mutex_unlock(&write_lock);
+    free(msg);
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    engine_prepare(8, 8);   // this thread's context for the common size
+
+    pthread_mutex_lock(&queue_lock);
+    for (;;) {
+        while (!stopping && !queue_head) {
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        }
+        if (stopping) break;
+        Job *job = queue_head;
+        queue_head = job->next;
+        if (!queue_head) queue_tail = NULL;
+        job->next = running;
+        running = job;
+        running_count++;
+        if (job->depth == alpha_depth && job->alpha < alpha) job->alpha = alpha;
+        EnginePosition pos = position;
+        pthread_mutex_unlock(&queue_lock);
+
+        int legal = engine_play(&pos, &job->move) == 0;
+        if (!legal) {
+            LOG(LOG_WARN, "[worker] job %.0f: illegal move", job->id);
+        }
+        unsigned long long nodes = 0;
+        int score = 0, found = 0, done = !legal;
+        EngineLimits limits = { 0, LLONG_MAX, &job->cancel, 0, NULL, 0 };
+        while (!done) {
+            int beta = job->open ? ENGINE_SCORE_INF : job->alpha + 1;
+            unsigned long long searched = 0;
+            found = engine_search_window(&pos, job->depth, -beta, -job->alpha,
+                                         &limits, &score, &searched) == 1;
+            nodes += searched;
+            pthread_mutex_lock(&queue_lock);
+            done = found || !job->restart;
+            if (!done) {
+                job->restart = 0;
+                job->cancel = 0;
+                if (job->alpha < alpha) job->alpha = alpha;
+            }
+            pthread_mutex_unlock(&queue_lock);
+        }
+        if (found) {
+            cJSON *msg = cJSON_CreateObject();
+            cJSON_AddStringToObject(msg, "type", "result");
+            cJSON_AddNumberToObject(msg, "id", job->id);
+            cJSON_AddNumberToObject(msg, "score", -score);
+            cJSON_AddNumberToObject(msg, "alpha", job->alpha);
+            cJSON_AddNumberToObject(msg, "nodes", (double)nodes);
+            send_reply(msg, job->generation);
+            cJSON_Delete(msg);
+        }
+        LOG(LOG_DEBUG, "[worker] job %.0f: depth %d alpha %d%s: %s %d, %llu nodes",
+            job->id, job->depth, job->alpha, job->open ? " open" : "",
+            found ? "score" : "stopped at", -score, nodes);
+
+        pthread_mutex_lock(&queue_lock);
+        for (Job **p = &running; *p; p = &(*p)->next) {
+            if (*p == job) { *p = job->next; break; }
+        }
+        if (--running_count == 0) pthread_cond_broadcast(&queue_idle);
+        free(job);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return NULL;
+}
+
+// Drop the queued jobs and stop the running ones. Called with queue_lock
+// held.
+static void cancel_all(void)
+{
+    while (queue_head) {
+        Job *job = queue_head;
+        queue_head = job->next;
+        free(job);
+    }
+    queue_tail = NULL;
+    for (Job *job = running; job; job = job->next) {
+        job->restart = 0;
+        __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static int parse_position(cJSON *req, EnginePosition *pos)
+{
+    cJSON *board = cJSON_GetObjectItem(req, "board");
+    cJSON *turn = cJSON_GetObjectItem(req, "turn");
+    const char *rows[ENGINE_MAX_SIDE];
+    int height = cJSON_IsArray(board) ? cJSON_GetArraySize(board) : 0;
+    if (height < ENGINE_MIN_SIDE || height > ENGINE_MAX_SIDE) return -1;
+    int width = -1;
+    for (int r = 0; r < height; r++) {
+        cJSON *row = cJSON_GetArrayItem(board, r);
+        if (!cJSON_IsString(row) ||
+            (width >= 0 && (int)strlen(row->valuestring) != width)) {
+            return -1;
+        }
+        rows[r] = row->valuestring;
+        width = (int)strlen(rows[r]);
+    }
+    char to_move = cJSON_IsString(turn) ? turn->valuestring[0] : 'R';
+    if (to_move != 'R' && to_move != 'B') return -1;
+    return engine_position_from_rows(pos, rows, height, width, to_move);
+}
+
+static Job *parse_job(cJSON *req)
+{
+    cJSON *id = cJSON_GetObjectItem(req, "id");
+    cJSON *move = cJSON_GetObjectItem(req, "move");
+    cJSON *depth = cJSON_GetObjectItem(req, "depth");
+    cJSON *job_alpha = cJSON_GetObjectItem(req, "alpha");
+    cJSON *open = cJSON_GetObjectItem(req, "open");
+    if (!cJSON_IsNumber(id) || !cJSON_IsArray(move) || cJSON_GetArraySize(move) != 4 ||
+        !cJSON_IsNumber(depth) || !cJSON_IsNumber(job_alpha)) {
+        return NULL;
+    }
+    int v[4];
+    for (int i = 0; i < 4; i++) {
+        cJSON *c = cJSON_GetArrayItem(move, i);
+        if (!cJSON_IsNumber(c)) return NULL;
+        v[i] = c->valueint - 1;
+    }
+    Job *job = (Job *)calloc(1, sizeof(*job));
+    if (!job) return NULL;
+    job->id = id->valuedouble;
+    job->move.from_row = v[0];
+    job->move.from_col = v[1];
+    job->move.to_row = v[2];
+    job->move.to_col = v[3];
+    job->depth = depth->valueint;
+    job->alpha = job_alpha->valueint;
+    job->open = cJSON_IsTrue(open);
+    return job;
+}
+
+static void handle_message(const char *line)
+{
+    cJSON *req = cJSON_Parse(line);
+    cJSON *type = req ? cJSON_GetObjectItem(req, "type") : NULL;
+    if (!cJSON_IsString(type)) {
+        LOG(LOG_WARN, "[worker] ignoring malformed message");
+        cJSON_Delete(req);
+        return;
+    }
+
+    if (strcmp(type->valuestring, "position") == 0) {
+        EnginePosition pos;
+        int ok = parse_position(req, &pos) == 0;
+        pthread_mutex_lock(&queue_lock);
+        cancel_all();
+        generation++;
+        have_position = ok;
+        position = pos;
+        alpha = -ENGINE_SCORE_INF;
+        alpha_depth = -1;
+        pthread_mutex_unlock(&queue_lock);
+        if (ok) engine_state_next_search();
+        else LOG(LOG_WARN, "[worker] unsupported position");
+    } else if (strcmp(type->valuestring, "job") == 0) {
+        Job *job = parse_job(req);
+        pthread_mutex_lock(&queue_lock);
+        if (job && have_position) {
+            job->generation = generation;
+            if (queue_tail) queue_tail->next = job;
+            else queue_head = job;
+            queue_tail = job;
+            pthread_cond_signal(&queue_ready);
+        } else {
+            free(job);
+            LOG(LOG_WARN, "[worker] ignoring a job without a position");
+        }
+        pthread_mutex_unlock(&queue_lock);
+    } else if (strcmp(type->valuestring, "alpha") == 0) {
+        cJSON *value = cJSON_GetObjectItem(req, "alpha");
+        cJSON *depth = cJSON_GetObjectItem(req, "depth");
+        pthread_mutex_lock(&queue_lock);
+        if (cJSON_IsNumber(value) && cJSON_IsNumber(depth) &&
+            (depth->valueint != alpha_depth || value->valueint > alpha)) {
+            alpha = value->valueint;
+            alpha_depth = depth->valueint;
+            for (Job *job = running; job; job = job->next) {
+                if (job->depth == alpha_depth && job->alpha < alpha && !job->cancel) {
+                    job->restart = 1;
+                    __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+        pthread_mutex_unlock(&queue_lock);
+    } else if (strcmp(type->valuestring, "cancel") == 0) {
+        cJSON *id = cJSON_GetObjectItem(req, "id");
+        pthread_mutex_lock(&queue_lock);
+        Job *prev = NULL;
+        for (Job *job = queue_head; cJSON_IsNumber(id) && job; prev = job, job = job->next) {
+            if (job->id != id->valuedouble) continue;
+            if (prev) prev->next = job->next; else queue_head = job->next;
+            if (queue_tail == job) queue_tail = prev;
+            free(job);
+            break;
+        }
+        for (Job *job = running; cJSON_IsNumber(id) && job; job = job->next) {
+            if (job->id == id->valuedouble) {
+                job->restart = 0;
+                __atomic_store_n(&job->cancel, 1, __ATOMIC_RELAXED);
+            }
+        }
+        pthread_mutex_unlock(&queue_lock);
+    } else if (strcmp(type->valuestring, "clear") == 0) {
+        // The table may only be wiped while nothing searches it.
+        pthread_mutex_lock(&queue_lock);
+        cancel_all();
+        while (running_count > 0) pthread_cond_wait(&queue_idle, &queue_lock);
+        engine_state_clear();
+        pthread_mutex_unlock(&queue_lock);
+    } else {
+        LOG(LOG_WARN, "[worker] unknown message type %s", type->valuestring);
+    }
+    cJSON_Delete(req);
+}
+
+// Serve one coordinator until it disconnects or the worker is stopped.
+static void serve_coordinator(int fd, int slots)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    pthread_mutex_lock(&queue_lock);
+    generation++;
+    have_position = 0;
+    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_lock(&write_lock);
+    coord_fd = fd;
+    pthread_mutex_unlock(&write_lock);
+
+    cJSON *hello = cJSON_CreateObject();
+    cJSON_AddStringToObject(hello, "type", "hello");
+    cJSON_AddNumberToObject(hello, "slots", slots);
+    send_reply(hello, __atomic_load_n(&generation, __ATOMIC_RELAXED));
+    cJSON_Delete(hello);
+
+    static char buf[WORKER_LINE_MAX];
+    size_t len = 0;
+    while (!quit) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+        buf[len] = '\0';
+        char *line = buf, *end;
+        while ((end = strchr(line, '\n')) != NULL) {
+            *end = '\0';
+            if (end > line) handle_message(line);
+            line = end + 1;
+        }
+        len -= (size_t)(line - buf);
+        memmove(buf, line, len);
+        if (len == sizeof(buf) - 1) {
+            LOG(LOG_WARN, "[worker] message too long");
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    cancel_all();
+    generation++;
+    have_position = 0;
+    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_lock(&write_lock);
+    coord_fd = -1;
+    close(fd);
+    pthread_mutex_unlock(&write_lock);
+}
+
+static int listen_on(int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 4) != 0) {
+        fprintf(stderr, "[worker] cannot listen on port %d: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    const char *tt_file = NULL, *log_file = NULL, *eval_file = NULL;
+    int port = 9100;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int level = LOG_INFO;
+
+    int bad_args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { bad_args = 1; break; }
+        if      (strcmp(argv[i], "-port") == 0)     port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0)  threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-tt-file") == 0)  tt_file = argv[++i];
+        else if (strcmp(argv[i], "-eval-file") == 0) eval_file = argv[++i];
+        else if (strcmp(argv[i], "-log-file") == 0) log_file = argv[++i];
+        else if (strcmp(argv[i], "-log-level") == 0) {
+            level = log_level_from_name(argv[++i]);
+            if (level < 0) { bad_args = 1; break; }
+        }
+        else { bad_args = 1; break; }
+    }
+    if (bad_args || port <= 0 || port > 65535) {
+        fprintf(stderr, "Usage: %s [-port <n>] [-threads <n>] [-tt-file <path>]\n"
+                        "       [-eval-file <path>] [-log-file <path>] [-log-level error|warn|info|debug]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    log_open(log_file, level);
+    if (engine_state_open(tt_file) != 0) {
+        LOG(LOG_ERROR, "[worker] cannot allocate the search state");
+        log_close();
+        return 1;
+    }
+    if (eval_file && engine_eval_open(eval_file) != 0) {
+        LOG(LOG_WARN, "[worker] using the piece count evaluation");
+    }
+    int listen_fd = listen_on(port);
+    if (listen_fd < 0) {
+        engine_state_close();
+        log_close();
+        return 1;
+    }
+
+    pthread_t *workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker_main, NULL);
+    }
+    LOG(LOG_INFO, "[worker] listening on port %d with %d threads", port, threads);
+
+    while (!quit) {
+        struct pollfd p = { listen_fd, POLLIN, 0 };
+        if (poll(&p, 1, -1) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        LOG(LOG_INFO, "[worker] coordinator connected");
+        serve_coordinator(fd, threads);
+        LOG(LOG_INFO, "[worker] coordinator disconnected");
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    cancel_all();
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+    free(workers);
+
+    close(listen_fd);
+    engine_state_sync();
+    engine_state_close();
+    engine_eval_close();
+    LOG(LOG_INFO, "[worker] stopped");
+    log_close();
+    return 0;
+}